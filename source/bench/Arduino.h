@@ -0,0 +1,129 @@
+#pragma once
+// Host stand-in for the parts of the Arduino core the page pipeline uses.
+// Only built by [env:native]; the T-Deck build never sees this file.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+
+using std::min;
+using std::max;
+
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+#define MALLOC_CAP_SPIRAM    (1 << 10)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+static inline void* heap_caps_malloc(size_t n, uint32_t) { return malloc(n); }
+static inline void* heap_caps_realloc(void* p, size_t n, uint32_t) { return realloc(p, n); }
+static inline void  heap_caps_free(void* p) { free(p); }
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+// One task on the host. A task made with xTaskCreatePinnedToCore does not
+// run on its own: taskRun() runs it until it waits on a notification with
+// none pending. The mutex is a no-op with a single thread.
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void*);
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE        1
+static inline TaskHandle_t      xTaskGetCurrentTaskHandle() { return nullptr; }
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() { return (SemaphoreHandle_t)1; }
+static inline int               xSemaphoreTake(SemaphoreHandle_t, uint32_t) { return pdTRUE; }
+static inline int               xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
+int      xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* arg, int prio,
+                                 TaskHandle_t* out, int core);
+uint32_t ulTaskNotifyTake(int clear, uint32_t wait);
+void     xTaskNotifyGive(TaskHandle_t t);
+void     taskRun();
+
+#if !defined(__GLIBC__) || !__GLIBC_PREREQ(2, 38)
+static inline size_t strlcpy(char* dst, const char* src, size_t n) {
+    size_t l = strlen(src);
+    if (n) { size_t c = l < n - 1 ? l : n - 1; memcpy(dst, src, c); dst[c] = 0; }
+    return l;
+}
+#endif
+
+class String {
+public:
+    String() {}
+    String(const char* s) : s_(s ? s : "") {}
+    String(const std::string& s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    explicit String(int v) : s_(std::to_string(v)) {}
+    explicit String(unsigned v) : s_(std::to_string(v)) {}
+    explicit String(long v) : s_(std::to_string(v)) {}
+    explicit String(unsigned long v) : s_(std::to_string(v)) {}
+
+    const char* c_str() const { return s_.c_str(); }
+    unsigned length() const { return (unsigned)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    bool reserve(unsigned n) { s_.reserve(n); return true; }
+    char operator[](unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+    char& operator[](unsigned i) { return s_[i]; }
+
+    String& operator+=(const String& o) { s_ += o.s_; return *this; }
+    String& operator+=(const char* o) { s_ += o; return *this; }
+    String& operator+=(char c) { s_ += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+    friend String operator+(const String& a, const char* b) { return String(a.s_ + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s_); }
+    friend String operator+(const String& a, char c) { return String(a.s_ + c); }
+    bool operator==(const String& o) const { return s_ == o.s_; }
+    bool operator==(const char* o) const { return s_ == o; }
+    bool operator!=(const String& o) const { return s_ != o.s_; }
+
+    bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+    bool endsWith(const String& p) const {
+        return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+    }
+    int indexOf(char c, unsigned from = 0) const { size_t i = s_.find(c, from); return i == std::string::npos ? -1 : (int)i; }
+    int indexOf(const String& p, unsigned from = 0) const { size_t i = s_.find(p.s_, from); return i == std::string::npos ? -1 : (int)i; }
+    String substring(unsigned from) const { return from >= s_.size() ? String() : String(s_.substr(from)); }
+    String substring(unsigned from, unsigned to) const {
+        if (from >= s_.size() || to <= from) return String();
+        return String(s_.substr(from, to - from));
+    }
+    void remove(unsigned idx) { if (idx < s_.size()) s_.erase(idx); }
+    void remove(unsigned idx, unsigned n) { if (idx < s_.size()) s_.erase(idx, n); }
+    void replace(const String& a, const String& b) {
+        if (a.s_.empty()) return;
+        for (size_t i = 0; (i = s_.find(a.s_, i)) != std::string::npos; i += b.s_.size()) s_.replace(i, a.s_.size(), b.s_);
+    }
+    void toLowerCase() { for (auto& c : s_) c = (char)tolower((unsigned char)c); }
+    void trim() {
+        size_t b = s_.find_first_not_of(" \t\r\n"), e = s_.find_last_not_of(" \t\r\n");
+        s_ = (b == std::string::npos) ? std::string() : s_.substr(b, e - b + 1);
+    }
+    int toInt() const { return atoi(s_.c_str()); }
+
+    const char* begin() const { return s_.data(); }
+    const char* end() const { return s_.data() + s_.size(); }
+
+private:
+    std::string s_;
+};
+
+class Stream {
+public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t readBytes(uint8_t* buf, size_t n) {
+        size_t i = 0;
+        for (; i < n; i++) { int c = read(); if (c < 0) break; buf[i] = (uint8_t)c; }
+        return i;
+    }
+    size_t readBytes(char* buf, size_t n) { return readBytes((uint8_t*)buf, n); }
+    void setTimeout(unsigned long ms) { timeout_ = ms; }
+
+protected:
+    unsigned long timeout_ = 1000;
+};
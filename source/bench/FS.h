@@ -0,0 +1,73 @@
+#pragma once
+// Host stand-in for the Arduino fs::FS / fs::File pair, for [env:native]
+// only: paths are rooted at fakeFsRoot, a flat directory like SPIFFS.
+// fakeFsReads / fakeFsBytesRead count what went through File::read.
+#include <Arduino.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <memory>
+#include <vector>
+
+inline std::string fakeFsRoot = "/tmp";
+inline size_t      fakeFsReads = 0, fakeFsBytesRead = 0;
+
+namespace fs {
+
+class File {
+public:
+    File() {}
+    File(const std::string& path, const char* mode) : name_(path.substr(path.rfind('/') + 1)) {
+        std::string full = fakeFsRoot + path;
+        struct stat st;
+        if (path == "/" || (!stat(full.c_str(), &st) && S_ISDIR(st.st_mode))) {
+            if (DIR* d = opendir(full.c_str())) {
+                for (dirent* e; (e = readdir(d));) if (e->d_type == DT_REG) dir_.push_back(e->d_name);
+                closedir(d); isDir_ = true; ok_ = true;
+            }
+            return;
+        }
+        if (FILE* f = fopen(full.c_str(), *mode == 'w' ? "wb" : *mode == 'a' ? "ab" : "rb")) {
+            f_.reset(f, fclose); ok_ = true;
+        }
+    }
+    explicit operator bool() const { return ok_; }
+    const char* name() const { return name_.c_str(); }
+    bool isDirectory() const { return isDir_; }
+    File openNextFile() { return next_ < dir_.size() ? File("/" + dir_[next_++], "r") : File(); }
+
+    size_t read(uint8_t* p, size_t n) {
+        if (!f_) return 0;
+        fakeFsReads++;
+        size_t got = fread(p, 1, n, f_.get()); fakeFsBytesRead += got; return got;
+    }
+    size_t write(const uint8_t* p, size_t n) { return f_ ? fwrite(p, 1, n, f_.get()) : 0; }
+    bool   seek(uint32_t at) { return f_ && !fseek(f_.get(), at, SEEK_SET); }
+    size_t position() const { return f_ ? ftell(f_.get()) : 0; }
+    size_t size() const {
+        if (!f_) return 0;
+        fflush(f_.get()); struct stat st; return fstat(fileno(f_.get()), &st) ? 0 : st.st_size;
+    }
+    void   close() { f_.reset(); ok_ = false; dir_.clear(); }
+
+private:
+    std::shared_ptr<FILE>    f_;
+    std::string              name_;
+    std::vector<std::string> dir_;
+    size_t                   next_ = 0;
+    bool                     ok_ = false, isDir_ = false;
+};
+
+class FS {
+public:
+    File open(const char* path, const char* mode = "r") { return File(path, mode); }
+    bool exists(const char* path) { struct stat st; return !stat((fakeFsRoot + path).c_str(), &st); }
+    bool remove(const char* path) { return !::remove((fakeFsRoot + path).c_str()); }
+    bool rename(const char* from, const char* to) {
+        // SPIFFS won't rename onto an existing name; neither does this.
+        return !exists(to) && !::rename((fakeFsRoot + from).c_str(), (fakeFsRoot + to).c_str());
+    }
+};
+
+}  // namespace fs
+
+using fs::File;
@@ -0,0 +1,84 @@
+#pragma once
+// Loopback stand-in for the ESP32 WiFiClient, for [env:native] only.
+// Requests written by the client are handed to fakeServerRequest() once
+// complete (headers plus Content-Length body); the reply is what
+// available()/read() return. fakeServerEpoch() changes whenever the stand-in
+// server drops its connections; a client from an older epoch looks connected
+// until it tries to write, like a socket the peer has silently closed.
+// fakeServerSent() paces each reply: how many of its bytes are readable that
+// many ms (bench clock) after the request went out. Clients connect by the
+// address the lwIP stand-in handed out; fakeServerHost() maps it back.
+#include <Arduino.h>
+
+class IPAddress {
+public:
+    IPAddress(uint32_t a = 0) : addr(a) {}
+    operator uint32_t() const { return addr; }
+    uint32_t addr;
+};
+
+bool        fakeServerConnect(const char* host, uint16_t port, bool tls);
+const char* fakeServerHost(uint32_t ip);
+std::string fakeServerRequest(const char* host, const std::string& req, bool& closeAfter);
+int         fakeServerEpoch();
+size_t      fakeServerSent(const char* host, unsigned long ms);
+
+class WiFiClient : public Stream {
+public:
+    virtual ~WiFiClient() {}
+    int connect(IPAddress ip, uint16_t port) {
+        const char* host = fakeServerHost(ip);
+        return host ? connect(host, port) : 0;
+    }
+    int connect(const char* host, uint16_t port) {
+        stop();
+        if (!fakeServerConnect(host, port, tls_)) return 0;
+        host_ = host; epoch_ = fakeServerEpoch(); open_ = true;
+        return 1;
+    }
+    uint8_t connected() { return open_; }
+    void stop() { open_ = false; rx_.clear(); pos_ = base_ = 0; tx_.clear(); }
+    int available() override { return (int)(ready() - pos_); }
+    int read() override { return pos_ < ready() ? (uint8_t)rx_[pos_++] : -1; }
+    int read(uint8_t* b, size_t n) {
+        size_t k = min(n, ready() - pos_);
+        memcpy(b, rx_.data() + pos_, k); pos_ += k;
+        return (int)k;
+    }
+    size_t readBytes(uint8_t* b, size_t n) override { return (size_t)read(b, n); }
+    size_t write(const uint8_t* b, size_t n) {
+        if (!open_) return 0;
+        if (epoch_ != fakeServerEpoch()) { open_ = false; return 0; }
+        tx_.append((const char*)b, n); pump();
+        return n;
+    }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+protected:
+    bool tls_ = false;
+
+private:
+    size_t ready() const {
+        size_t sent = fakeServerSent(host_.c_str(), millis() - sentAt_);
+        return sent >= rx_.size() - base_ ? rx_.size() : base_ + sent;
+    }
+    void pump() {
+        size_t he = tx_.find("\r\n\r\n"); if (he == std::string::npos) return;
+        size_t need = he + 4;
+        const char* cl = strcasestr(tx_.c_str(), "Content-Length:");
+        if (cl && (size_t)(cl - tx_.c_str()) < he) need += (size_t)atoi(cl + 15);
+        if (tx_.size() < need) return;
+        bool close = false;
+        rx_.erase(0, pos_); pos_ = 0; base_ = rx_.size(); sentAt_ = millis();
+        rx_ += fakeServerRequest(host_.c_str(), tx_.substr(0, need), close);
+        tx_.erase(0, need);
+        if (close) open_ = false;
+    }
+
+    std::string host_, tx_, rx_;
+    size_t      pos_ = 0, base_ = 0;
+    unsigned long sentAt_ = 0;
+    int         epoch_ = 0;
+    bool        open_ = false;
+};
@@ -0,0 +1,2038 @@
+// Host replay benchmark for the page pipeline ([env:native]).
+//
+//   pio run -e native && .pio/build/native/program [capture_dir] [record_bytes]
+//
+// Every file in capture_dir is replayed through a fake Stream that hands out
+// record_bytes at a time (default 1400, roughly one TLS record per TCP
+// segment). Files named ddg*.html go through the streaming ddgFeed parser
+// and are checked against the whole-buffer parseDDGLite, then appended to as
+// further pages (the same results under other hosts) up to MAX_RESULTS, with
+// the "Next Page" form coming out as the next request body; everything else goes
+// through readStream -> buildLineCache -> pageIsBlocked, once as a
+// Content-Length body and once re-encoded as chunked. The lines wrapped
+// incrementally while the body streams in must match a full buildLineCache,
+// and 1st_scr is how many body bytes it took to fill the first screen. Pages are also run
+// through the byte-at-a-time stripFeed reference and compared against the
+// block stripper at several record sizes. Exit status is non-zero if any
+// two of those disagree.
+//
+// Files ending .gz (gzip) or .zz (zlib / raw deflate) are inflated at several
+// record sizes and must match their gzip trailer or the uncompressed capture
+// of the same name; streamed through readStream plain and chunked they must
+// strip to the same page as the identity body. A truncated body has to keep
+// what arrived and garbage has to fail.
+//
+// A 5 MB synthetic document goes through the segmented page store and must
+// come back byte for byte, with every character on some line. A page of
+// anchors must come out as the same absolute urls, interned without a single
+// heap allocation.
+//
+// The reading list saves pages to a scratch directory (FS.h) and opens them
+// again: opening must read only the head and links, a screen only the
+// segments under it, and every line, span and link must come back; truncated
+// or doctored files must be refused without touching the page on screen.
+//
+// Find in page runs on 200 KB documents: hits from the index built as the
+// page streams, from one built in one go and from the SWAR scan alone must
+// all equal a brute-force search, and every hit must map to the row showing
+// it. A page past FIND_MAX_WORDS mixes the two.
+//
+// The local index takes a few hundred small synthetic pages (some re-read
+// under an earlier url, more than LOCAL_MAX_DOCS in all) and the captures into
+// a scratch directory. Every query must find exactly the live pages holding
+// all its words, best first, and the same again after a reload from flash
+// with a torn record at the end of the doc list.
+//
+// Jina captures (*.txt) are also parsed as markdown and timed against the
+// HTML stripper on the same body; the styled-span output must not depend on
+// how the body was split, and a small document with one of each construct
+// must come out as expected.
+//
+// Tag names from the HTML captures and the whole HTML5 entity table are looked
+// up through the strcmp chains stripFeed used to run and through html.cpp's
+// compile-time hashes; the answers must agree, and article.html's strip rate
+// is reported in tags per second.
+//
+// The glyph-run renderer is checked against a model of TFT_eSPI's per-char
+// drawChar on a host framebuffer: every line of the text captures must come
+// out pixel-identical, including the bytes that fall back to tft.print. A
+// French page goes through the same check, after its entities have come out
+// as UTF-8 and its rows have wrapped by display cells; a tiny .vlw must land
+// in the glyph atlas where the font puts it.
+//
+// Finally a scripted browsing session runs against a loopback stand-in for
+// lite.duckduckgo.com, r.jina.ai and archive.org (see WiFi.h) and checks how
+// many full handshakes the connection pool lets through. A traced search and
+// page then have to dump spans that add back up to the per-phase self times
+// the overlay draws, and the cost of one span is reported. Last, the same
+// stand-in paces its replies on the bench clock: fetches driven one poll at a
+// time must come out identical to the blocking path, never wait inside a
+// poll, and stop, stall and time out where they should. The prefetch task,
+// run in line (see Arduino.h), must pass over the local index's hits, hand a
+// top result over as the page, flag a block page instead, stop at its byte
+// budget and connect through the address cache.
+#include <Arduino.h>
+#include <chrono>
+#include <climits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "page.h"
+#include "net.h"
+#include "text.h"
+#include "inflate.h"
+#include "html.h"
+#include "entities.h"
+#include "trace.h"
+#include "saved.h"
+#include "cache.h"
+#include "find.h"
+#include "local.h"
+#include "prefetch.h"
+#include <esp_timer.h>
+#include <lwip/dns.h>
+#include <Fonts/glcdfont.c>
+
+// Every operator new counts, so a pass can show it leaves the heap alone.
+// The deletes stay out of line, or GCC sees free() on a new'd pointer.
+static size_t s_news = 0;
+void* operator new(size_t n) { s_news++; if (void* p = malloc(n ? n : 1)) return p; throw std::bad_alloc(); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const auto    t_boot    = std::chrono::steady_clock::now();
+static unsigned long t_skewMs  = 0;
+
+unsigned long millis() {
+    auto el = std::chrono::steady_clock::now() - t_boot;
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(el).count() + t_skewMs;
+}
+static void fakeDnsDeliver();
+void delay(unsigned long ms) { t_skewMs += ms; fakeDnsDeliver(); }
+
+// The one background task, run by taskRun() up to its next wait on an empty
+// notification count; the wait throws back out to taskRun. Each run starts
+// the task function over, which is where its loop waits anyway.
+struct TaskIdle {};
+static TaskFunction_t s_taskFn    = nullptr;
+static void*          s_taskArg   = nullptr;
+static uint32_t       s_taskNotes = 0;
+
+int xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* arg, int, TaskHandle_t* out, int) {
+    s_taskFn = fn; s_taskArg = arg;
+    if (out) *out = (TaskHandle_t)&s_taskFn;
+    return pdTRUE;
+}
+uint32_t ulTaskNotifyTake(int clear, uint32_t) {
+    if (!s_taskNotes) throw TaskIdle();
+    uint32_t n = s_taskNotes;
+    s_taskNotes = clear ? 0 : n - 1;
+    return n;
+}
+void xTaskNotifyGive(TaskHandle_t) { s_taskNotes++; }
+void taskRun() {
+    if (!s_taskFn) return;
+    try { s_taskFn(s_taskArg); } catch (const TaskIdle&) {}
+}
+
+int64_t esp_timer_get_time() {
+    auto el = std::chrono::steady_clock::now() - t_boot;
+    return std::chrono::duration_cast<std::chrono::microseconds>(el).count() + (int64_t)t_skewMs * 1000;
+}
+
+static double nowUs() {
+    auto el = std::chrono::steady_clock::now() - t_boot;
+    return std::chrono::duration<double, std::micro>(el).count();
+}
+
+class ReplayStream : public Stream {
+public:
+    ReplayStream(const std::string& d, int record) : d_(d), rec_(record) {}
+    int available() override {
+        if (pos_ >= d_.size()) return 0;
+        if (pos_ >= recEnd_) recEnd_ = min(d_.size(), pos_ + (size_t)rec_);
+        return (int)(recEnd_ - pos_);
+    }
+    int read() override { return available() ? (uint8_t)d_[pos_++] : -1; }
+    size_t readBytes(uint8_t* buf, size_t n) override {
+        size_t got = 0;
+        while (got < n && available()) {
+            size_t take = min(n - got, recEnd_ - pos_);
+            memcpy(buf + got, d_.data() + pos_, take); pos_ += take; got += take;
+        }
+        return got;
+    }
+private:
+    const std::string& d_;
+    int    rec_;
+    size_t pos_ = 0, recEnd_ = 0;
+};
+
+static std::string chunkEncode(const std::string& body, size_t chunk) {
+    std::string out; char hdr[16];
+    for (size_t i = 0; i < body.size(); i += chunk) {
+        size_t n = min(chunk, body.size() - i);
+        snprintf(hdr, sizeof(hdr), "%zx\r\n", n);
+        out += hdr; out.append(body, i, n); out += "\r\n";
+    }
+    return out + "0\r\n\r\n";
+}
+
+static bool loadFile(const std::string& path, std::string& out) {
+    FILE* f = fopen(path.c_str(), "rb"); if (!f) return false;
+    char buf[8192]; size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    fclose(f); return true;
+}
+
+struct PageRun {
+    double stripUs = 0, linesUs = 0, blockedUs = 0;
+    int    iters = 0;
+    size_t outLen = 0; int lines = 0, links = 0; bool blocked = false;
+    size_t firstScreen = 0; bool linesMatch = true;
+    std::string text;
+};
+
+static size_t s_tapBytes = 0, s_firstScreen = 0;
+static bool firstScreenTap(const uint8_t*, size_t n) {
+    s_tapBytes += n;
+    if (!s_firstScreen && g_lineCount >= CONT_ROWS) s_firstScreen = s_tapBytes;
+    return true;
+}
+
+static std::vector<std::string> linkList() {
+    std::vector<std::string> v; char url[LINK_URL_LEN];
+    for (int i = 0; i < g_linkCount; i++) { linkUrl(i, url, sizeof(url)); v.push_back(url); }
+    return v;
+}
+
+static bool sameLines(const std::vector<LineSpan>& a) {
+    if ((int)a.size() != g_lineCount) return false;
+    for (int i = 0; i < g_lineCount; i++)
+        if (a[i].start != lineAt(i).start || a[i].len != lineAt(i).len ||
+            a[i].block != lineAt(i).block || a[i].cont != lineAt(i).cont) return false;
+    return true;
+}
+
+static std::string pageString() {
+    std::string s(g_pageLen, 0); pageRead(0, &s[0], g_pageLen); return s;
+}
+
+static void replayPage(const std::string& body, bool chunked, int record, PageRun& r) {
+    std::string wire = chunked ? chunkEncode(body, 8192) : body;
+    double budget = nowUs() + 200000;
+    do {
+        updateBaseDomain("https://www.example.ca/news/northern-winter");
+        ReplayStream s(wire, record);
+        s_tapBytes = s_firstScreen = 0;
+        double t0 = nowUs();
+        readStream(&s, chunked ? -1 : (int)body.size(), chunked, nullptr, firstScreenTap);
+        lineFeed(true);
+        double t1 = nowUs();
+        std::vector<LineSpan> inc(g_lineCount); lineRead(0, inc.data(), g_lineCount);
+        buildLineCache();
+        double t2 = nowUs();
+        r.linesMatch &= sameLines(inc);
+        r.firstScreen = s_firstScreen ? s_firstScreen : body.size();
+        r.blocked = pageIsBlocked();
+        double t3 = nowUs();
+        r.stripUs += t1 - t0; r.linesUs += t2 - t1; r.blockedUs += t3 - t2; r.iters++;
+    } while (r.iters < 3 || nowUs() < budget);
+    r.outLen = g_pageLen; r.lines = g_lineCount; r.links = g_linkCount;
+    r.text = pageString();
+}
+
+static double referenceStrip(const std::string& body, std::string& text) {
+    double us = 0; int iters = 0;
+    double budget = nowUs() + 200000;
+    do {
+        updateBaseDomain("https://www.example.ca/news/northern-winter");
+        double t0 = nowUs();
+        stripInit();
+        for (char c : body) stripFeed(c);
+        us += nowUs() - t0; iters++;
+    } while (iters < 3 || nowUs() < budget);
+    text = pageString();
+    return us / iters;
+}
+
+static bool benchPage(const char* name, const std::string& body, int record) {
+    PageRun plain, chunk;
+    replayPage(body, false, record, plain);
+    replayPage(body, true,  record, chunk);
+    const char* bad = nullptr;
+    if (plain.text != chunk.text || plain.lines != chunk.lines || plain.links != chunk.links) bad = "CHUNKED MISMATCH";
+    if (!plain.linesMatch || !chunk.linesMatch) bad = "INCREMENTAL LINES MISMATCH";
+
+    std::string ref;
+    double refUs = referenceStrip(body, ref);
+    if (ref != plain.text) bad = "REFERENCE MISMATCH";
+    for (int rec : {1, 7, 64, 4096}) {
+        PageRun odd; replayPage(body, false, rec, odd);
+        if (odd.text != ref) { bad = "RECORD-SPLIT MISMATCH"; break; }
+        if (!odd.linesMatch) { bad = "INCREMENTAL LINES MISMATCH"; break; }
+    }
+
+    double n = plain.iters;
+    printf("%-22s %8zu %8zu %8.2f %9.1f %9.1f %9.1f %9.1f  %5.1f%% %8d %3d/%d %-3s %8zu %s\n",
+           name, body.size(), plain.outLen,
+           body.size() / (plain.stripUs / n),
+           plain.stripUs / n, refUs, plain.linesUs / n, plain.blockedUs / n,
+           100.0 * plain.outLen / PAGE_MAX_BYTES, plain.lines, plain.links, MAX_LINKS,
+           plain.blocked ? "yes" : "no", plain.firstScreen, bad ? bad : "");
+    return !bad;
+}
+
+struct ResultCopy { std::string title, url, snippet; };
+
+static std::vector<ResultCopy> resultsCopy(int from = 0, int to = INT_MAX) {
+    std::vector<ResultCopy> v;
+    for (int i = from; i < min(to, g_resultCount); i++) { SearchResult r = resultAt(i); v.push_back({r.title, r.url, r.snippet}); }
+    return v;
+}
+
+static bool sameResults(const std::vector<ResultCopy>& a, int from = 0, int to = INT_MAX) {
+    std::vector<ResultCopy> b = resultsCopy(from, to);
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].title != b[i].title || a[i].url != b[i].url || a[i].snippet != b[i].snippet) return false;
+    return true;
+}
+
+static void ddgParse(const std::string& body, int record) {
+    ddgInit();
+    for (size_t i = 0; i < body.size(); i += record) ddgFeed(body.data() + i, min((size_t)record, body.size() - i));
+    ddgFinish();
+}
+
+static bool benchDDG(const char* name, const std::string& body, int record) {
+    // What doSearch used to do: grow a String one byte at a time, then parse it.
+    double us = 0; int iters = 0;
+    double budget = nowUs() + 200000;
+    do {
+        g_resultCount = 0;
+        double t0 = nowUs();
+        String html; html.reserve(30000);
+        for (char c : body) html += c;
+        parseDDGLite(html);
+        us += nowUs() - t0; iters++;
+    } while (iters < 3 || nowUs() < budget);
+    std::vector<ResultCopy> ref = resultsCopy();
+
+    // Streaming parser, fed as the bytes would arrive off the socket.
+    double sus = 0; int siters = 0; size_t firstAt = 0;
+    budget = nowUs() + 200000;
+    do {
+        g_resultCount = 0; firstAt = 0;
+        double t0 = nowUs();
+        ddgInit();
+        for (size_t i = 0; i < body.size(); i += record) {
+            ddgFeed(body.data() + i, min((size_t)record, body.size() - i));
+            if (!firstAt && g_resultCount > 0) firstAt = min(body.size(), i + record);
+        }
+        ddgFinish();
+        sus += nowUs() - t0; siters++;
+    } while (siters < 3 || nowUs() < budget);
+
+    bool same = sameResults(ref);
+    std::string next = ddgNext();
+    for (int rec : {1, 7, 64}) {
+        g_resultCount = 0; ddgParse(body, rec);
+        same &= sameResults(ref) && next == ddgNext();
+    }
+
+    // Further pages append; a url already listed is dropped, and the list
+    // stops at MAX_RESULTS with every string intact.
+    const char* bad = same ? nullptr : "STREAMING MISMATCH";
+    if (!bad && body.find("Next Page") != std::string::npos && next.find("&s=") == std::string::npos) bad = "NO NEXT PAGE";
+    int pages = 1, n1 = g_resultCount;
+    ddgParse(body, 1400);
+    if (!bad && g_resultCount != n1) bad = "DUPLICATES LISTED";
+    while (!bad && n1 && g_resultCount < MAX_RESULTS) {
+        std::string page, tag = "https://p" + std::to_string(pages) + ".";
+        for (size_t at = 0, hit; ; at = hit + 8) {
+            hit = body.find("https://", at);
+            page += body.substr(at, hit == std::string::npos ? std::string::npos : hit - at);
+            if (hit == std::string::npos) break;
+            page += tag;
+        }
+        int before = g_resultCount;
+        ddgParse(page, 1400); pages++;
+        std::vector<ResultCopy> want = ref;
+        for (auto& r : want) r.url = tag + r.url.substr(8);
+        want.resize(min((int)want.size(), MAX_RESULTS - before));
+        if (!sameResults(want, before)) bad = "PAGE NOT APPENDED";
+    }
+    if (!bad && n1 && (g_resultCount != MAX_RESULTS || !sameResults(ref, 0, n1))) bad = "FULL LIST WRONG";
+    g_resultCount = 0;
+    size_t old = MAX_RESULTS * (RESULT_TITLE_MAX + RESULT_URL_MAX + RESULT_SNIPPET_MAX);
+
+    printf("%-22s %8zu %8s %8.2f %9.1f %9.1f  results=%d/%d  buffered=%zu -> 0  first result after %zu bytes %s\n"
+           "  %d pages to fill %d results: %zu KB PSRAM, %zu KB as fixed slots; next: %s\n",
+           name, body.size(), "-", body.size() / (sus / siters), sus / siters, us / iters,
+           (int)ref.size(), MAX_RESULTS, body.size(), firstAt, bad ? bad : "", pages, MAX_RESULTS,
+           resultMemBytes() / 1024, old / 1024, next.empty() ? "(none)" : next.c_str());
+    return !bad;
+}
+
+// ---- Jina markdown ----------------------------------------------------------
+
+struct MdOut { std::string text; std::vector<StyleSpan> spans; std::vector<LineSpan> lines; std::vector<std::string> links; };
+
+static MdOut mdParse(const std::string& body, int record, double* us = nullptr) {
+    updateBaseDomain("https://www.example.ca/news/northern-winter");
+    ReplayStream s(body, record);
+    double t0 = nowUs();
+    readStream(&s, (int)body.size(), false, nullptr, nullptr, CODING_IDENTITY, FORMAT_MARKDOWN);
+    lineFeed(true);
+    if (us) *us += nowUs() - t0;
+    MdOut o; o.text = pageString();
+    o.spans.resize(g_spanCount); spanRead(0, o.spans.data(), g_spanCount);
+    o.lines.resize(g_lineCount); lineRead(0, o.lines.data(), g_lineCount);
+    o.links = linkList();
+    return o;
+}
+
+static bool sameMd(const MdOut& a, const MdOut& b) {
+    if (a.text != b.text || a.links != b.links || a.spans.size() != b.spans.size() || a.lines.size() != b.lines.size()) return false;
+    for (size_t i = 0; i < a.spans.size(); i++)
+        if (a.spans[i].start != b.spans[i].start || a.spans[i].style != b.spans[i].style || a.spans[i].link != b.spans[i].link) return false;
+    for (size_t i = 0; i < a.lines.size(); i++)
+        if (a.lines[i].start != b.lines[i].start || a.lines[i].len != b.lines[i].len || a.lines[i].block != b.lines[i].block) return false;
+    return true;
+}
+
+static uint8_t mdStyleAt(const MdOut& o, size_t pos) {
+    uint8_t st = BLK_TEXT;
+    for (auto& sp : o.spans) { if (sp.start > pos) break; st = sp.style; }
+    return st;
+}
+
+// One of each construct, against what the page store should end up holding.
+static bool mdSample() {
+    const char* doc =
+        "Title: Sample\nURL Source: https://www.example.ca/x\n\nMarkdown Content:\n"
+        "Big heading\n===========\n\n"
+        "Intro with **bold**, *em*, `code` and a [link](/a/b \"t\") plus snake_case_name.\n"
+        "Soft wrapped\ncontinuation.\n\n"
+        "## Sub [x](https://y.ca/) ##\n"
+        "*   item one\n-   item two\n1. first\n"
+        "> quoted\n"
+        "---\n"
+        "![Image 1: pic](https://img.example.ca/1.png)\n"
+        "```\n  int x = 1;\n```\n"
+        "| a | b |\n|---|---|\n"
+        "tail \\*not em\\*";
+    const char* want =
+        "Big heading\n"
+        "Intro with bold, em, code and a [1]link plus snake_case_name. Soft wrapped continuation.\n"
+        "Sub [2]x\n- item one\n- item two\n1. first\nquoted\n-\n  int x = 1;\n| a | b |\ntail *not em*";
+    std::string d = doc;
+    MdOut o = mdParse(d, 1400);
+    bool ok = o.text == want;
+    auto styleOf = [&](const char* what) { size_t at = o.text.find(what); return at == std::string::npos ? 0xFF : mdStyleAt(o, at); };
+    ok &= styleOf("Big") == BLK_H1 && styleOf("bold") == STY_BOLD && styleOf("em,") == STY_EM && styleOf("code") == STY_CODE;
+    ok &= styleOf("[1]link") == STY_LINK && styleOf("Sub") == BLK_H2 && (styleOf("[2]x") & ~BLK_MASK) == STY_LINK;
+    ok &= styleOf("quoted") == BLK_QUOTE && styleOf("  int") == BLK_PRE && styleOf("-\n") == BLK_RULE && styleOf("tail") == BLK_TEXT;
+    ok &= o.links.size() == 2 && o.links[0] == "https://www.example.ca/a/b" && o.links[1] == "https://y.ca/";
+    ok &= o.lines.size() >= 2 && o.lines[0].block == BLK_H1 && !o.lines[0].cont && o.lines[1].block == BLK_H1 && o.lines[1].cont;
+    for (int rec : {1, 3, 17}) ok &= sameMd(o, mdParse(d, rec));
+    // Nesting a hostile line deep stops at a few levels; the rest is text.
+    std::string deep = "x", emph = "x";
+    for (int i = 0; i < 150; i++) deep = "[" + deep + "](/u" + std::to_string(i % 10) + ")";
+    for (int i = 0; i < 250; i++) emph = (i & 1 ? "*" : "_") + emph + (i & 1 ? "*" : "_");
+    MdOut dl = mdParse(deep + "\n\n" + emph + "\n", 1400);
+    ok &= dl.links.size() >= 2 && dl.links.size() <= 8 && dl.text.find("x") != std::string::npos && dl.spans.size() < 32;
+    if (!ok) printf("markdown sample:\n%s\n", o.text.c_str());
+    return ok;
+}
+
+static bool benchMarkdown(const char* name, const std::string& body, int record) {
+    double mdUs = 0, htmlUs = 0; int iters = 0;
+    double budget = nowUs() + 200000;
+    MdOut o;
+    do {
+        o = mdParse(body, record, &mdUs);
+        updateBaseDomain("https://www.example.ca/news/northern-winter");
+        ReplayStream s(body, record);
+        double t0 = nowUs();
+        readStream(&s, (int)body.size(), false);
+        lineFeed(true);
+        htmlUs += nowUs() - t0; iters++;
+    } while (iters < 3 || nowUs() < budget);
+    size_t htmlOut = g_pageLen;
+
+    const char* bad = nullptr;
+    for (int rec : {1, 7, 64, 4096}) if (!sameMd(o, mdParse(body, rec))) { bad = "RECORD-SPLIT MISMATCH"; break; }
+    mdParse(body, record);
+    std::vector<LineSpan> inc(g_lineCount); lineRead(0, inc.data(), g_lineCount);
+    buildLineCache();
+    if (!sameLines(inc)) bad = "INCREMENTAL LINES MISMATCH";
+    if (o.text.find("](") != std::string::npos) bad = "MARKUP LEFT IN TEXT";
+    int heads = 0;
+    for (auto& l : o.lines) if (l.block >= BLK_H1 && l.block <= BLK_H3 && !l.cont) heads++;
+
+    printf("%-22s %8zu %8zu %8.2f %9.1f %9.1f  md  vs html %zu bytes %.2f MB/s, %zu spans (%zu B), %d headings, %zu links %s\n",
+           name, body.size(), o.text.size(), body.size() / (mdUs / iters), mdUs / iters, htmlUs / iters,
+           htmlOut, body.size() / (htmlUs / iters), o.spans.size(), o.spans.size() * sizeof(StyleSpan), heads,
+           o.links.size(), bad ? bad : "");
+    return !bad;
+}
+
+// ---- compressed bodies ----------------------------------------------------
+
+static std::string s_inflated;
+static bool inflatedSink(const uint8_t* p, size_t n) { s_inflated.append((const char*)p, n); return true; }
+
+static bool inflateAll(const std::string& wire, ContentCoding coding, int record) {
+    s_inflated.clear();
+    if (!inflateInit(coding, inflatedSink)) return false;
+    for (size_t i = 0; i < wire.size(); i += record)
+        if (!inflateFeed((const uint8_t*)wire.data() + i, min((size_t)record, wire.size() - i))) return false;
+    return inflateDone();
+}
+
+static uint32_t crc32(const std::string& s) {
+    uint32_t c = 0xFFFFFFFF;
+    for (unsigned char b : s) { c ^= b; for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320 & -(c & 1)); }
+    return ~c;
+}
+
+// .gz captures are gzip, .zz captures zlib or raw deflate. The inflated bytes
+// must be the same for every record split, match the gzip trailer (or the
+// uncompressed capture of the same name), and strip to the same page as the
+// identity path, streamed plain or chunked.
+static bool benchCoded(const char* name, const std::string& wire, ContentCoding coding, const std::string* twin, int record) {
+    const char* bad = nullptr;
+    double us = 0; int iters = 0;
+    double budget = nowUs() + 200000;
+    do {
+        double t0 = nowUs();
+        if (!inflateAll(wire, coding, record)) bad = "INFLATE FAILED";
+        us += nowUs() - t0; iters++;
+    } while (!bad && (iters < 3 || nowUs() < budget));
+    std::string body = s_inflated;
+    if (coding == CODING_GZIP && wire.size() >= 18) {
+        const uint8_t* t = (const uint8_t*)wire.data() + wire.size() - 8;
+        uint32_t crc = t[0] | t[1] << 8 | t[2] << 16 | (uint32_t)t[3] << 24;
+        uint32_t isz = t[4] | t[5] << 8 | t[6] << 16 | (uint32_t)t[7] << 24;
+        if (crc != crc32(body) || isz != (uint32_t)body.size()) bad = "GZIP TRAILER MISMATCH";
+    }
+    if (twin && *twin != body) bad = "INFLATE MISMATCH";
+    for (int rec : {1, 7, 4096})
+        if (!bad && (!inflateAll(wire, coding, rec) || s_inflated != body)) bad = "RECORD-SPLIT MISMATCH";
+
+    updateBaseDomain("https://www.example.ca/news/northern-winter");
+    stripBuffer((const uint8_t*)body.data(), body.size()); lineFeed(true);
+    std::string ref = pageString(); int refLines = g_lineCount;
+
+    double sus = 0; int siters = 0; bool shown = false;
+    budget = nowUs() + 200000;
+    for (bool chunked : {false, true})
+        for (int rec : {record, 1, 7}) {
+            std::string w = chunked ? chunkEncode(wire, 8192) : wire;
+            do {
+                updateBaseDomain("https://www.example.ca/news/northern-winter");
+                ReplayStream s(w, rec);
+                bool complete = false;
+                double t0 = nowUs();
+                readStream(&s, chunked ? -1 : (int)wire.size(), chunked, &complete, nullptr, coding);
+                lineFeed(true);
+                if (!chunked && rec == record) { sus += nowUs() - t0; siters++; }
+                if (!complete) bad = "TRANSFER INCOMPLETE";
+                if (pageString() != ref || g_lineCount != refLines) bad = "STRIP MISMATCH";
+            } while (!chunked && rec == record && !bad && (siters < 3 || nowUs() < budget));
+        }
+    updateBaseDomain("https://www.example.ca/news/northern-winter");
+    stripBuffer((const uint8_t*)wire.data(), wire.size(), coding); lineFeed(true);
+    if (pageString() != ref) bad = "STRIPBUFFER MISMATCH";
+
+    // A body cut short still shows what arrived; garbage fails without output.
+    std::string cut = wire.substr(0, wire.size() / 2);
+    shown = !inflateAll(cut, coding, record) && !s_inflated.empty() && !body.compare(0, s_inflated.size(), s_inflated);
+    if (!shown) bad = "TRUNCATED BODY MISHANDLED";
+    std::string junk(wire.size(), '\xA5');
+    if (inflateAll(junk, coding, record)) bad = "GARBAGE ACCEPTED";
+
+    printf("%-22s %8zu %8zu %8.2f %9.1f %9s %8s  %5.1f%% wire  inflate %.1f MB/s out %s\n",
+           name, wire.size(), ref.size(), wire.size() / (sus / siters), sus / siters, "-", "-",
+           100.0 * wire.size() / max((size_t)1, body.size()), body.size() / (us / iters), bad ? bad : "");
+    return !bad;
+}
+
+// ---- tag and entity names ----------------------------------------------------
+
+// What stripFeed did before html.cpp: a strcmp chain per tag and per entity.
+static bool oldBlockTag(const char* n) {
+    return (!strcmp(n,"p")||!strcmp(n,"div")||!strcmp(n,"br")||!strcmp(n,"h1")||
+            !strcmp(n,"h2")||!strcmp(n,"h3")||!strcmp(n,"h4")||!strcmp(n,"li")||
+            !strcmp(n,"tr")||!strcmp(n,"td")||!strcmp(n,"th")||!strcmp(n,"article")||
+            !strcmp(n,"section")||!strcmp(n,"header")||!strcmp(n,"footer")||
+            !strcmp(n,"nav")||!strcmp(n,"main"));
+}
+static int oldTagId(const char* n) {
+    if (!strcmp(n,"script")) return TAG_SCRIPT;
+    if (!strcmp(n,"style"))  return TAG_STYLE;
+    if (!strcmp(n,"head"))   return TAG_HEAD;
+    if (!strcmp(n,"a"))      return TAG_A;
+    return oldBlockTag(n) ? TAG_BLOCK : TAG_NONE;
+}
+static char oldEntity(const char* inner) {
+    if (!strcmp(inner,"amp"))    return '&';
+    if (!strcmp(inner,"nbsp"))   return ' ';
+    if (!strcmp(inner,"lt"))     return '<';
+    if (!strcmp(inner,"gt"))     return '>';
+    if (!strcmp(inner,"quot"))   return '"';
+    if (!strcmp(inner,"apos"))   return '\'';
+    if (!strcmp(inner,"mdash"))  return '-';
+    if (!strcmp(inner,"ndash"))  return '-';
+    if (!strcmp(inner,"hellip")) return '.';
+    if (inner[0] == '#') { int c2 = atoi(inner+1); if (c2>=32&&c2<128) return (char)c2; }
+    return ' ';
+}
+
+// Folded text of a reference body; UNKNOWN (never ASCII) if it doesn't decode.
+static const std::string UNKNOWN = "\xff";
+static std::string folded(const char* name) {
+    char u[8], f[16]; int ul = entityDecode(name, (int)strlen(name), u);
+    return ul ? std::string(f, asciiFold(u, ul, f)) : UNKNOWN;
+}
+
+// Tag names from the HTML captures plus every HTML5 entity name, looked up
+// the old way and through the hashes; then the stripper's tag rate on
+// article.html.
+static bool benchTags(const std::vector<std::string>& pages, const std::string& article) {
+    std::vector<std::string> tags, ents;
+    for (auto& b : pages)
+        for (size_t i = 0; i < b.size(); i++) {
+            if (b[i] == '<') {
+                size_t j = i + 1 + (b[i + 1] == '/');
+                std::string n;
+                while (j < b.size() && isalnum((uint8_t)b[j]) && n.size() < 15) n += (char)tolower(b[j++]);
+                if (!n.empty()) tags.push_back(n);
+            } else if (b[i] == '&') {
+                size_t semi = b.find(';', i);
+                if (semi != std::string::npos && semi - i <= 34) ents.push_back(b.substr(i + 1, semi - i - 1));
+            }
+        }
+    size_t pageTags = tags.size();
+    for (const char* t : {"p", "li", "td", "span", "img", "meta", "link", "h4", "footer", "aside", "strong", "em"})
+        tags.push_back(t);
+    for (int i = 0; i < NAMED_ENTITY_COUNT; i++) ents.push_back(NAMED_ENTITIES[i].name);
+    for (const char* e : {"#39", "#x2014", "#150", "#0", "#xD800", "#1114112", "bogus", "#", "#x"}) ents.push_back(e);
+
+    bool same = true;
+    for (auto& t : tags) {
+        uint8_t id = tagLookup(t.c_str(), (int)t.size());
+        int o = oldTagId(t.c_str());
+        same &= o == TAG_BLOCK ? (id & TAG_BLOCK) != 0 : id == o;
+    }
+    // The old table's names keep their meaning (hellip now folds to "...");
+    // everything in the HTML5 table decodes.
+    for (const char* e : {"amp", "nbsp", "lt", "gt", "quot", "apos", "mdash", "ndash", "hellip", "#39", "#65"})
+        same &= folded(e)[0] == oldEntity(e);
+    for (int i = 0; i < NAMED_ENTITY_COUNT; i++) same &= folded(NAMED_ENTITIES[i].name) != UNKNOWN;
+    const char* expect[][2] = {{"eacute", "e"}, {"Eacute", "E"}, {"copy", "(c)"}, {"frac12", "1/2"}, {"szlig", "ss"},
+                               {"hellip", "..."}, {"#x2014", "-"}, {"#150", "-"}, {"#x201C", "\""}, {"OElig", "OE"},
+                               {"shy", ""}, {"#0", " "}, {"#xD800", " "}, {"#1114112", " "}, {"iquest", "?"}, {"bogus", "\xff"}, {"#x", "\xff"}};
+    for (auto& e : expect) if (folded(e[0]) != e[1]) { printf("entity %s -> '%s'\n", e[0], folded(e[0]).c_str()); same = false; }
+
+    auto rate = [](const std::vector<std::string>& v, auto&& f) {
+        double budget = nowUs() + 100000, us = 0; long n = 0; volatile int sink = 0;
+        do {
+            double t0 = nowUs();
+            for (auto& s : v) sink += f(s);
+            us += nowUs() - t0; n += (long)v.size();
+        } while (nowUs() < budget);
+        return n / us;
+    };
+    double oldTags = rate(tags, [](const std::string& t) { return oldTagId(t.c_str()); });
+    double newTags = rate(tags, [](const std::string& t) { return (int)tagLookup(t.c_str(), (int)t.size()); });
+    double oldEnts = rate(ents, [](const std::string& e) { return (int)oldEntity(e.c_str()); });
+    double newEnts = rate(ents, [](const std::string& e) { char u[8]; return entityDecode(e.c_str(), (int)e.size(), u); });
+
+    long docTags = std::count(article.begin(), article.end(), '<');
+    double us = 0; int iters = 0;
+    for (double end = nowUs() + 200000; iters < 3 || nowUs() < end; iters++) {
+        updateBaseDomain("https://www.example.ca/news/northern-winter");
+        double t0 = nowUs();
+        stripInit(); stripBlock((const uint8_t*)article.data(), article.size()); lineFeed(true);
+        us += nowUs() - t0;
+    }
+    printf("\nnames: %zu tags (%zu from pages) strcmp %.1f / hash %.1f Mtags/s, %zu entities strcmp %.1f / hash %.1f M/s %s\n",
+           tags.size(), pageTags, oldTags, newTags, ents.size(), oldEnts, newEnts, same ? "" : "LOOKUP MISMATCH");
+    if (docTags) printf("article.html: %ld tags, stripped at %.2f Mtags/s\n", docTags, docTags / (us / iters));
+    return same;
+}
+
+// ---- blocked-page detection ----------------------------------------------------
+
+// pageIsBlocked before the matcher: lower-case 2 KB, one strstr per signature.
+static bool oldBlocked() {
+    if (g_pageLen<10) return true;
+    char buf[2049]; int scan=min((int)g_pageLen,2048);
+    pageRead(0,buf,scan);
+    for (int i=0;i<scan;i++) { buf[i]=tolower(buf[i]); }
+    buf[scan]=0;
+    const char* sigs[]={
+        "enable javascript","please enable","access denied","subscribe to continue",
+        "subscribe to read","sign in to read","create an account","log in to continue",
+        "you've reached your","premium content","403 forbidden","just a moment",
+        "checking your browser","ddos protection","ray id","verifying you are human",nullptr
+    };
+    for(int i=0;sigs[i];i++) if(strstr(buf,sigs[i])) return true;
+    return false;
+}
+
+static size_t s_blockTapBytes = 0;
+static bool blockTap(const uint8_t*, size_t n) { s_blockTapBytes += n; return !pageBlockHit(); }
+
+static std::string syntheticText(size_t bytes);
+
+// Every capture (HTML, and the markdown one) and every signature planted in plain text (mixed case, at
+// the top, mid-window, ending exactly at the window edge, straddling it),
+// judged both ways; then a Cloudflare-style interstitial followed by 200 KB
+// streamed through a tap that stops the body on a hit.
+static bool benchBlocked(const std::vector<std::string>& pages, const std::string& md) {
+    static const char* sigs[] = {"Enable JavaScript", "please enable", "ACCESS DENIED", "subscribe to continue",
+                                 "Subscribe to read", "sign in to read", "Create an account", "log in to continue",
+                                 "You've reached your", "premium content", "403 Forbidden", "Just a moment",
+                                 "Checking your browser", "DDoS protection", "Ray ID", "Verifying you are human"};
+    std::string filler = syntheticText(4096);
+    int cases = 0, hits = 0; bool same = true;
+    auto judge = [&](const std::string& body, PageFormat fmt) {
+        stripBuffer((const uint8_t*)body.data(), body.size(), CODING_IDENTITY, fmt);
+        bool now = pageIsBlocked(), old = oldBlocked();
+        same &= now == old; hits += now; cases++;
+    };
+    for (auto& b : pages) judge(b, FORMAT_HTML);
+    if (!md.empty()) judge(md, FORMAT_MARKDOWN);
+    for (const char* sig : sigs) {
+        size_t len = strlen(sig);
+        for (size_t at : {(size_t)0, (size_t)700, BLOCK_SCAN_BYTES - len, BLOCK_SCAN_BYTES - len + 1}) {
+            std::string t = filler.substr(0, at) + sig + filler.substr(at);
+            judge(t, FORMAT_MARKDOWN);
+        }
+    }
+    // A page read from the cache (written at 0) is judged afresh.
+    std::string clean = filler;
+    stripBuffer((const uint8_t*)"Just a moment...", 16, CODING_IDENTITY, FORMAT_MARKDOWN);
+    bool first = pageIsBlocked();
+    pageWrite(0, clean.data(), clean.size()); g_pageLen = clean.size();
+    same &= first && !pageIsBlocked();
+
+    double tOld = 0, tNew = 0; int iters = 0;
+    stripBuffer((const uint8_t*)filler.data(), filler.size(), CODING_IDENTITY, FORMAT_MARKDOWN);
+    for (double end = nowUs() + 100000; nowUs() < end; iters++) {
+        double t0 = nowUs(); volatile bool a = oldBlocked();
+        double t1 = nowUs(); pageWrite(0, filler.data(), 1); volatile bool b = pageIsBlocked();
+        tNew += nowUs() - t1; tOld += t1 - t0; (void)a; (void)b;
+    }
+
+    std::string wall = "# Just a moment...\n\nChecking your browser before accessing www.example.ca.\n\n";
+    while (wall.size() < 200000) wall += filler;
+    ReplayStream rs(wall, 1400); bool complete = true;
+    s_blockTapBytes = 0;
+    readStream(&rs, (int)wall.size(), false, &complete, blockTap, CODING_IDENTITY, FORMAT_MARKDOWN);
+    bool early = !complete && pageIsBlocked() && s_blockTapBytes <= 4096;
+
+    printf("\nblocked: %d pages judged, %d blocked, %s; 2 KB window strstr x16 %.1f us, one pass %.1f us; "
+           "interstitial stopped after %zu of %zu bytes %s\n",
+           cases, hits, same ? "same as strstr" : "MATCHER DISAGREES", tOld / iters, tNew / iters,
+           s_blockTapBytes, wall.size(), early ? "" : "NOT STOPPED EARLY");
+    return same && early;
+}
+
+// ---- segmented page store -------------------------------------------------
+
+// A plain-text body of roughly `bytes` that the stripper must pass through
+// unchanged: words, single spaces, one newline per paragraph.
+static std::string syntheticText(size_t bytes) {
+    static const char* words[] = {"maple", "the", "of", "Saskatchewan", "and", "northern", "a", "hockey",
+                                  "winter", "Confederation", "to", "lake", "is", "transcontinental", "in", "snow"};
+    std::string out; out.reserve(bytes + 256);
+    uint32_t x = 12345;
+    while (out.size() < bytes) {
+        int n = 20 + (x >> 7) % 180;
+        for (int i = 0; i < n; i++) {
+            x = x * 1103515245 + 12345;
+            if (i) out += ' ';
+            out += words[(x >> 16) & 15];
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+static bool benchStore() {
+    std::string body = syntheticText(5u << 20);
+    ReplayStream s(body, 1400);
+    double t0 = nowUs();
+    readStream(&s, (int)body.size(), false);
+    lineFeed(true);
+    double us = nowUs() - t0;
+    size_t mem = pageMemBytes();
+
+    // No byte lost, and the lines tile the text: anything between two spans is
+    // a wrap-eaten space or a newline.
+    bool same = g_pageLen == body.size() && pageString() == body;
+    uint32_t at = 0;
+    for (int i = 0; i < g_lineCount && same; i++) {
+        const LineSpan& l = lineAt(i);
+        for (; at < l.start; at++) if (body[at] != ' ' && body[at] != '\n') same = false;
+        if (l.len > CONT_COLS || memchr(body.data() + l.start, '\n', l.len)) same = false;
+        at = l.start + l.len;
+    }
+    for (; at < body.size(); at++) if (body[at] != ' ' && body[at] != '\n') same = false;
+
+    // Scrolling touches one LineSpan and one CONT_COLS copy per row wherever it is.
+    char row[CONT_COLS]; volatile char sink = 0; double st = nowUs();
+    for (int i = 0; i < g_lineCount; i++) { pageRead(lineAt(i).start, row, lineAt(i).len); sink = sink + row[0]; }
+    double perLine = (nowUs() - st) * 1000 / max(1, g_lineCount);
+    size_t textLen = g_pageLen; int lines = g_lineCount;
+
+    stripBuffer((const uint8_t*)"short page\n", 11); lineFeed(true); pageTrim();
+    printf("\nstore: %zu bytes -> %zu text, %d lines, %.1f MB/s, store %zu KB (%zu KB after trim), %.0f ns/line %s\n",
+           body.size(), textLen, lines, body.size() / us, mem / 1024, pageMemBytes() / 1024,
+           perLine, same ? "lossless" : "TEXT LOST");
+    return same;
+}
+
+// ---- links -------------------------------------------------------------------
+
+// A page of MAX_LINKS anchors, most on the page's own host, some relative:
+// they must resolve as before without touching the heap, and cost a fraction
+// of the fixed 256-byte slots they used to have. Each link's label must sit
+// where the table says, and the links on every screen of the page, found by
+// binary search the way drawPageBody finds them, must be the ones a walk of
+// the rows finds.
+static bool benchLinks() {
+    updateBaseDomain("https://www.example.ca/news/northern-winter");
+    currentURL = "https://www.example.ca/news/northern-winter";
+    std::string body = "<p>Links</p>";
+    std::vector<std::string> want;
+    for (int i = 0; i < MAX_LINKS + 4; i++) {
+        std::string href, abs;
+        switch (i % 5) {
+            case 0: href = "/news/story-" + std::to_string(i); abs = "https://www.example.ca" + href; break;
+            case 1: href = "story-" + std::to_string(i) + ".html"; abs = "https://www.example.ca/" + href; break;
+            case 2: href = "https://www.example.ca/sport/" + std::to_string(i); abs = href; break;
+            case 3: href = "//cdn" + std::to_string(i) + ".example.net/a"; abs = "https:" + href; break;
+            case 4: href = "https://other" + std::to_string(i % 3) + ".ca/x?id=" + std::to_string(i); abs = href; break;
+        }
+        body += "<a href=\"" + href + "\">link " + std::to_string(i) + "</a> ";
+        if ((int)want.size() < MAX_LINKS) want.push_back(abs);
+    }
+    body += "<a href=\"javascript:void(0)\">js</a> <a href=\"mailto:a@b.ca\">mail</a> <a href=\"#top\">top</a>";
+    size_t news = s_news;
+    double t0 = nowUs();
+    stripBuffer((const uint8_t*)body.data(), body.size(), CODING_IDENTITY, FORMAT_HTML);
+    double us = nowUs() - t0;
+    news = s_news - news;
+    bool same = linkList() == want;
+    size_t used = 0; char url[LINK_URL_LEN];
+    for (int i = 0; i < g_linkCount; i++) used += linkUrl(i, url, sizeof(url)) + 1;
+    lineFeed(true);
+    std::string text = pageString();
+    bool labels = true;
+    for (int i = 0; i < g_linkCount; i++)
+        labels &= text.compare(g_links[i].at, linkLabelLen(i), "[" + std::to_string(i + 1) + "]") == 0;
+
+    bool view = true; int screens = 0, most = 0;
+    double t1 = nowUs();
+    for (int top = 0; top + CONT_ROWS <= g_lineCount; top++, screens++) {
+        const LineSpan& last = lineAt(top + CONT_ROWS - 1);
+        int a = linkFirst(lineAt(top).start), b = linkFirst(last.start + last.len);
+        most = max(most, b - a);
+        view &= a == b || (g_links[a].at >= lineAt(top).start && g_links[b - 1].at < last.start + last.len);
+    }
+    double viewUs = (nowUs() - t1) / max(1, screens);
+    for (int top = 0; top + CONT_ROWS <= g_lineCount; top += 7) {
+        int a = -1, b = -1;
+        for (int li = top; li < top + CONT_ROWS; li++)
+            for (int i = 0; i < g_linkCount; i++)
+                if (g_links[i].at >= lineAt(li).start && g_links[i].at < lineAt(li).start + lineAt(li).len) {
+                    if (a < 0) a = i;
+                    b = i + 1;
+                }
+        const LineSpan& last = lineAt(top + CONT_ROWS - 1);
+        int fa = linkFirst(lineAt(top).start), fb = linkFirst(last.start + last.len);
+        view &= a < 0 ? fa == fb : fa == a && fb == b;
+    }
+    printf("\nlinks: %d on a page in %.1f us, %zu heap allocations; %zu B of urls in %zu B of pool and table, "
+           "%zu B as fixed slots; %d screens up to %d links each, %.2f us to find them %s\n",
+           g_linkCount, us, news, used, linkMemBytes(), (size_t)MAX_LINKS * LINK_URL_LEN, screens, most, viewUs,
+           !same ? "LINKS WRONG" : news ? "HEAP USED" : !labels ? "LABELS MOVED" : !view ? "SCREEN LINKS WRONG" : "");
+    return same && !news && labels && view;
+}
+
+// ---- reading list -----------------------------------------------------------
+
+struct PageCopy {
+    std::string text; std::vector<LineSpan> lines; std::vector<StyleSpan> spans; std::vector<std::string> links;
+    std::vector<uint32_t> ats;
+    bool operator==(const PageCopy& o) const {
+        return text == o.text && links == o.links && ats == o.ats && lines.size() == o.lines.size() && spans.size() == o.spans.size() &&
+               !memcmp(lines.data(), o.lines.data(), lines.size() * sizeof(LineSpan)) &&
+               !memcmp(spans.data(), o.spans.data(), spans.size() * sizeof(StyleSpan));
+    }
+};
+
+static PageCopy pageCopy() {
+    PageCopy c; c.text = pageString();
+    c.lines.resize(g_lineCount); lineRead(0, c.lines.data(), g_lineCount);
+    c.spans.resize(g_spanCount); spanRead(0, c.spans.data(), g_spanCount);
+    c.links = linkList();
+    for (int i = 0; i < g_linkCount; i++) c.ats.push_back(g_links[i].at);
+    return c;
+}
+
+static void stripPage(const std::string& body, PageFormat fmt) {
+    stripBuffer((const uint8_t*)body.data(), body.size(), CODING_IDENTITY, fmt); lineFeed(true);
+}
+
+// The rows drawPageBody would show from line0, read the way it reads them.
+static std::string screenText(int line0) {
+    pageEnsure(line0, CONT_ROWS);
+    std::string out; char row[CONT_COLS];
+    for (int i = line0; i < min(g_lineCount, line0 + CONT_ROWS); i++) {
+        const LineSpan& l = lineAt(i);
+        pageRead(l.start, row, l.len); out.append(row, l.len) += '\n';
+        spanFind(l.start);
+    }
+    return out;
+}
+
+static std::string fileBytes(const std::string& path) {
+    std::string s; FILE* f = fopen(path.c_str(), "rb"); if (!f) return s;
+    char buf[4096]; for (size_t n; (n = fread(buf, 1, sizeof(buf), f));) s.append(buf, n);
+    fclose(f); return s;
+}
+
+static void putFile(const std::string& path, const std::string& s) {
+    FILE* f = fopen(path.c_str(), "wb"); fwrite(s.data(), 1, s.size(), f); fclose(f);
+}
+
+static bool benchSaved(const std::string& md) {
+    char dir[] = "/tmp/rlbenchXXXXXX";
+    if (!mkdtemp(dir)) return false;
+    fakeFsRoot = dir;
+    static fs::FS flash; savedBegin(flash);
+    const char* bad = nullptr;
+    auto check = [&](bool ok, const char* what) { if (!ok && !bad) bad = what; };
+
+    stripPage("fresh text\n", FORMAT_MARKDOWN);
+    PageCopy fresh = pageCopy();
+
+    // A real page and a long one, each saved and then clobbered in memory.
+    String small = "https://example.ca/maple", big = "https://example.ca/long";
+    stripPage(md.empty() ? syntheticText(20000) : md, FORMAT_MARKDOWN);
+    PageCopy a = pageCopy();
+    check(savedStore(small), "STORE FAILED");
+    std::string longText = syntheticText(600000);
+    stripPage(longText, FORMAT_MARKDOWN);
+    PageCopy b = pageCopy();
+    check(savedStore(big), "STORE FAILED");
+    stripPage("something else\n", FORMAT_MARKDOWN);
+
+    // Opening reads the head and the links; the first screen a segment or two more.
+    fakeFsReads = fakeFsBytesRead = 0;
+    double t0 = nowUs();
+    check(savedLoad(small), "LOAD FAILED");
+    double openUs = nowUs() - t0;
+    size_t openBytes = fakeFsBytesRead;
+    std::string first;
+    for (int i = 0; i < min((int)a.lines.size(), CONT_ROWS); i++) {
+        first += a.text.substr(a.lines[i].start, a.lines[i].len) + '\n';
+    }
+    check(screenText(0) == first, "FIRST SCREEN WRONG");
+    size_t firstBytes = fakeFsBytesRead;
+    check(pageCopy() == a, "SMALL PAGE CHANGED");
+
+    // Mid-page on the long one: one segment of each store, not the file.
+    check(savedLoad(big), "LOAD FAILED");
+    int mid = g_lineCount / 2;
+    fakeFsReads = fakeFsBytesRead = 0;
+    std::string want;
+    for (int i = mid; i < min((int)b.lines.size(), mid + CONT_ROWS); i++) want += b.text.substr(b.lines[i].start, b.lines[i].len) + '\n';
+    check(screenText(mid) == want, "MID SCREEN WRONG");
+    size_t midBytes = fakeFsBytesRead, midReads = fakeFsReads;
+    check(midBytes <= 2 * PAGE_SEG_SIZE + 2 * LINE_SEG_SIZE * sizeof(LineSpan) + 2 * SPAN_SEG_SIZE * sizeof(StyleSpan),
+          "MID SCREEN READ TOO MUCH");
+    check(pageCopy() == b, "LONG PAGE CHANGED");
+    size_t fileSize = fileBytes(std::string(dir) + "/" + [&] {
+        File d = flash.open("/"); std::string n;
+        for (File f = d.openNextFile(); f; f = d.openNextFile()) if (f.size() > longText.size()) n = f.name();
+        return n; }()).size();
+
+    // Damaged or foreign files leave the current page alone.
+    check(!savedLoad("https://example.ca/never-saved"), "MISSING PAGE LOADED");
+    stripPage(md.empty() ? syntheticText(20000) : md, FORMAT_MARKDOWN);
+    PageCopy before = pageCopy();
+    std::string path;
+    { File d = flash.open("/"); for (File f = d.openNextFile(); f; f = d.openNextFile()) if (f.size() < longText.size()) path = std::string(dir) + "/" + f.name(); }
+    std::string good = fileBytes(path);
+    int rejected = 0;
+    auto damaged = [&](std::string s) {
+        putFile(path, s); bool loaded = savedLoad(small);
+        rejected += !loaded; check(!loaded && pageCopy() == before, "DAMAGED FILE ACCEPTED");
+    };
+    damaged(good.substr(0, good.size() - 1));
+    damaged(good.substr(0, sizeof(SavedHead) - 2));
+    { std::string s = good; s[0] = 'X'; damaged(s); }
+    { std::string s = good; SavedHead h; memcpy(&h, s.data(), sizeof(h)); h.lineCount = MAX_LINES + 1; memcpy(&s[0], &h, sizeof(h)); damaged(s); }
+    { std::string s = good; SavedHead h; memcpy(&h, s.data(), sizeof(h)); h.textOff += 2; memcpy(&s[0], &h, sizeof(h)); damaged(s); }
+    { std::string s = good; SavedHead h; memcpy(&h, s.data(), sizeof(h)); s[sizeof(h) + 8] ^= 1; damaged(s); }
+    putFile(path, good);
+
+    // List, overwrite and remove, including the file behind the current page.
+    SavedInfo list[SAVED_MAX];
+    int n = savedList(list, SAVED_MAX);
+    check(n == 2 && savedHas(small) && savedHas(big), "LIST WRONG");
+    check(n == 2 && strcasecmp(list[0].title, list[1].title) <= 0, "LIST NOT SORTED");
+    check(savedLoad(small) && savedStore(small) && pageCopy() == a && savedLoad(small) && pageCopy() == a, "RESAVE LOST PAGE");
+    check(savedLoad(big) && savedRemove(big) && !savedHas(big) && pageCopy() == b, "REMOVE LOST PAGE");
+    check(savedList(list, SAVED_MAX) == 1 && !strcmp(list[0].url, small.c_str()), "REMOVE LEFT ENTRY");
+
+    // A fresh strip drops the file behind the page.
+    check(savedLoad(small), "LOAD FAILED");
+    stripPage("fresh text\n", FORMAT_MARKDOWN);
+    check(pageCopy() == fresh, "STRIP AFTER SAVED PAGE WRONG");
+    check(savedRemove(small) && savedList(list, SAVED_MAX) == 0, "REMOVE FAILED");
+    rmdir(dir);
+
+    printf("\nsaved: %zu B page opens reading %zu B (%.0f us), first screen +%zu B; %zu KB file, mid-page screen "
+           "%zu B in %zu reads; %d damaged files rejected %s\n",
+           a.text.size(), openBytes, openUs, firstBytes - openBytes, fileSize / 1024, midBytes, midReads,
+           rejected, bad ? bad : "");
+    return !bad;
+}
+
+// ---- page cache -------------------------------------------------------------
+
+// Back and revisits: a page comes back whole, the least recently used goes
+// first once the slots or the byte budget run out, and a page over the
+// budget on its own is never kept.
+static bool benchCache() {
+    const char* bad = nullptr;
+    auto check = [&](bool ok, const char* what) { if (!ok && !bad) bad = what; };
+    auto url = [](int i) { return String(("https://example.ca/p" + std::to_string(i)).c_str()); };
+
+    std::vector<PageCopy> pages;
+    for (int i = 0; i <= PAGE_CACHE_SLOTS; i++) {
+        stripPage("# Page " + std::to_string(i) + "\n\n[a link](/x" + std::to_string(i) + ")\n\n" + syntheticText(3000 + i * 100),
+                  FORMAT_MARKDOWN);
+        pages.push_back(pageCopy());
+        cacheStore(url(i));
+        if (i == 1) { check(cacheLoad(url(0)), "LOAD FAILED"); check(pageCopy() == pages[0], "PAGE CHANGED"); }
+    }
+    // p0 was used after p1 went in, so p1 is the one a seventeenth page pushes out.
+    check(cacheCount() == PAGE_CACHE_SLOTS, "SLOTS WRONG");
+    check(!cacheLoad(url(1)), "LRU KEPT");
+    double t0 = nowUs();
+    check(cacheLoad(url(0)) && pageCopy() == pages[0], "USED PAGE DROPPED");
+    double loadUs = nowUs() - t0;
+    check(cacheLoad(url(PAGE_CACHE_SLOTS)) && pageCopy() == pages[PAGE_CACHE_SLOTS], "NEWEST PAGE WRONG");
+
+    // Big pages: the budget holds two of them, and the rest make room.
+    std::string big = syntheticText(PAGE_CACHE_BUDGET * 2 / 5);
+    for (int i = 0; i < 3; i++) {
+        stripPage(big + std::to_string(i) + "\n", FORMAT_MARKDOWN);
+        cacheStore(url(100 + i));
+        check(cacheBytes() <= PAGE_CACHE_BUDGET, "OVER BUDGET");
+    }
+    check(cacheLoad(url(102)) && cacheLoad(url(101)), "BIG PAGE DROPPED");
+    size_t bytes = cacheBytes(); int count = cacheCount();
+    stripPage(syntheticText(PAGE_CACHE_BUDGET + 1024), FORMAT_MARKDOWN);
+    cacheStore(url(200));
+    check(!cacheLoad(url(200)) && cacheBytes() == bytes && cacheCount() == count, "OVERSIZED PAGE KEPT");
+    for (int i = 0; i < 300; i++) cacheDrop(url(i));
+    check(cacheCount() == 0 && cacheBytes() == 0, "DROP LEFT BYTES");
+
+    printf("\ncache: %d slots, %zu KB budget; %d pages held at the end, %zu KB; a %zu B page back in %.0f us %s\n",
+           PAGE_CACHE_SLOTS, (size_t)PAGE_CACHE_BUDGET / 1024, count, bytes / 1024, pages[0].text.size(), loadUs,
+           bad ? bad : "");
+    return !bad;
+}
+
+// ---- find in page -----------------------------------------------------------
+
+static bool refWord(uint8_t c) { return c >= 0x80 || isalnum(c); }
+
+// Every offset findQuery should return, by brute force.
+static std::vector<uint32_t> refFind(const std::string& text, const std::string& q) {
+    std::vector<uint32_t> out;
+    bool atWord = refWord((uint8_t)q[0]);
+    for (size_t p = 0; p + q.size() <= text.size() && out.size() < FIND_MAX_HITS; p++) {
+        if (atWord && p > 0 && refWord((uint8_t)text[p - 1])) continue;
+        size_t i = 0;
+        while (i < q.size() && tolower((uint8_t)text[p + i]) == tolower((uint8_t)q[i])) i++;
+        if (i == q.size()) out.push_back((uint32_t)p);
+    }
+    return out;
+}
+
+static std::vector<uint32_t> hits(const std::string& q) {
+    std::vector<uint32_t> out(findQuery(q.c_str()));
+    for (size_t i = 0; i < out.size(); i++) out[i] = findHit((int)i);
+    return out;
+}
+
+// Queries drawn from the page: whole words, prefixes, other cases, short
+// words with what follows, word middles (which must not match), punctuation
+// and words that aren't there.
+static std::vector<std::string> findQueries(const std::string& text) {
+    std::vector<std::string> qs = {"zzqx", "Saskatchewan", "the", "of the", "th", "a", "e", ". ", "atchewan", "1", "é"};
+    uint32_t x = 99;
+    for (int i = 0; i < 120 && text.size() > 64; i++) {
+        x = x * 1103515245 + 12345;
+        size_t p = (x >> 4) % (text.size() - 40);
+        while (p < text.size() && refWord((uint8_t)text[p])) p++;
+        while (p < text.size() && !refWord((uint8_t)text[p])) p++;
+        size_t e = p; while (e < text.size() && refWord((uint8_t)text[e])) e++;
+        if (e == p || e - p > 30) continue;
+        std::string w = text.substr(p, e - p);
+        switch (i % 6) {
+            case 0: qs.push_back(w); break;
+            case 1: qs.push_back(w.substr(0, min((size_t)4, w.size()))); break;
+            case 2: { std::string u = w; for (auto& c : u) c = (char)toupper((uint8_t)c); qs.push_back(u); break; }
+            case 3: qs.push_back(text.substr(p, min((size_t)(e - p + 5), text.size() - p))); break;
+            case 4: if (w.size() > 3) qs.push_back(w.substr(1)); break;
+            case 5: qs.push_back(w.substr(0, 2)); break;
+        }
+    }
+    return qs;
+}
+
+static bool benchFindDoc(const char* name, const std::string& body, PageFormat fmt) {
+    const char* bad = nullptr;
+    auto check = [&](bool ok, const char* what) { if (!ok && !bad) bad = what; };
+
+    // Indexed while it streams in small records, the way a page load feeds it.
+    ReplayStream rs(body, 7);
+    double t0 = nowUs();
+    readStream(&rs, (int)body.size(), false, nullptr, nullptr, CODING_IDENTITY, fmt);
+    lineFeed(true);
+    double loadUs = nowUs() - t0;
+    std::string text = pageString();
+    uint32_t indexed = findIndexed();
+    std::vector<std::string> qs = findQueries(text);
+    std::vector<std::vector<uint32_t>> streamed;
+    for (auto& q : qs) streamed.push_back(hits(q));
+
+    // The same index built in one go, timed.
+    double build = 0; int builds = 0;
+    for (double end = nowUs() + 100000; nowUs() < end || !builds; builds++) {
+        findReset(); double b0 = nowUs(); findFeed(true); build += nowUs() - b0;
+    }
+    build /= builds;
+    size_t indexBytes = findIndexBytes();
+
+    double idxUs = 0, scanUs = 0, refUs = 0, rowNs = 0, rareIdx = 0, rareScan = 0; long nHits = 0, rows = 0;
+    std::vector<bool> rare;
+    for (size_t i = 0; i < qs.size(); i++) {
+        double a = nowUs(); std::vector<uint32_t> want = refFind(text, qs[i]); refUs += nowUs() - a;
+        a = nowUs(); std::vector<uint32_t> got = hits(qs[i]); double us = nowUs() - a; idxUs += us;
+        rare.push_back(want.size() <= 16); if (rare.back()) rareIdx += us;
+        check(got == want, "INDEX DISAGREES");
+        check(streamed[i] == want, "STREAMED INDEX DISAGREES");
+        nHits += got.size();
+        // Each hit lands on the row that shows it.
+        a = nowUs();
+        for (uint32_t h : got) {
+            int r = findRow(h); rows++;
+            LineSpan l = lineAt(r);
+            bool under = l.start <= h;
+            int nx = r + 1; while (nx < g_lineCount && lineAt(nx).cont) nx++;
+            check(under && (nx >= g_lineCount || lineAt(nx).start > h) && !l.cont, "HIT ON WRONG ROW");
+        }
+        rowNs += (nowUs() - a) * 1000;
+    }
+    // The whole page unindexed, as a page from the cache or flash comes.
+    findReset();
+    for (size_t i = 0; i < qs.size(); i++) {
+        double a = nowUs(); std::vector<uint32_t> got = hits(qs[i]); double us = nowUs() - a; scanUs += us;
+        if (rare[i]) rareScan += us;
+        check(got == refFind(text, qs[i]), "SCAN DISAGREES");
+    }
+    findFeed(true);
+    int n = (int)qs.size(), nRare = (int)std::count(rare.begin(), rare.end(), true);
+    printf("%-22s %7zu B %6.1f MB/s build (%.1f ms load), index %4zu KB over %4zu KB%s\n"
+           "  %3d queries: %6.1f us indexed, %6.1f us SWAR, %7.1f us brute; %3d with <=16 hits: %5.1f us indexed, "
+           "%6.1f us SWAR; %ld hits, %.0f ns/row %s\n",
+           name, text.size(), text.size() / build, loadUs / 1000, indexBytes / 1024, (size_t)findIndexed() / 1024,
+           indexed < text.size() ? " (capped)" : "", n, idxUs / n, scanUs / n, refUs / n, nRare,
+           rareIdx / max(1, nRare), rareScan / max(1, nRare), nHits, rowNs / max(1L, rows), bad ? bad : "");
+    return !bad;
+}
+
+static bool benchFind(const std::string& md) {
+    printf("\nfind in page:\n");
+    bool ok = benchFindDoc("(synthetic 200KB)", syntheticText(200000), FORMAT_MARKDOWN);
+    if (!md.empty()) {
+        std::string big; while (big.size() < 200000) big += md + "\n\n";
+        ok &= benchFindDoc("(jina x200KB)", big, FORMAT_MARKDOWN);
+    }
+    // Past FIND_MAX_WORDS the rest of the page is scanned.
+    ok &= benchFindDoc("(synthetic 1.5MB)", syntheticText(1500000), FORMAT_MARKDOWN);
+    return ok;
+}
+
+// ---- local index -------------------------------------------------------------
+
+struct RefDoc { std::string url; std::set<std::string> words; bool live; };
+
+// What localAdd should index: folded words of 2..LOCAL_WORD_MAX bytes, the
+// first LOCAL_TERMS distinct ones.
+static std::set<std::string> refWords(const std::string& text) {
+    std::set<std::string> w; std::string cur;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i < text.size() && refWord((uint8_t)text[i])) { cur += (char)tolower((uint8_t)text[i]); continue; }
+        if (cur.size() >= 2 && cur.size() <= LOCAL_WORD_MAX && w.size() < LOCAL_TERMS) w.insert(cur);
+        cur.clear();
+    }
+    return w;
+}
+
+static std::set<std::string> refQuery(const std::vector<RefDoc>& docs, const std::string& q) {
+    std::set<std::string> want, out;
+    for (auto& w : refWords(q)) want.insert(w);
+    if (want.empty()) return out;
+    for (auto& d : docs) {
+        bool all = d.live;
+        for (auto& w : want) all = all && d.words.count(w);
+        if (all) out.insert(d.url);
+    }
+    return out;
+}
+
+static bool benchLocal(const std::vector<std::string>& pages, const std::string& md) {
+    printf("\nlocal index:\n");
+    char dir[] = "/tmp/lxbenchXXXXXX";
+    if (!mkdtemp(dir)) return false;
+    fakeFsRoot = dir;
+    static fs::FS flash; localBegin(flash);
+    const char* bad = nullptr;
+    auto check = [&](bool ok, const char* what) { if (!ok && !bad) bad = what; };
+
+    std::vector<RefDoc> ref;
+    std::vector<std::string> qs = {"zzqx", "the", "canada"};
+    double addUs = 0, flushUs = 0; size_t textBytes = 0; int flushes = 0;
+    std::string docsPath = std::string(dir) + LOCAL_DOCS_FILE;
+    // Adding writes nothing; the flush after every LOCAL_PENDING pages does, as loop() would.
+    auto add = [&](const std::string& url, const std::string& body, PageFormat fmt) {
+        stripPage(body, fmt);
+        std::string text = pageString();
+        size_t docsBytes = fileBytes(docsPath).size();
+        double t0 = nowUs();
+        check(localAdd(url.c_str()), "ADD FAILED");
+        addUs += nowUs() - t0; textBytes += text.size();
+        check(fileBytes(docsPath).size() == docsBytes, "ADD WROTE TO FLASH");
+        if (localStats().pending >= LOCAL_PENDING) {
+            t0 = nowUs(); check(localFlush(false), "FLUSH FAILED"); flushUs += nowUs() - t0; flushes++;
+            check(localStats().pending == 0, "FLUSH HELD PAGES");
+        }
+        for (auto& d : ref) if (d.url == url) d.live = false;
+        ref.push_back({url, refWords(text), true});
+        int live = 0;
+        for (auto& d : ref) live += d.live;
+        for (auto& d : ref) if (live > LOCAL_MAX_DOCS && d.live) { d.live = false; live--; }
+    };
+    const int synth = 2 * LOCAL_MAX_DOCS + 40;           // enough to compact /lx-docs once
+    for (int i = 0; i < synth; i++) {
+        // Every tenth page is an earlier url read again.
+        std::string url = "https://example.ca/p" + std::to_string(i % 10 == 9 ? i - 7 : i);
+        std::string body = "Page mk" + std::to_string(i) + " group" + std::to_string(i % 7) + " tier" +
+                           std::to_string(i % 3) + "\n\n" + syntheticText(2000 + (i * 37) % 3000);
+        add(url, body, FORMAT_MARKDOWN);
+        if (i % 9 == 0) qs.push_back("mk" + std::to_string(i));
+        if (i % 13 == 0) qs.push_back("group" + std::to_string(i % 7) + " Tier" + std::to_string(i % 3));
+    }
+    for (int i = 0; i < 7; i++) qs.push_back("group" + std::to_string(i));
+    for (size_t i = 0; i < pages.size(); i++) add("https://capture.ca/" + std::to_string(i), pages[i], FORMAT_HTML);
+    if (!md.empty()) add("https://capture.ca/md", md, FORMAT_MARKDOWN);
+    for (size_t i = 0; i < ref.size(); i += 17) {
+        auto it = ref[i].words.begin(); std::advance(it, ref[i].words.size() / 2);
+        qs.push_back(*it);
+        if (ref[i].words.size() > 3) qs.push_back(*it + " " + *ref[i].words.begin());
+    }
+
+    LocalHit out[LOCAL_MAX_DOCS + 1];
+    double qUs = 0; long nHits = 0;
+    auto runQueries = [&](bool timed) {
+        for (auto& q : qs) {
+            double t0 = nowUs();
+            int n = localQuery(q.c_str(), out, LOCAL_MAX_DOCS + 1);
+            if (timed) qUs += nowUs() - t0, nHits += n;
+            std::set<std::string> got;
+            for (int i = 0; i < n; i++) { got.insert(out[i].url); check(!i || out[i].score <= out[i - 1].score, "NOT BEST FIRST"); }
+            check((int)got.size() == n, "SAME PAGE TWICE");
+            check(got == refQuery(ref, q), timed ? "QUERY DISAGREES" : "RELOADED QUERY DISAGREES");
+        }
+    };
+    runQueries(true);
+    check(localStats().pending > 0, "NOTHING HELD");
+    check(localFlush(true) && localStats().pending == 0, "FLUSH FAILED");
+    runQueries(false);
+    LocalStats st = localStats();
+    check(st.live == LOCAL_MAX_DOCS, "LIVE COUNT WRONG");
+    for (auto& d : ref) {
+        bool live = false;
+        for (auto& e : ref) live |= e.live && e.url == d.url;
+        check(localHas(d.url.c_str()) == live, "LOCALHAS WRONG");
+    }
+    check(!localHas("https://example.ca/none"), "LOCALHAS WRONG");
+
+    // A reset mid-append leaves part of a record behind.
+    { FILE* f = fopen((std::string(dir) + LOCAL_DOCS_FILE).c_str(), "ab"); fwrite("\x07\x00\x00", 1, 3, f); fclose(f); }
+    double t0 = nowUs();
+    localBegin(flash);
+    double loadUs = nowUs() - t0;
+    check(localStats().segments == st.segments && localStats().live == st.live, "RELOAD LOST SEGMENTS");
+    runQueries(false);
+    { File d = flash.open("/"); for (File f = d.openNextFile(); f; f = d.openNextFile()) flash.remove((std::string("/") + f.name()).c_str()); }
+    rmdir(dir);
+
+    int n = (int)qs.size();
+    printf("%d pages (%zu KB text): %.1f MB/s indexed, %.2f ms per page held; %d flushes of %d, %.2f ms each; "
+           "%d live in %d segments, %zu KB, %zu B/page\n"
+           "  %d queries: %.1f us each, %.1f hits; reload %.1f ms %s\n",
+           (int)ref.size(), textBytes / 1024, textBytes / addUs, addUs / 1000 / ref.size(), flushes, LOCAL_PENDING,
+           flushUs / 1000 / max(1, flushes), st.live, st.segments,
+           st.bytes / 1024, st.bytes / max(1, st.live), n, qUs / n, (double)nHits / n, loadUs / 1000, bad ? bad : "");
+    return !bad;
+}
+
+// ---- glyph runs -------------------------------------------------------------
+
+static uint16_t s_fb[SCREEN_W * SCREEN_H];
+
+static uint16_t panelOrder(uint16_t c) { return (uint16_t)((c >> 8) | (c << 8)); }
+
+// TFT_eSPI::drawChar, textfont 1, size 1, opaque background.
+static void refChar(int x, int y, uint8_t c, uint16_t fg, uint16_t bg) {
+    if (x >= SCREEN_W || y >= SCREEN_H || x + 5 < 0 || y + 7 < 0) return;
+    for (int j = 0; j < GLCD_H; j++)
+        for (int k = 0; k < GLCD_W; k++) {
+            int px = x + k, py = y + j;
+            if (px < 0 || px >= SCREEN_W || py < 0 || py >= SCREEN_H) continue;
+            bool on = k < 5 && ((font[c * 5 + k] >> j) & 1);
+            s_fb[py * SCREEN_W + px] = panelOrder(on ? fg : bg);
+        }
+}
+
+// One non-ASCII cell: the atlas coverage blended channel by channel.
+static void refGlyph(int x, int y, uint32_t cp, uint16_t fg, uint16_t bg) {
+    for (int j = 0; j < GLCD_H; j++)
+        for (int k = 0; k < GLCD_W; k++) {
+            int px = x + k, py = y + j;
+            if (px < 0 || px >= SCREEN_W || py < 0 || py >= SCREEN_H) continue;
+            int a = glyphCoverage(cp, k, j), c = 0;
+            for (int sh : {11, 5, 0}) {
+                int m = sh == 5 ? 0x3F : 0x1F;
+                c |= ((((fg >> sh) & m) * a + ((bg >> sh) & m) * (15 - a) + 7) / 15) << sh;
+            }
+            s_fb[py * SCREEN_W + px] = panelOrder((uint16_t)c);
+        }
+}
+
+// tft.print a code point at a time: '\n' and right-edge wrap as TFT_eSPI
+// does, ASCII through drawChar and the rest from the atlas.
+static void refPrint(int& x, int& y, const char* s, int n, uint16_t fg, uint16_t bg) {
+    for (int i = 0; i < n;) {
+        uint8_t c = (uint8_t)s[i];
+        if (c == '\n') { y += GLCD_H; x = 0; i++; continue; }
+        uint32_t cp = c;
+        if (c < 0x80) i++;
+        else { i += utf8Get((const uint8_t*)s + i, n - i, cp); if (!utf8Cell(c)) continue; }
+        if (x + GLCD_W > SCREEN_W) { y += GLCD_H; x = 0; }
+        if (c < 0x80) refChar(x, y, c, fg, bg); else refGlyph(x, y, cp, fg, bg);
+        x += GLCD_W;
+    }
+}
+
+// main.cpp's textRun with pushImage landing in s_fb.
+static void runPrint(int x, int y, const char* s, int n, uint16_t fg, uint16_t bg) {
+    static uint16_t buf[SCREEN_W * GLCD_H];
+    int i = 0;
+    while (i < n) {
+        int cols, k = textRunLen(s + i, n - i, (SCREEN_W - x) / GLCD_W, cols);
+        if (k > 0 && fg != bg) {
+            int w = textRaster(buf, cols * GLCD_W, s + i, k, fg, bg);
+            for (int j = 0; j < GLCD_H && y + j < SCREEN_H; j++)
+                memcpy(s_fb + (y + j) * SCREEN_W + x, buf + j * w, w * sizeof(uint16_t));
+            x += w; i += k; continue;
+        }
+        refPrint(x, y, s + i, 1, fg, bg); i++;
+    }
+}
+
+static bool benchText(const char* name, const std::string& body) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < body.size();) {
+        size_t j = i; int cols = 0;
+        while (j < body.size() && (cols < CONT_COLS - 1 || !utf8Cell((uint8_t)body[j]))) cols += utf8Cell((uint8_t)body[j++]);
+        lines.push_back(body.substr(i, j - i)); i = j;
+    }
+    // A stray Latin-1 byte (drawn as U+FFFD) mid-run, and a control byte
+    // that takes the tft.print path.
+    for (size_t i = 3; i < lines.size(); i += 7) if (lines[i].size() > 9 && (uint8_t)lines[i][5] < 0x80) { lines[i][5] = (char)0xE9; lines[i][9] = '\t'; }
+
+    static uint16_t ref[SCREEN_W * SCREEN_H];
+    const uint16_t fgs[] = {0x0000, 0xFFFF, 0x4208}, bgs[] = {0xFFFF, 0xF800, 0x4208};
+    bool same = true; long px = 0;
+    double refUs = 0, runUs = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        uint16_t fg = fgs[pass], bg = bgs[pass];
+        for (size_t i = 0; i < lines.size(); i++) {
+            const std::string& l = lines[i];
+            int x0 = (int)(i % 9) * 3, y0 = CONT_Y + (int)(i % CONT_ROWS) * CHAR_H;
+            memset(s_fb, 0, sizeof(s_fb));
+            double t0 = nowUs();
+            int x = x0, y = y0; refPrint(x, y, l.data(), (int)l.size(), fg, bg);
+            refUs += nowUs() - t0;
+            memcpy(ref, s_fb, sizeof(ref));
+            memset(s_fb, 0, sizeof(s_fb));
+            t0 = nowUs();
+            runPrint(x0, y0, l.data(), (int)l.size(), fg, bg);
+            runUs += nowUs() - t0;
+            same &= !memcmp(ref, s_fb, sizeof(ref));
+            px += (long)textColumns(l.data(), (int)l.size()) * GLCD_W * GLCD_H;
+        }
+    }
+    printf("\ntext %s: %zu lines x3 colour pairs, %ld px, per-char %.1f Mpx/s, runs %.1f Mpx/s %s\n",
+           name, lines.size(), px, px / refUs, px / runUs, same ? "pixel-identical" : "FRAMEBUFFER MISMATCH");
+    return same;
+}
+
+// ---- UTF-8 text ---------------------------------------------------------------
+
+static const char* FRENCH_HTML =
+    "<p>L&rsquo;&Icirc;le-d&#8217;Orl&eacute;ans&nbsp;: caf&#xE9;, cr&egrave;me br&ucirc;l&eacute;e et "
+    "c&oelig;ur &mdash; 5&nbsp;&euro;&hellip;&shy;</p><p>Montréal, Trois-Rivières, Sept-Îles, Gaspé.</p>";
+static const char* FRENCH_TEXT =
+    "L’Île-d’Orléans : café, crème brûlée et cœur — 5 €…\nMontréal, Trois-Rivières, Sept-Îles, Gaspé.\n";
+
+static std::string frenchBody(size_t bytes) {
+    static const char* words[] = {"été", "québécois", "à", "la", "forêt", "boréale", "où", "l’on", "pêche",
+                                  "déjà", "près", "du", "fleuve", "Saint-Laurent", "Île", "naïve"};
+    std::string out = "<article>";
+    uint32_t x = 777;
+    while (out.size() < bytes) {
+        out += "<p>";
+        for (int i = 0, n = 12 + (x >> 9) % 90; i < n; i++) {
+            x = x * 1103515245 + 12345;
+            if (i) out += ' ';
+            out += words[(x >> 16) & 15];
+        }
+        // One word too long for any row, split mid-word on a cell boundary.
+        if ((x >> 20 & 7) == 0) { out += ' '; for (int i = 0; i < CONT_COLS + 7; i++) out += "é"; }
+        out += "</p>";
+    }
+    return out + "</article>";
+}
+
+// A 2-glyph .vlw: é lands in the direct table, U+4E2D in the hashed one.
+static std::string tinyVlw() {
+    std::string v;
+    auto put = [&](uint32_t w) { for (int sh = 24; sh >= 0; sh -= 8) v += (char)(w >> sh); };
+    for (uint32_t w : {2u, 11u, 8u, 0u, 7u, 1u}) put(w);
+    for (uint32_t w : {0xE9u, 3u, 2u, 6u, 5u, 1u, 0u}) put(w);
+    for (uint32_t w : {0x4E2Du, 1u, 6u, 6u, 0u, 0u, 0u}) put(w);
+    v += std::string("\xFF\x80\x10\x00\xF0\x0F", 6);
+    v += std::string("\x00\x30\x60\x90\xC0\xF0", 6);
+    return v;
+}
+
+static bool benchUtf8() {
+    const char* bad = nullptr;
+    std::string fr(FRENCH_HTML);
+    stripBuffer((const uint8_t*)fr.data(), fr.size());
+    buildLineCache();
+    if (pageString() != FRENCH_TEXT) { printf("utf8 text: '%s'\n", pageString().c_str()); bad = "ENTITY TEXT MISMATCH"; }
+
+    // Every row fits CONT_COLS cells, starts on a code point and is full
+    // unless it ends a paragraph or the next word didn't fit.
+    std::string body = frenchBody(200000);
+    PageRun r; replayPage(body, false, 1400, r);
+    if (!r.linesMatch) bad = "INCREMENTAL LINES MISMATCH";
+    int rows = 0, forced = 0;
+    for (int i = 0; i < g_lineCount; i++) {
+        LineSpan ls = lineAt(i);
+        std::string l = r.text.substr(ls.start, ls.len);
+        int cols = textColumns(l.data(), (int)l.size());
+        if (cols > CONT_COLS || !utf8Cell((uint8_t)l[0])) { bad = "WRAP MISMATCH"; break; }
+        if (cols == CONT_COLS && l.find(' ') == std::string::npos) forced++;
+        rows++;
+    }
+    if (!forced) bad = "NO FORCED BREAK";
+
+    std::string vlw = tinyVlw();
+    uint8_t plainE = glyphCoverage(0xE9, 0, 0) | glyphCoverage(0xE9, 1, 1) << 4;
+    bool font = glyphFont((const uint8_t*)vlw.data(), vlw.size());
+    const uint8_t want[3][2] = {{15, 8}, {1, 0}, {15, 0}};
+    for (int y = 0; y < GLCD_H; y++)
+        for (int x = 0; x < GLCD_W; x++) {
+            int e = (y >= 2 && y < 5 && x >= 1 && x < 3) ? want[y - 2][x - 1] : 0;
+            int c = y == 7 ? (uint8_t)vlw[vlw.size() - 6 + x] >> 4 : 0;
+            font &= glyphCoverage(0xE9, x, y) == e && glyphCoverage(0x4E2D, x, y) == c;
+        }
+    font &= !glyphFont((const uint8_t*)vlw.data(), vlw.size() - 1);
+    glyphFont(nullptr, 0);
+    font &= (uint8_t)(glyphCoverage(0xE9, 0, 0) | glyphCoverage(0xE9, 1, 1) << 4) == plainE;
+    if (!font) bad = "VLW GLYPH MISMATCH";
+
+    printf("\nutf8: %zu -> %zu bytes, %d rows (%d split mid-word) %s\n", body.size(), r.text.size(), rows, forced, bad ? bad : "");
+    return !bad && benchText("(utf8)", r.text);
+}
+
+// ---- connection pool session ------------------------------------------------
+
+static std::string s_ddgBody, s_jinaBody;
+// Jina bodies for particular targets ("/https://..."); the rest get s_jinaBody.
+static std::map<std::string, std::string> s_jinaPages;
+static int         s_epoch = 0;
+static int         s_handshakes[3], s_requests[3], s_resolves[3];
+
+static int hostIdx(const char* host) {
+    return !strcmp(host, DDG_LITE_HOST) ? 0 : !strcmp(host, JINA_HOST) ? 1 : 2;
+}
+
+// Replies go out at s_pacePerMs bytes per ms (0: all at once) and stop at
+// s_paceStall bytes.
+static size_t s_pacePerMs = 0, s_paceStall = SIZE_MAX;
+size_t fakeServerSent(const char*, unsigned long ms) {
+    return min(s_pacePerMs ? (size_t)ms * s_pacePerMs : SIZE_MAX, s_paceStall);
+}
+
+// The three hosts live at 10.0.0.1-3; anything else is NXDOMAIN. Answers
+// arrive s_dnsLatency ms after the query; s_refuse fails that many connects.
+static const char* const FAKE_HOSTS[3] = { DDG_LITE_HOST, JINA_HOST, WAYBACK_HOST };
+struct FakeQuery { int host; unsigned long due; dns_found_callback found; void* arg; };
+static std::vector<FakeQuery> s_dnsQ;
+static unsigned long s_dnsLatency = 0;
+static int s_refuse = 0;
+
+err_t dns_gethostbyname(const char* name, ip_addr_t*, dns_found_callback found, void* arg) {
+    int h = 0; while (h < 3 && strcmp(FAKE_HOSTS[h], name)) h++;
+    if (h < 3) s_resolves[h]++;
+    s_dnsQ.push_back({ h, millis() + s_dnsLatency, found, arg });
+    return ERR_INPROGRESS;
+}
+
+static void fakeDnsDeliver() {
+    for (size_t i = 0; i < s_dnsQ.size();) {
+        FakeQuery q = s_dnsQ[i];
+        if ((long)(millis() - q.due) < 0) { i++; continue; }
+        s_dnsQ.erase(s_dnsQ.begin() + i);
+        ip_addr_t ip; ip.u_addr.ip4.addr = 0x0A000001 + q.host;
+        q.found(q.host < 3 ? FAKE_HOSTS[q.host] : "?", q.host < 3 ? &ip : nullptr, q.arg);
+    }
+}
+
+const char* fakeServerHost(uint32_t ip) { return ip - 0x0A000001 < 3 ? FAKE_HOSTS[ip - 0x0A000001] : nullptr; }
+bool fakeServerConnect(const char* host, uint16_t, bool) {
+    if (s_refuse > 0) { s_refuse--; return false; }
+    s_handshakes[hostIdx(host)]++; return true;
+}
+int  fakeServerEpoch() { return s_epoch; }
+
+std::string fakeServerRequest(const char* host, const std::string& req, bool& closeAfter) {
+    int h = hostIdx(host); s_requests[h]++;
+    closeAfter = req.find("Connection: close") != std::string::npos;
+    std::string conn = closeAfter ? "close" : "keep-alive";
+    if (h == 0) return "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nTransfer-Encoding: chunked\r\nConnection: " + conn +
+                       "\r\n\r\n" + chunkEncode(s_ddgBody, 4096);
+    auto page = h == 1 ? s_jinaPages.find(req.substr(4, req.find(' ', 4) - 4)) : s_jinaPages.end();
+    std::string body = page != s_jinaPages.end() ? page->second
+                     : h == 1 ? s_jinaBody
+                              : "{\"archived_snapshots\":{\"closest\":{\"url\":\"http:\\/\\/web.archive.org\\/web\\/2024\\/https:\\/\\/www.example.ca\\/\"}}}";
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: " + conn + "\r\n\r\n" + body;
+}
+
+static bool ddgSink(const uint8_t* p, size_t n) { ddgFeed((const char*)p, n); return true; }
+static std::string s_cdx;
+static bool cdxSink(const uint8_t* p, size_t n) { s_cdx.append((const char*)p, n); return true; }
+
+static int sessionGet(const char* host, uint16_t port, const char* path, BodySink sink) {
+    String req = String("GET ") + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n\r\n";
+    HttpHead head;
+    return httpExchange(host, port, req, head, sink, 15000);
+}
+
+static int sessionSearch(const char* q) {
+    String body = String("q=") + q;
+    String req = String("POST " DDG_LITE_PATH " HTTP/1.1\r\nHost: " DDG_LITE_HOST "\r\nContent-Length: ") +
+                 String((int)body.length()) + "\r\nConnection: keep-alive\r\n\r\n" + body;
+    HttpHead head; g_resultCount = 0; ddgInit();
+    int code = httpExchange(DDG_LITE_HOST, DDG_LITE_PORT, req, head, ddgSink, 15000);
+    ddgFinish();
+    return code == 200 ? g_resultCount : -1;
+}
+
+static int sessionPage(const char* path) {
+    stripInit();
+    int code = sessionGet(JINA_HOST, JINA_PORT, path, [](const uint8_t* p, size_t n) { stripBlock(p, n); return true; });
+    return code == 200 ? (int)g_pageLen : -1;
+}
+
+static bool benchPool() {
+    if (s_ddgBody.empty() || s_jinaBody.empty()) return true;
+    updateBaseDomain("https://www.example.ca/");
+    bool ok = true; int steps = 0;
+    auto step = [&](const char* what, bool good) { steps++; if (!good) { printf("  step %d (%s) failed\n", steps, what); ok = false; } };
+
+    step("search",        sessionSearch("canada+winter") > 0);
+    step("open result 1", sessionPage("/https://www.example.ca/a") > 0);
+    step("open result 2", sessionPage("/https://www.example.ca/b") > 0);
+    step("back",          sessionPage("/https://www.example.ca/a") > 0);
+    step("search again",  sessionSearch("hockey") > 0);
+    s_cdx.clear();
+    step("wayback cdx",   sessionGet(WAYBACK_HOST, WAYBACK_PORT, "/wayback/available?url=x", cdxSink) == 200 && !s_cdx.empty());
+    step("via wayback",   sessionPage("/http://web.archive.org/web/2024/https://www.example.ca/") > 0);
+    s_epoch++;
+    step("after server drop", sessionPage("/https://www.example.ca/c") > 0);
+    delay(POOL_IDLE_MS + 1);
+    step("after idle",    sessionSearch("toronto") > 0);
+
+    int req = s_requests[0] + s_requests[1] + s_requests[2];
+    int hs  = s_handshakes[0] + s_handshakes[1] + s_handshakes[2];
+    PoolStats st[4]; int n = netStats(st, 4);
+    printf("\npool: %d requests, %d full handshakes (ddg %d, jina %d, archive %d), %d without pooling\n",
+           req, hs, s_handshakes[0], s_handshakes[1], s_handshakes[2], steps);
+    for (int i = 0; i < n; i++) printf("  %-20s handshakes=%u reused=%u live=%d\n", st[i].host, st[i].handshakes, st[i].reuses, st[i].live);
+    // ddg: first search + after idle; jina: first fetch + reconnect after the drop; archive: one.
+    if (s_handshakes[0] != 2 || s_handshakes[1] != 2 || s_handshakes[2] != 1) { printf("  POOL HANDSHAKE COUNT MISMATCH\n"); ok = false; }
+    // Reconnects, even after the idle drop, use the cached address.
+    if (s_resolves[0] != 1 || s_resolves[1] != 1 || s_resolves[2] != 1) { printf("  POOL LOOKUP COUNT MISMATCH\n"); ok = false; }
+    return ok;
+}
+
+// ---- dns cache -------------------------------------------------------------------
+
+// One search, one page and one CDX lookup on a cold pool; returns bench ms.
+static unsigned long dnsSession() {
+    netDropAll();
+    unsigned long t = millis();
+    bool good = sessionSearch("dns") > 0 && sessionPage("/https://www.example.ca/dns") > 0 &&
+                sessionGet(WAYBACK_HOST, WAYBACK_PORT, "/wayback/available?url=x", cdxSink) == 200;
+    return good ? millis() - t : ULONG_MAX;
+}
+
+static int lookups() { return s_resolves[0] + s_resolves[1] + s_resolves[2]; }
+
+static bool benchDns() {
+    if (s_ddgBody.empty() || s_jinaBody.empty()) return true;
+    bool ok = true;
+    auto check = [&](bool good, const char* what) { if (!good) { printf("  DNS %s\n", what); ok = false; } };
+    s_dnsLatency = 150;
+
+    // Nothing cached: each host waits out its own lookup in turn.
+    dnsFlush();
+    unsigned long cold = dnsSession();
+    int q0 = lookups();
+
+    // Warmed when WiFi came up, all three queries out at once; one latency
+    // later every answer is in, and the same session does no lookups.
+    dnsFlush();
+    dnsWarm();
+    int inFlight = lookups() - q0;
+    delay(s_dnsLatency);
+    unsigned long warm = dnsSession();
+    check(inFlight == 3 && lookups() == q0 + 3, "WARM-UP NOT CONCURRENT");
+    check(cold >= 3 * s_dnsLatency && warm < s_dnsLatency, "WARM SESSION STILL WAITED");
+
+    // A second warm-up while fresh is free; past the TTL it refreshes.
+    dnsWarm(); int q1 = lookups();
+    check(q1 == q0 + 3, "FRESH ENTRIES REQUERIED");
+    delay(DNS_TTL_MS);
+    dnsSession();
+    check(lookups() == q1 + 3, "EXPIRED ENTRIES NOT REQUERIED");
+
+    // A refused connect drops the address; the retry looks it up again.
+    netDropAll(); q1 = lookups(); s_refuse = 1;
+    bool refused = sessionPage("/https://www.example.ca/refused") < 0;
+    check(refused && sessionPage("/https://www.example.ca/retry") > 0 && lookups() == q1 + 1, "REFUSED CONNECT KEPT ADDRESS");
+    printf("\ndns: cold session %lu ms, warmed %lu ms (%lu ms per lookup)\n", cold, warm, s_dnsLatency);
+    s_dnsLatency = 0;
+    return ok;
+}
+
+// ---- request tracing ---------------------------------------------------------
+
+static std::vector<std::string> s_dump;
+
+// Self time per phase rebuilt from the dumped spans: they come out in the
+// order they ended, so a span's children are the spans one level deeper
+// since the last one at its own depth or above.
+static bool dumpSelf(uint32_t id, uint32_t self[TR_PHASES], int spans[TR_PHASES]) {
+    uint64_t child[TRACE_DEPTH + 1] = {};
+    memset(self, 0, TR_PHASES * sizeof(uint32_t)); memset(spans, 0, TR_PHASES * sizeof(int));
+    for (auto& l : s_dump) {
+        unsigned rid, depth, t0, dur; char name[16];
+        if (sscanf(l.c_str(), "TRACE S %u %15s %u %u %u", &rid, name, &depth, &t0, &dur) != 5) continue;
+        if (rid != id) continue;
+        int p = 0; while (p < TR_PHASES && strcmp(tracePhaseName(p), name)) p++;
+        if (p == TR_PHASES || depth >= TRACE_DEPTH) return false;
+        self[p] += dur - (uint32_t)min<uint64_t>(dur, child[depth + 1]);
+        child[depth + 1] = 0; child[depth] += dur; spans[p]++;
+    }
+    return true;
+}
+
+static bool benchTrace() {
+    if (s_ddgBody.empty() || s_jinaBody.empty()) return true;
+    bool ok = true;
+    auto fail = [&](const char* what) { printf("  TRACE %s\n", what); ok = false; };
+
+    // A search on a cold pool, then a page on the warm one whose body is
+    // stripped and wrapped as it arrives, with a 5 ms draw on the bench clock.
+    netDropAll();
+    traceStart('S', "canada winter");
+    int found = sessionSearch("canada+winter");
+    traceNote(found > 0 ? 200 : 0, (uint32_t)found);
+    traceStart('P', "www.example.ca/a");
+    sessionPage("/https://www.example.ca/a");
+    {
+        std::string wire = s_jinaBody;
+        ReplayStream rs(wire, 1400); bool complete = false;
+        readStream(&rs, (int)wire.size(), false, &complete, nullptr, CODING_IDENTITY, FORMAT_MARKDOWN);
+        buildLineCache();
+    }
+    { TraceScope t(TR_DRAW); delay(5); }
+    traceNote(200, g_pageLen); traceVia('w');
+    traceEnd();                                         // unmatched: must not underflow
+    traceIdle();
+    traceBegin(TR_DRAW); traceEnd();                    // outside a request: dropped
+
+    TraceReq r[4]; int n = traceRecent(r, 4);
+    if (n != 2 || r[0].kind != 'P' || r[1].kind != 'S' || r[0].via != 'w' || r[1].via || r[0].open || r[1].open) { fail("RECENT MISMATCH"); return false; }
+    s_dump.clear();
+    traceDump([](const char* l) { s_dump.push_back(l); });
+
+    printf("\ntrace: %d lines dumped\n", (int)s_dump.size());
+    printf("  %-3s %-18s %8s", "", "label", "total_us");
+    for (int p = 0; p < TR_PHASES; p++) printf(" %8s", tracePhaseName(p));
+    printf("\n");
+    int spans[2][TR_PHASES];
+    for (int i = n - 1; i >= 0; i--) {
+        printf("  %-3c %-18s %8u", r[i].kind, r[i].label, (unsigned)r[i].total);
+        uint64_t sum = 0;
+        for (int p = 0; p < TR_PHASES; p++) { printf(" %8u", (unsigned)r[i].self[p]); sum += r[i].self[p]; }
+        printf("\n");
+        if (sum > r[i].total) fail("SELF TIME EXCEEDS TOTAL");
+        uint32_t self[TR_PHASES];
+        if (!dumpSelf(r[i].id, self, spans[i])) fail("DUMP UNREADABLE");
+        else if (memcmp(self, r[i].self, sizeof(self))) fail("DUMP DISAGREES WITH SELF TIMES");
+        unsigned id, t0, total, bytes; int status; char kind[3] = {};
+        char want[32]; snprintf(want, sizeof(want), "TRACE R %u ", (unsigned)r[i].id);
+        bool found = false;
+        for (auto& l : s_dump)
+            if (!l.compare(0, strlen(want), want) &&
+                sscanf(l.c_str(), "TRACE R %u %u %u %d %u %2s", &id, &t0, &total, &status, &bytes, kind) == 6)
+                found = total == r[i].total && status == r[i].status && bytes == r[i].bytes && kind[0] == r[i].kind &&
+                        kind[1] == r[i].via;
+        if (!found) fail("REQUEST LINE MISMATCH");
+    }
+    // The search came in cold: one lookup and one handshake, then the request.
+    if (spans[1][TR_DNS] != 1 || spans[1][TR_CONNECT] != 1 || spans[1][TR_TTFB] != 1 || spans[1][TR_BODY] != 1) fail("SEARCH PHASES MISMATCH");
+    if (!spans[0][TR_STRIP] || !spans[0][TR_LINES] || spans[0][TR_DRAW] != 1) fail("PAGE PHASES MISSING");
+    if (r[0].self[TR_DRAW] < 5000) fail("DRAW SPAN OFF THE BENCH CLOCK");
+
+    // Cost of one span, in an open request (ring wrapping) and outside one.
+    const int N = 1000000;
+    traceStart('P', "(overhead)");
+    double t = nowUs();
+    for (int i = 0; i < N; i++) { TraceScope s(TR_DRAW); }
+    double on = (nowUs() - t) * 1000 / N;
+    traceIdle();
+    t = nowUs();
+    for (int i = 0; i < N; i++) { TraceScope s(TR_DRAW); }
+    double off = (nowUs() - t) * 1000 / N;
+    s_dump.clear();
+    traceDump([](const char* l) { s_dump.push_back(l); });
+    int spanLines = 0; for (auto& l : s_dump) spanLines += !l.compare(0, 8, "TRACE S ");
+    printf("  span: %.1f ns recorded, %.1f ns outside a request; ring keeps %d of %d\n", on, off, spanLines, N);
+    if (spanLines != TRACE_SPANS) fail("RING SIZE MISMATCH");
+    return ok;
+}
+
+// ---- non-blocking fetch --------------------------------------------------------
+
+struct FetchRun { int polls = 0; unsigned long simMs = 0; double longestUs = 0; bool waited = false; };
+
+// One delay(1) of bench clock between polls, the way loop() spaces them; a
+// poll itself must never move the clock.
+static FetchRun pollToEnd(HttpFetch& f, int maxPolls = INT_MAX) {
+    FetchRun r; unsigned long t0 = millis();
+    while (f.state < FETCH_DONE && r.polls < maxPolls) {
+        unsigned long skew = t_skewMs; double t = nowUs();
+        fetchPoll(f);
+        r.longestUs = max(r.longestUs, nowUs() - t);
+        r.waited |= t_skewMs != skew;
+        r.polls++; delay(1);
+    }
+    r.simMs = millis() - t0;
+    return r;
+}
+
+static BodySink pageHead(const HttpHead& h) { return streamBegin(nullptr, h.coding, FORMAT_MARKDOWN); }
+
+static void pageFetch(HttpFetch& f, const char* path) {
+    String req = String("GET ") + path + " HTTP/1.1\r\nHost: " JINA_HOST "\r\nConnection: keep-alive\r\n\r\n";
+    fetchBegin(f, JINA_HOST, JINA_PORT, req, nullptr, 15000);
+    f.onHead = pageHead;
+}
+
+static bool jinaLive() {
+    PoolStats st[4]; int n = netStats(st, 4);
+    for (int i = 0; i < n; i++) if (!strcmp(st[i].host, JINA_HOST)) return st[i].live;
+    return false;
+}
+
+static bool benchFetch() {
+    if (s_ddgBody.empty() || s_jinaBody.empty()) return true;
+    bool ok = true;
+    auto check = [&](bool good, const char* what) { if (!good) { printf("  FETCH %s\n", what); ok = false; } };
+    stripBuffer((const uint8_t*)s_jinaBody.data(), s_jinaBody.size(), CODING_IDENTITY, FORMAT_MARKDOWN);
+    std::string want = pageString();
+    netDropAll();
+    printf("\nfetch (bench clock, one poll per ms):\n");
+
+    // A page coming in at about 1.4 KB per 10 ms, and a chunked search at 64
+    // bytes per ms so chunk boundaries land everywhere.
+    s_pacePerMs = 140;
+    HttpFetch f; pageFetch(f, "/https://www.example.ca/paced");
+    FetchRun r = pollToEnd(f); streamEnd();
+    printf("  %-22s %6d polls %6lu ms  longest poll %6.1f us\n", "page 140 B/ms", r.polls, r.simMs, r.longestUs);
+    check(f.state == FETCH_DONE && f.result == 200 && f.complete, "PACED PAGE INCOMPLETE");
+    check(pageString() == want, "PACED PAGE DIFFERS");
+    check(!r.waited, "POLL WAITED");
+    check(r.simMs >= s_jinaBody.size() / 140, "PACED PAGE FASTER THAN THE SERVER");
+
+    s_pacePerMs = 64;
+    ddgInit(); g_resultCount = 0;
+    String body = "q=paced";
+    fetchBegin(f, DDG_LITE_HOST, DDG_LITE_PORT, String("POST " DDG_LITE_PATH " HTTP/1.1\r\nHost: " DDG_LITE_HOST "\r\nContent-Length: ") +
+               String((int)body.length()) + "\r\nConnection: keep-alive\r\n\r\n" + body, ddgSink, 15000);
+    r = pollToEnd(f); ddgFinish();
+    int paced = g_resultCount;
+    printf("  %-22s %6d polls %6lu ms  longest poll %6.1f us\n", "search 64 B/ms", r.polls, r.simMs, r.longestUs);
+    s_pacePerMs = 0;
+    check(f.complete && paced > 0 && paced == sessionSearch("instant"), "PACED SEARCH DIFFERS");
+    check(!r.waited, "POLL WAITED");
+
+    // ESC halfway through a page: the socket goes, the next fetch handshakes.
+    s_pacePerMs = 50;
+    int hs = s_handshakes[1];
+    pageFetch(f, "/https://www.example.ca/abort");
+    pollToEnd(f, 40); fetchAbort(f); streamEnd();
+    check(f.state == FETCH_FAILED && f.result == -2 && g_pageLen > 0 && g_pageLen < want.size(), "ABORT STATE");
+    check(!jinaLive(), "ABORTED SOCKET STILL POOLED");
+    s_pacePerMs = 0;
+    pageFetch(f, "/https://www.example.ca/after-abort");
+    pollToEnd(f); streamEnd();
+    check(f.result == 200 && pageString() == want && s_handshakes[1] == hs + 1, "FETCH AFTER ABORT");
+
+    // The server stops halfway: the body ends short after the idle timeout on
+    // the bench clock, not on the wall clock.
+    s_paceStall = 200 + s_jinaBody.size() / 2;
+    pageFetch(f, "/https://www.example.ca/stall");
+    double t = nowUs();
+    r = pollToEnd(f); streamEnd();
+    printf("  %-22s %6d polls %6lu ms  in %.0f ms real\n", "stalled at half", r.polls, r.simMs, (nowUs() - t) / 1000);
+    check(f.result == 200 && !f.complete && r.simMs >= STREAM_IDLE_TIMEOUT && r.simMs < STREAM_IDLE_TIMEOUT + 500, "STALL TIMEOUT");
+
+    // And a server that never answers: no head after the fetch timeout.
+    s_paceStall = 0;
+    pageFetch(f, "/https://www.example.ca/silent"); f.timeoutMs = 3000;
+    r = pollToEnd(f);
+    check(f.state == FETCH_FAILED && f.result == 0 && r.simMs >= 3000 && r.simMs < 3500, "SILENT SERVER");
+    s_paceStall = SIZE_MAX;
+    check(!r.waited, "POLL WAITED");
+    return ok;
+}
+
+// ---- hedged page load ------------------------------------------------------------
+
+static size_t s_spoolBudget = SIZE_MAX;
+static BodySink spoolHead(const HttpHead& h) { spoolBegin(s_spoolBudget, h.coding); return spoolSink; }
+
+static bool benchRace() {
+    if (s_jinaBody.empty()) return true;
+    bool ok = true;
+    auto check = [&](bool good, const char* what) { if (!good) { printf("  RACE %s\n", what); ok = false; } };
+    stripBuffer((const uint8_t*)s_jinaBody.data(), s_jinaBody.size(), CODING_IDENTITY, FORMAT_MARKDOWN);
+    std::string want = pageString();
+    netDropAll();
+
+    // The live page streams into the stripper while the snapshot spools on
+    // the second Jina connection, both at 100 B/ms. A third of the way in the
+    // live leg fails: the spool is drained into the page and the rest of the
+    // snapshot streams after it.
+    s_pacePerMs = 100;
+    int hs = s_handshakes[1];
+    HttpFetch live, snap;
+    pageFetch(live, "/https://www.example.ca/live");
+    pageFetch(snap, "/http://web.archive.org/web/2024/https://www.example.ca/");
+    snap.onHead = spoolHead; snap.traced = false;
+    int polls = 0;
+    size_t held = 0;
+    bool apart = false;
+    while (snap.state < FETCH_DONE && polls < 100000) {
+        if (live.state < FETCH_DONE) fetchPoll(live);
+        fetchPoll(snap);
+        apart |= live.c && snap.c && live.c != snap.c;
+        if (++polls == (int)s_jinaBody.size() / 300) {
+            fetchAbort(live); streamEnd();
+            held = spoolBytes();
+            check(held > 0 && held < s_jinaBody.size(), "NOTHING SPOOLED MIDWAY");
+            check(spoolDrain(nullptr, FORMAT_MARKDOWN), "DRAIN FAILED");
+        }
+        delay(1);
+    }
+    streamEnd(); spoolFree();
+    printf("\nrace: %d polls, snapshot %d B (%zu spooled before the switch), %d handshakes\n",
+           polls, snap.body.total, held, s_handshakes[1] - hs);
+    check(apart && s_handshakes[1] == hs + 2, "LEGS SHARED A CONNECTION");
+    check(live.result == -2 && snap.result == 200 && snap.complete && pageString() == want, "SWITCHED PAGE DIFFERS");
+
+    // Past its budget the spool refuses and the fetch stops short.
+    s_pacePerMs = 0; s_spoolBudget = 1000;
+    pageFetch(snap, "/https://www.example.ca/budget");
+    snap.onHead = spoolHead;
+    pollToEnd(snap);
+    check(snap.state == FETCH_DONE && !snap.complete && spoolBytes() <= 1000, "BUDGET NOT ENFORCED");
+    spoolFree(); s_spoolBudget = SIZE_MAX;
+
+    // Both sockets went back to the pool.
+    PoolStats st[4]; int n = netStats(st, 4), free = 0;
+    for (int i = 0; i < n; i++) free += !strcmp(st[i].host, JINA_HOST);
+    HttpFetch a, b;
+    pageFetch(a, "/https://www.example.ca/a"); pageFetch(b, "/https://www.example.ca/b");
+    fetchPoll(a); fetchPoll(b);
+    check(free == 2 && a.c && b.c && a.c != b.c, "SLOTS NOT RELEASED");
+    fetchAbort(a); fetchAbort(b); streamEnd();
+    return ok;
+}
+
+// ---- prefetch ----------------------------------------------------------------
+
+// The background task fetches the top results and prefetchTake hands one
+// over as the page; a block page comes back as 2, for the Wayback leg.
+static bool benchPrefetch() {
+    if (s_jinaBody.empty()) return true;
+    bool ok = true;
+    auto check = [&](bool good, const char* what) { if (!good) { printf("  PREFETCH %s\n", what); ok = false; } };
+    stripBuffer((const uint8_t*)s_jinaBody.data(), s_jinaBody.size(), CODING_IDENTITY, FORMAT_MARKDOWN);
+    std::string want = pageString();
+    s_jinaPages["/https://www.example.ca/blocked"] =
+        "Just a moment...\n\nChecking your browser before accessing www.example.ca.\n";
+    prefetchInit();
+    // A local hit heads the list; the prefetch starts at DDG's first result.
+    g_resultCount = 0;
+    resultAdd("Read earlier", "https://www.example.ca/local", "Read earlier");
+    resultAdd("Live", "https://www.example.ca/live", "");
+    resultAdd("Blocked", "https://www.example.ca/blocked", "");
+    dnsFlush(); s_epoch++;
+    int looked = s_resolves[1], asked = s_requests[1];
+    prefetchStart(1); taskRun();
+    check(s_resolves[1] == looked + 1, "CONNECT MISSED THE ADDRESS CACHE");
+    check(s_requests[1] == asked + 2 && prefetchTake("https://www.example.ca/local") == 0, "LOCAL HIT PREFETCHED");
+    check(prefetchTake("https://www.example.ca/live") == 1 && pageString() == want, "TOP RESULT NOT HANDED OVER");
+    check(prefetchTake("https://www.example.ca/blocked") == 2, "BLOCK PAGE TAKEN AS THE PAGE");
+    check(prefetchTake("https://www.example.ca/live") == 0, "TAKEN TWICE");
+
+    // Three pages that fit PREFETCH_PAGE_MAX but not the budget together:
+    // the third stops partway and is not handed over.
+    std::string big;
+    while (big.size() < PREFETCH_PAGE_MAX - 8192) big += "A line of prefetched text for the budget.\n";
+    const char* urls[3] = { "https://www.example.ca/p1", "https://www.example.ca/p2", "https://www.example.ca/p3" };
+    g_resultCount = 0;
+    for (const char* u : urls) { s_jinaPages[std::string("/") + u] = big; resultAdd("Big", u, ""); }
+    s_epoch++;
+    prefetchStart(0); taskRun();
+    check(s_resolves[1] == looked + 1, "RECONNECT LOOKED UP AGAIN");
+    check(prefetchTake(urls[0]) == 1 && prefetchTake(urls[1]) == 1, "PAGES IN BUDGET NOT HANDED OVER");
+    check(prefetchTake(urls[2]) == 0, "BUDGET NOT ENFORCED");
+    s_jinaPages.clear(); g_resultCount = 0;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::string dir = argc > 1 ? argv[1] : "bench/captures";
+    int record      = argc > 2 ? atoi(argv[2]) : 1400;
+    if (record <= 0) record = 1400;
+
+    g_links    = (LinkEntry*)malloc(MAX_LINKS * sizeof(LinkEntry));
+
+    std::vector<std::string> files;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* e = readdir(d)) if (e->d_name[0] != '.') files.push_back(e->d_name);
+        closedir(d);
+    }
+    if (files.empty()) { fprintf(stderr, "no captures in %s\n", dir.c_str()); return 2; }
+    std::sort(files.begin(), files.end());
+
+    printf("record=%d bytes  page=%d KB  lines=%d  links=%d\n\n", record, (int)(PAGE_MAX_BYTES / 1024), MAX_LINES, MAX_LINKS);
+    printf("%-22s %8s %8s %8s %9s %9s %9s %9s  %6s %8s %6s %-3s %8s\n",
+           "capture", "in", "out", "MB/s", "strip_us", "ref_us", "lines_us", "block_us", "text", "lines", "links", "blk", "1st_scr");
+
+    auto endsWith = [](const std::string& s, const char* suf) {
+        size_t n = strlen(suf); return s.size() >= n && !s.compare(s.size() - n, n, suf);
+    };
+    bool ok = true; std::string largest;
+    std::vector<std::string> htmlPages;
+    std::vector<std::string> coded;
+    std::map<std::string, std::string> plain;
+    for (auto& f : files) {
+        if (endsWith(f, ".gz") || endsWith(f, ".zz")) { coded.push_back(f); continue; }
+        std::string body;
+        if (!loadFile(dir + "/" + f, body)) { fprintf(stderr, "cannot read %s\n", f.c_str()); ok = false; continue; }
+        plain[f] = body;
+        if (!strncmp(f.c_str(), "ddg", 3)) { ok &= benchDDG(f.c_str(), body, record); s_ddgBody = body; htmlPages.push_back(body); }
+        else {
+            ok &= benchPage(f.c_str(), body, record);
+            if (endsWith(f, ".html")) htmlPages.push_back(body);
+            if (endsWith(f, ".txt")) { s_jinaBody = body; ok &= benchMarkdown((f + " (md)").c_str(), body, record); }
+            if (body.size() > largest.size()) largest = body;
+        }
+    }
+    for (auto& f : coded) {
+        std::string wire;
+        if (!loadFile(dir + "/" + f, wire)) { fprintf(stderr, "cannot read %s\n", f.c_str()); ok = false; continue; }
+        auto twin = plain.find(f.substr(0, f.size() - 3));
+        ok &= benchCoded(f.c_str(), wire, endsWith(f, ".gz") ? CODING_GZIP : CODING_DEFLATE,
+                         twin == plain.end() ? nullptr : &twin->second, record);
+    }
+
+    // The largest page repeated out to roughly 400 KB: well past what the old
+    // fixed 200 KB / 400-line page held.
+    if (!largest.empty()) {
+        std::string big;
+        while (big.size() < 400000) big += largest;
+        ok &= benchPage("(largest x400KB)", big, record);
+    }
+
+    ok &= benchTags(htmlPages, plain.count("article.html") ? plain["article.html"] : std::string());
+    ok &= benchBlocked(htmlPages, s_jinaBody);
+    if (!mdSample()) { printf("MARKDOWN SAMPLE MISMATCH\n"); ok = false; }
+    if (!s_jinaBody.empty()) ok &= benchText("(ascii)", s_jinaBody);
+    ok &= benchUtf8();
+    ok &= benchStore();
+    ok &= benchLinks();
+    ok &= benchSaved(s_jinaBody);
+    ok &= benchCache();
+    ok &= benchFind(s_jinaBody);
+    ok &= benchLocal(htmlPages, s_jinaBody);
+    ok &= benchPool();
+    ok &= benchDns();
+    ok &= benchTrace();
+    ok &= benchFetch();
+    ok &= benchRace();
+    ok &= benchPrefetch();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for ESP-IDF's esp_timer, for [env:native] only: microseconds
+// on the bench clock (delay() skews it like millis()).
+#include <stdint.h>
+
+int64_t esp_timer_get_time();
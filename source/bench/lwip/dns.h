@@ -0,0 +1,16 @@
+#pragma once
+// Stand-in for lwIP's resolver, for [env:native] only: every query is in
+// flight for fakeDnsLatency() ms of bench clock and answered from inside
+// delay(), the host's nearest thing to lwIP's own thread.
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK          0
+#define ERR_INPROGRESS  -5
+#define ERR_ARG         -16
+
+struct ip4_addr_t { uint32_t addr; };
+struct ip_addr_t  { struct { ip4_addr_t ip4; } u_addr; };
+typedef void (*dns_found_callback)(const char* name, const ip_addr_t* ipaddr, void* arg);
+
+err_t dns_gethostbyname(const char* hostname, ip_addr_t* addr, dns_found_callback found, void* arg);
@@ -0,0 +1,101 @@
+#include "cache.h"
+
+struct CacheEntry {
+    char*    url;
+    uint8_t* blob;
+    size_t   bytes;
+    size_t   textLen;
+    int      lineCount;
+    int      spanCount;
+    int      linkCount;
+    uint32_t stamp;
+};
+
+static CacheEntry g_cache[PAGE_CACHE_SLOTS];
+static size_t     g_cacheBytes = 0;
+static uint32_t   g_cacheClock = 0;
+
+static CacheEntry* cacheFind(const char* url) {
+    for (int i = 0; i < PAGE_CACHE_SLOTS; i++)
+        if (g_cache[i].url && !strcmp(g_cache[i].url, url)) return &g_cache[i];
+    return nullptr;
+}
+
+static void cacheFree(CacheEntry& e) {
+    g_cacheBytes -= e.bytes;
+    heap_caps_free(e.url); heap_caps_free(e.blob);
+    memset(&e, 0, sizeof(e));
+}
+
+static CacheEntry* cacheLRU() {
+    CacheEntry* lru = nullptr;
+    for (int i = 0; i < PAGE_CACHE_SLOTS; i++)
+        if (g_cache[i].url && (!lru || g_cache[i].stamp < lru->stamp)) lru = &g_cache[i];
+    return lru;
+}
+
+bool cacheLoad(const String& url) {
+    CacheEntry* e = cacheFind(url.c_str()); if (!e) return false;
+    const uint8_t* p = e->blob;
+    const uint8_t* spans = p + e->textLen + e->lineCount * sizeof(LineSpan);
+    pageBack(nullptr);
+    if (!pageWrite(0, (const char*)p, e->textLen) ||
+        !lineWrite(0, (const LineSpan*)(p + e->textLen), e->lineCount) ||
+        !spanWrite(0, (const StyleSpan*)spans, e->spanCount)) { g_pageLen = 0; g_lineCount = 0; g_spanCount = 0; return false; }
+    const uint8_t* ats = spans + e->spanCount * sizeof(StyleSpan);
+    p = ats + e->linkCount * sizeof(uint32_t);
+    g_pageLen = e->textLen; g_lineCount = e->lineCount; g_spanCount = e->spanCount;
+    g_linkCount = 0;
+    for (int i = 0; i < e->linkCount; i++) {
+        uint32_t at; memcpy(&at, ats + i * sizeof(at), sizeof(at));
+        linkAdd((const char*)p, at);
+        p += strlen((const char*)p) + 1;
+    }
+    e->stamp = ++g_cacheClock;
+    return true;
+}
+
+void cacheStore(const String& url) {
+    cacheDrop(url);
+    size_t linkBytes = 0;
+    char link[LINK_URL_LEN];
+    for (int i = 0; i < g_linkCount; i++) linkBytes += linkUrl(i, link, sizeof(link)) + 1;
+    size_t bytes = g_pageLen + g_lineCount * sizeof(LineSpan) + g_spanCount * sizeof(StyleSpan) +
+                   g_linkCount * sizeof(uint32_t) + linkBytes;
+    if (bytes > PAGE_CACHE_BUDGET) return;
+
+    CacheEntry* slot = nullptr;
+    for (int i = 0; i < PAGE_CACHE_SLOTS && !slot; i++) if (!g_cache[i].url) slot = &g_cache[i];
+    while (!slot || g_cacheBytes + bytes > PAGE_CACHE_BUDGET) {
+        CacheEntry* lru = cacheLRU(); if (!lru) break;
+        cacheFree(*lru);
+        if (!slot) slot = lru;
+    }
+    if (!slot) return;
+
+    uint8_t* blob = (uint8_t*)heap_caps_malloc(bytes ? bytes : 1, MALLOC_CAP_SPIRAM);
+    char*    key  = (char*)heap_caps_malloc(url.length() + 1, MALLOC_CAP_SPIRAM);
+    if (!blob || !key) { heap_caps_free(blob); heap_caps_free(key); return; }
+    memcpy(key, url.c_str(), url.length() + 1);
+
+    uint8_t* p = blob;
+    pageRead(0, (char*)p, g_pageLen); p += g_pageLen;
+    lineRead(0, (LineSpan*)p, g_lineCount); p += g_lineCount * sizeof(LineSpan);
+    spanRead(0, (StyleSpan*)p, g_spanCount); p += g_spanCount * sizeof(StyleSpan);
+    for (int i = 0; i < g_linkCount; i++, p += sizeof(uint32_t)) memcpy(p, &g_links[i].at, sizeof(uint32_t));
+    for (int i = 0; i < g_linkCount; i++) p += linkUrl(i, (char*)p, LINK_URL_LEN) + 1;
+    *slot = { key, blob, bytes, g_pageLen, g_lineCount, g_spanCount, g_linkCount, ++g_cacheClock };
+    g_cacheBytes += bytes;
+}
+
+void cacheDrop(const String& url) {
+    if (CacheEntry* e = cacheFind(url.c_str())) cacheFree(*e);
+}
+
+size_t cacheBytes() { return g_cacheBytes; }
+
+int cacheCount() {
+    int n = 0;
+    for (int i = 0; i < PAGE_CACHE_SLOTS; i++) if (g_cache[i].url) n++;
+    return n;
+}
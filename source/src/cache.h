@@ -0,0 +1,11 @@
+#pragma once
+#include "page.h"
+
+#define PAGE_CACHE_SLOTS   16
+#define PAGE_CACHE_BUDGET  (2 * 1024 * 1024)
+
+bool   cacheLoad(const String& url);
+void   cacheStore(const String& url);
+void   cacheDrop(const String& url);
+size_t cacheBytes();
+int    cacheCount();
@@ -0,0 +1,156 @@
+#include "find.h"
+#include "text.h"
+
+struct FindWord { uint32_t off, next; };        // next: entry + 1, 0 ends the chain
+
+static uint32_t* s_head = nullptr;              // per bucket, first and last entry + 1
+static uint32_t* s_tail = nullptr;
+static FindWord* s_segs[FIND_MAX_SEGS];
+static uint32_t  s_words = 0, s_to = 0;         // entries, and the text they cover
+static bool      s_inWord = false, s_full = false;
+static uint32_t* s_hits = nullptr;
+static int       s_hitCount = 0, s_len = 0;
+
+static inline FindWord& word(uint32_t i)  { return s_segs[i >> FIND_SEG_SHIFT][i & (FIND_SEG_SIZE - 1)]; }
+static inline uint32_t bucketOf(uint32_t key) { return (key * 2654435761u) >> (32 - FIND_BUCKET_BITS); }
+
+// The key is the first word's first three bytes, folded; k gets how many of
+// them were word bytes.
+static uint32_t keyOf(const uint8_t* p, int n, int& k) {
+    uint32_t key = 0;
+    for (k = 0; k < min(n, 3) && wordByte(p[k]); k++) key |= (uint32_t)wordFold(p[k]) << (8 * k);
+    return key;
+}
+
+void findReset() {
+    if (s_head && s_words) {
+        memset(s_head, 0, sizeof(uint32_t) << FIND_BUCKET_BITS);
+        memset(s_tail, 0, sizeof(uint32_t) << FIND_BUCKET_BITS);
+    }
+    for (int s = 1; s < FIND_MAX_SEGS; s++) { heap_caps_free(s_segs[s]); s_segs[s] = nullptr; }
+    s_words = s_to = 0; s_inWord = s_full = false; s_hitCount = 0;
+}
+
+static bool findAdd(uint32_t off, uint32_t key) {
+    if (!s_head) {
+        s_head = (uint32_t*)heap_caps_malloc(2 * sizeof(uint32_t) << FIND_BUCKET_BITS, MALLOC_CAP_SPIRAM);
+        if (!s_head) return false;
+        s_tail = s_head + (1 << FIND_BUCKET_BITS);
+        memset(s_head, 0, 2 * sizeof(uint32_t) << FIND_BUCKET_BITS);
+    }
+    uint32_t s = s_words >> FIND_SEG_SHIFT;
+    if (s >= FIND_MAX_SEGS) return false;
+    if (!s_segs[s] && !(s_segs[s] = (FindWord*)heap_caps_malloc(FIND_SEG_SIZE * sizeof(FindWord), MALLOC_CAP_SPIRAM)))
+        return false;
+    uint32_t b = bucketOf(key), e = ++s_words;
+    word(e - 1) = {off, 0};
+    if (s_tail[b]) word(s_tail[b] - 1).next = e; else s_head[b] = e;
+    s_tail[b] = e;
+    return true;
+}
+
+// A word whose start has arrived but not its third byte waits for the next
+// feed, unless this is the last.
+void findFeed(bool final) {
+    while (s_to < g_pageLen && !s_full) {
+        char c0; pageRead(s_to, &c0, 1);        // brings the segment in on a saved page
+        const uint8_t* seg = (const uint8_t*)g_pageSegs[s_to >> PAGE_SEG_SHIFT];
+        uint32_t end = min((uint32_t)g_pageLen, ((s_to >> PAGE_SEG_SHIFT) + 1) << PAGE_SEG_SHIFT);
+        for (; s_to < end; s_to++) {
+            bool w = wordByte(seg[s_to & (PAGE_SEG_SIZE - 1)]);
+            if (w && !s_inWord) {
+                uint8_t b[3]; int n = (int)min((size_t)3, g_pageLen - s_to), k;
+                if (s_to + n <= end) memcpy(b, seg + (s_to & (PAGE_SEG_SIZE - 1)), n); else pageRead(s_to, (char*)b, n);
+                uint32_t key = keyOf(b, n, k);
+                if (k == n && n < 3 && !final) return;
+                if (!findAdd(s_to, key)) { s_full = true; return; }
+            }
+            s_inWord = w;
+        }
+    }
+}
+
+static bool matchAt(uint32_t p, const uint8_t* pat, int n) {
+    if (p + n > g_pageLen) return false;
+    uint32_t off = p & (PAGE_SEG_SIZE - 1);
+    const uint8_t* t; uint8_t buf[FIND_QUERY_MAX];
+    if (off + n <= PAGE_SEG_SIZE) { char c; pageRead(p, &c, 1); t = (const uint8_t*)g_pageSegs[p >> PAGE_SEG_SHIFT] + off; }
+    else { pageRead(p, (char*)buf, n); t = buf; }
+    for (int i = 0; i < n; i++) if (wordFold(t[i]) != pat[i]) return false;
+    return true;
+}
+
+static uint8_t byteAt(uint32_t p) { char c; pageRead(p, &c, 1); return (uint8_t)c; }
+
+static bool pushHit(uint32_t p) {
+    if (s_hitCount >= FIND_MAX_HITS) return false;
+    s_hits[s_hitCount++] = p;
+    return true;
+}
+
+// SWAR: eight bytes at once for the query's first byte (folded by setting
+// bit 5 everywhere when it is a letter), then each candidate in full. The
+// zero-byte test can flag a byte above a real zero; the full compare
+// weeds those out.
+static void scanFrom(uint32_t from, const uint8_t* pat, int n, bool atWord) {
+    const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+    bool letter = (uint8_t)(pat[0] - 'a') < 26;
+    uint64_t want = ones * pat[0], caseBits = letter ? ones * 0x20 : 0;
+    for (uint32_t p = from; p < g_pageLen;) {
+        char c0; pageRead(p, &c0, 1);
+        const uint8_t* seg = (const uint8_t*)g_pageSegs[p >> PAGE_SEG_SHIFT];
+        uint32_t base = p & ~(PAGE_SEG_SIZE - 1), end = min((uint32_t)g_pageLen, base + PAGE_SEG_SIZE);
+        for (; p < end; p += 8) {
+            uint64_t x;
+            if (p + 8 <= end) memcpy(&x, seg + (p - base), 8);
+            else { x = ~want; memcpy(&x, seg + (p - base), end - p); }
+            uint64_t v = (x | caseBits) ^ want, hit = (v - ones) & ~v & highs;
+            while (hit) {
+                uint32_t q = p + (__builtin_ctzll(hit) >> 3);
+                hit &= hit - 1;
+                if (q >= end || (atWord && q > 0 && wordByte(q > base ? seg[q - 1 - base] : byteAt(q - 1)))) continue;
+                if (matchAt(q, pat, n) && !pushHit(q)) return;
+            }
+        }
+        p = end;
+    }
+}
+
+int findQuery(const char* q) {
+    s_hitCount = 0; s_len = 0;
+    uint8_t pat[FIND_QUERY_MAX];
+    while (q[s_len] && s_len < FIND_QUERY_MAX) { pat[s_len] = wordFold((uint8_t)q[s_len]); s_len++; }
+    if (!s_len) return 0;
+    if (!s_hits && !(s_hits = (uint32_t*)heap_caps_malloc(FIND_MAX_HITS * sizeof(uint32_t), MALLOC_CAP_SPIRAM))) return 0;
+    bool atWord = wordByte(pat[0]);
+    int k; uint32_t key = keyOf(pat, s_len, k), from = 0;
+    // Usable when the key is all three bytes, or the query's first word ends
+    // inside them (then only words of exactly that length match).
+    if (atWord && s_words && (k == 3 || k < s_len)) {
+        for (uint32_t e = s_head[bucketOf(key)]; e; e = word(e - 1).next)
+            if (matchAt(word(e - 1).off, pat, s_len) && !pushHit(word(e - 1).off)) return s_hitCount;
+        from = s_to;
+    }
+    scanFrom(from, pat, s_len, atWord);
+    return s_hitCount;
+}
+
+uint32_t findHit(int i) { return i >= 0 && i < s_hitCount ? s_hits[i] : 0; }
+int      findLen()      { return s_len; }
+
+int findRow(uint32_t off) {
+    int lo = 0, hi = g_lineCount;
+    LineSpan l;
+    while (lo < hi) { int mid = (lo + hi) >> 1; lineRead(mid, &l, 1); if (l.start <= off) lo = mid + 1; else hi = mid; }
+    int row = max(lo - 1, 0);
+    while (row > 0 && (lineRead(row, &l, 1), l.cont)) row--;
+    return row;
+}
+
+uint32_t findIndexed() { return s_to; }
+
+size_t findIndexBytes() {
+    size_t n = s_head ? 2 * sizeof(uint32_t) << FIND_BUCKET_BITS : 0;
+    for (int s = 0; s < FIND_MAX_SEGS; s++) if (s_segs[s]) n += FIND_SEG_SIZE * sizeof(FindWord);
+    return n;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "page.h"
+
+// Find in page. A match starts at a word start when the query starts with a
+// letter or digit (anywhere otherwise) and ignores ASCII case. lineFeed
+// keeps a word-start index up to date as the page is stripped: every word's
+// offset, chained in text order under a hash of its first three bytes, so a
+// query walks only the words that begin like it. What the index doesn't
+// cover -- a page from the cache or flash, text past FIND_MAX_WORDS, or a
+// query whose first word is a bare one- or two-letter prefix -- is scanned
+// eight bytes at a time. Hits come back in text order.
+#define FIND_BUCKET_BITS  12
+#define FIND_SEG_SHIFT    12
+#define FIND_SEG_SIZE     (1u << FIND_SEG_SHIFT)
+#define FIND_MAX_SEGS     32
+#define FIND_MAX_WORDS    (FIND_SEG_SIZE * FIND_MAX_SEGS)
+#define FIND_MAX_HITS     4096
+#define FIND_QUERY_MAX    64
+
+void     findReset();
+void     findFeed(bool final);
+int      findQuery(const char* q);
+uint32_t findHit(int i);
+int      findLen();
+// The line a text offset is drawn on (the first row of a two-row heading).
+int      findRow(uint32_t off);
+uint32_t findIndexed();
+size_t   findIndexBytes();
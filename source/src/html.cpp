@@ -0,0 +1,196 @@
+#include "html.h"
+#include "entities.h"
+
+// FNV-1a with a seed folded into the basis; constexpr so the tables below are
+// laid out by the compiler and live in flash.
+static constexpr uint32_t nameHash(const char* s, int n, uint32_t seed) {
+    uint32_t h = 2166136261u + seed * 0x9E3779B9u;
+    for (int i = 0; i < n; i++) { h ^= (uint8_t)s[i]; h *= 16777619u; }
+    return h;
+}
+static constexpr int nameLen(const char* s) { int n = 0; while (s[n]) n++; return n; }
+
+// ---- tag names ---------------------------------------------------------------
+
+struct TagName { const char* name; uint8_t id; };
+
+static constexpr TagName TAG_NAMES[] = {
+    {"a", TAG_A}, {"script", TAG_SCRIPT}, {"style", TAG_STYLE}, {"head", TAG_HEAD},
+    {"p", TAG_P | TAG_BLOCK}, {"div", TAG_DIV | TAG_BLOCK}, {"br", TAG_BR | TAG_BLOCK},
+    {"h1", TAG_H1 | TAG_BLOCK}, {"h2", TAG_H2 | TAG_BLOCK}, {"h3", TAG_H3 | TAG_BLOCK}, {"h4", TAG_H4 | TAG_BLOCK},
+    {"li", TAG_LI | TAG_BLOCK}, {"tr", TAG_TR | TAG_BLOCK}, {"td", TAG_TD | TAG_BLOCK}, {"th", TAG_TH | TAG_BLOCK},
+    {"article", TAG_ARTICLE | TAG_BLOCK}, {"section", TAG_SECTION | TAG_BLOCK}, {"header", TAG_HEADER | TAG_BLOCK},
+    {"footer", TAG_FOOTER | TAG_BLOCK}, {"nav", TAG_NAV | TAG_BLOCK}, {"main", TAG_MAIN | TAG_BLOCK},
+};
+#define TAG_COUNT  (int)(sizeof(TAG_NAMES) / sizeof(TAG_NAMES[0]))
+#define TAG_SLOTS  64
+
+// First seed that puts every name in a slot of its own: a perfect hash, so a
+// lookup is one hash, one slot and one compare.
+static constexpr uint32_t tagSeed() {
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        bool used[TAG_SLOTS] = {}, ok = true;
+        for (int i = 0; i < TAG_COUNT && ok; i++) {
+            uint32_t s = nameHash(TAG_NAMES[i].name, nameLen(TAG_NAMES[i].name), seed) & (TAG_SLOTS - 1);
+            ok = !used[s]; used[s] = true;
+        }
+        if (ok) return seed;
+    }
+    return ~0u;
+}
+static constexpr uint32_t TAG_SEED = tagSeed();
+static_assert(TAG_SEED != ~0u, "no collision-free seed for TAG_NAMES");
+
+struct TagIndex { uint8_t slot[TAG_SLOTS]; };
+static constexpr TagIndex tagIndex() {
+    TagIndex ix = {};
+    for (int i = 0; i < TAG_COUNT; i++)
+        ix.slot[nameHash(TAG_NAMES[i].name, nameLen(TAG_NAMES[i].name), TAG_SEED) & (TAG_SLOTS - 1)] = (uint8_t)(i + 1);
+    return ix;
+}
+static constexpr TagIndex TAG_INDEX = tagIndex();
+
+uint8_t tagLookup(const char* name, int n) {
+    uint8_t i = TAG_INDEX.slot[nameHash(name, n, TAG_SEED) & (TAG_SLOTS - 1)];
+    if (!i) return TAG_NONE;
+    const char* c = TAG_NAMES[i - 1].name;
+    return (!strncmp(c, name, n) && !c[n]) ? TAG_NAMES[i - 1].id : (uint8_t)TAG_NONE;
+}
+
+// ---- character references ---------------------------------------------------
+
+// Open addressing at about half load; a hit is a probe or two.
+#define ENT_SLOTS 4096
+
+struct EntIndex { uint16_t slot[ENT_SLOTS]; };
+static constexpr EntIndex entIndex() {
+    EntIndex ix = {};
+    for (int i = 0; i < NAMED_ENTITY_COUNT; i++) {
+        uint32_t h = nameHash(NAMED_ENTITIES[i].name, nameLen(NAMED_ENTITIES[i].name), 0);
+        while (ix.slot[h & (ENT_SLOTS - 1)]) h++;
+        ix.slot[h & (ENT_SLOTS - 1)] = (uint16_t)(i + 1);
+    }
+    return ix;
+}
+static constexpr EntIndex ENT_INDEX = entIndex();
+static_assert(NAMED_ENTITY_COUNT < ENT_SLOTS * 3 / 4, "entity index too full");
+
+// &#128;-&#159; mean what windows-1252 puts there (HTML5 numeric reference rules).
+static const uint16_t CP1252_C1[32] = {
+    0x20AC, 0x81, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x8D, 0x017D, 0x8F,
+    0x90, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x9D, 0x017E, 0x0178
+};
+
+int utf8Put(uint32_t cp, char* out) {
+    if (cp < 0x80)    { out[0] = (char)cp; return 1; }
+    if (cp < 0x800)   { out[0] = (char)(0xC0 | cp >> 6); out[1] = (char)(0x80 | (cp & 0x3F)); return 2; }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | cp >> 12); out[1] = (char)(0x80 | ((cp >> 6) & 0x3F)); out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | cp >> 18); out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// One code point; a malformed or cut-short sequence reads as U+FFFD, one byte.
+int utf8Get(const uint8_t* s, int n, uint32_t& cp) {
+    uint8_t c = s[0];
+    int k = c < 0x80 ? 0 : c < 0xC2 ? -1 : c < 0xE0 ? 1 : c < 0xF0 ? 2 : c < 0xF5 ? 3 : -1;
+    if (k == 0) { cp = c; return 1; }
+    if (k < 0 || k >= n) { cp = 0xFFFD; return 1; }
+    cp = c & (0x3F >> k);
+    for (int i = 1; i <= k; i++) {
+        if ((s[i] & 0xC0) != 0x80) { cp = 0xFFFD; return 1; }
+        cp = cp << 6 | (s[i] & 0x3F);
+    }
+    static const uint32_t least[4] = { 0, 0x80, 0x800, 0x10000 };
+    if (cp < least[k] || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) { cp = 0xFFFD; return 1; }
+    return k + 1;
+}
+
+int entityDecode(const char* name, int n, char* out) {
+    if (n <= 0) return 0;
+    if (name[0] == '#') {
+        bool hex = n > 1 && (name[1] == 'x' || name[1] == 'X');
+        int i = hex ? 2 : 1;
+        if (i >= n) return 0;
+        uint32_t cp = 0;
+        for (; i < n; i++) {
+            char c = name[i]; int d;
+            if (c >= '0' && c <= '9') d = c - '0';
+            else if (hex && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') d = (c | 0x20) - 'a' + 10;
+            else return 0;
+            cp = cp * (hex ? 16 : 10) + d;
+            if (cp > 0x10FFFF) cp = 0x110000;
+        }
+        if (cp >= 0x80 && cp < 0xA0) cp = CP1252_C1[cp - 0x80];
+        if (cp == 0 || cp > 0x10FFFF || (cp >= 0xD800 && cp < 0xE000)) cp = 0xFFFD;
+        return utf8Put(cp, out);
+    }
+    for (uint32_t h = nameHash(name, n, 0);; h++) {
+        uint16_t i = ENT_INDEX.slot[h & (ENT_SLOTS - 1)];
+        if (!i) return 0;
+        const NamedEntity& e = NAMED_ENTITIES[i - 1];
+        if (strncmp(e.name, name, n) || e.name[n]) continue;
+        int k = utf8Put(e.cp, out);
+        return e.cp2 ? k + utf8Put(e.cp2, out + k) : k;
+    }
+}
+
+// ---- ASCII folding -----------------------------------------------------------
+
+static const char* const LATIN1_FOLD[96] = {
+    " ", "!", "c", "L", "$", "Y", "|", "S", "\"", "(c)", "a", "<<", "-", "", "(R)", "-",
+    "o", "+-", "2", "3", "'", "u", "P", ".", ",", "1", "o", ">>", "1/4", "1/2", "3/4", "?",
+    "A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+    "D", "N", "O", "O", "O", "O", "O", "x", "O", "U", "U", "U", "U", "Y", "Th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", "/", "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+// U+0100-U+017F, base letter of each.
+static const char LATIN_A_FOLD[] =
+    "AaAaAaCcCcCcCcDdDdEeEeEeEeEeGgGgGgGgHhHhIiIiIiIiIiIiJjKkkLlLlLlLlLlNnNnNnnNnOoOoOoOoRrRrRrSsSsSsSsTtTtTtUuUuUuUuUuUuWwYyYZzZzZzs";
+
+static const char* foldCp(uint32_t cp, char* one) {
+    if (cp >= 0xA0 && cp < 0x100) return LATIN1_FOLD[cp - 0xA0];
+    if (cp >= 0x100 && cp < 0x180) {
+        if (cp == 0x152) return "OE";
+        if (cp == 0x153) return "oe";
+        one[0] = LATIN_A_FOLD[cp - 0x100]; one[1] = 0; return one;
+    }
+    if (cp >= 0x300 && cp < 0x370) return "";
+    switch (cp) {
+        case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014: case 0x2015: case 0x2212: return "-";
+        case 0x2018: case 0x2019: case 0x201A: case 0x201B: case 0x2032: case 0x02BC: return "'";
+        case 0x201C: case 0x201D: case 0x201E: case 0x201F: case 0x2033: return "\"";
+        case 0x2039: return "<";
+        case 0x203A: return ">";
+        case 0x2022: case 0x2023: case 0x2043: return "*";
+        case 0x2026: return "...";
+        case 0x2020: return "+";
+        case 0x20AC: return "EUR";
+        case 0x2122: return "TM";
+        case 0x2190: return "<-";
+        case 0x2192: return "->";
+        case 0x02C6: return "^";
+        case 0x02DC: return "~";
+        case 0x0192: return "f";
+        case 0x2030: return "%";
+        case 0x200B: case 0x200C: case 0x200D: case 0x2060: case 0xFEFF: return "";
+    }
+    return " ";   // other spaces, and anything the font has no look-alike for
+}
+
+int asciiFold(const char* s, int n, char* out) {
+    int o = 0;
+    for (int i = 0; i < n;) {
+        uint32_t cp;
+        i += utf8Get((const uint8_t*)s + i, n - i, cp);
+        if (cp < 0x80) { out[o++] = (char)cp; continue; }
+        char one[2];
+        for (const char* f = foldCp(cp, one); *f; f++) out[o++] = *f;
+    }
+    return o;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+// Tag ids for the names the stripper acts on. Block tags carry TAG_BLOCK.
+enum {
+    TAG_NONE, TAG_A, TAG_SCRIPT, TAG_STYLE, TAG_HEAD,
+    TAG_P, TAG_DIV, TAG_BR, TAG_H1, TAG_H2, TAG_H3, TAG_H4, TAG_LI, TAG_TR, TAG_TD, TAG_TH,
+    TAG_ARTICLE, TAG_SECTION, TAG_HEADER, TAG_FOOTER, TAG_NAV, TAG_MAIN,
+    TAG_ID_MASK = 0x3F, TAG_BLOCK = 0x40
+};
+
+// name is lower case, n bytes, no terminator needed.
+uint8_t tagLookup(const char* name, int n);
+
+// Body of a character reference without '&' and ';' ("amp", "#233",
+// "#x2014") to UTF-8 in out (8 bytes is enough). Returns the byte count, 0 if
+// it isn't a known reference.
+int entityDecode(const char* name, int n, char* out);
+
+int  utf8Put(uint32_t cp, char* out);
+int  utf8Get(const uint8_t* s, int n, uint32_t& cp);
+
+// Bytes that start a display cell: not a continuation byte and not the lead
+// of U+0300-U+037F (combining marks, plus a few rare Greek signs that share
+// the lead bytes), which take no cell and aren't drawn.
+static inline bool utf8Cell(uint8_t b) { return (b & 0xC0) != 0x80 && (b & 0xFE) != 0xCC; }
+
+// UTF-8 to what the GLCD font can draw: ASCII look-alikes for Latin-1 and
+// common punctuation, a space for anything else. out needs 4 bytes per
+// input code point.
+int  asciiFold(const char* s, int n, char* out);
@@ -0,0 +1,250 @@
+#include "inflate.h"
+
+enum InflateState {
+    IS_WRAP, IS_GZFIXED, IS_GZFLAGS, IS_GZXLEN, IS_GZZERO, IS_SKIP,
+    IS_BLOCK, IS_STORED_LEN, IS_STORED, IS_TABLE_COUNTS, IS_TABLE_CL, IS_TABLE_LENS,
+    IS_CODES, IS_TRAILER, IS_DONE, IS_ERROR
+};
+
+struct Huff { uint16_t count[16]; uint16_t sym[288]; };
+
+static const uint16_t LBASE[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+static const uint8_t  LEXT[29]  = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+static const uint16_t DBASE[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+static const uint8_t  DEXT[30]  = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+static const uint8_t  CLORDER[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+
+static InflateState   if_state = IS_ERROR, if_after = IS_ERROR;
+static ContentCoding  if_coding;
+static BodySink       if_out = nullptr;
+static uint8_t*       if_win = nullptr;
+static uint32_t       if_wpos = 0, if_flushed = 0;
+static uint64_t       if_bits = 0;
+static int            if_nbits = 0;
+static const uint8_t* if_in; static const uint8_t* if_end;
+static bool           if_last = false, if_gzip = false, if_zlib = false, if_abort = false;
+static uint8_t        if_gzFlags = 0;
+static uint32_t       if_left = 0;
+static int            if_nlen, if_ndist, if_ncode, if_li;
+static uint16_t       if_lens[320], if_cll[19];
+static Huff           if_lit, if_dist, if_cl, if_flit, if_fdist;
+static const Huff*    if_L; static const Huff* if_D;
+static bool           if_fixedReady = false;
+
+static void refill() {
+    while (if_nbits <= 56 && if_in < if_end) { if_bits |= (uint64_t)*if_in++ << if_nbits; if_nbits += 8; }
+}
+static bool need(int n) { if (if_nbits < n) refill(); return if_nbits >= n; }
+static uint32_t peek(int n) { return (uint32_t)(if_bits & ((1ull << n) - 1)); }
+static void drop(int n) { if_bits >>= n; if_nbits -= n; }
+
+// Canonical Huffman as in zlib's puff: count of codes per length, symbols in
+// code order. Returns <0 for an over-subscribed set, >0 for an incomplete one.
+static int huffBuild(Huff& h, const uint16_t* len, int n) {
+    memset(h.count, 0, sizeof(h.count));
+    for (int i = 0; i < n; i++) h.count[len[i]]++;
+    if (h.count[0] == n) return 0;
+    int left = 1;
+    for (int l = 1; l < 16; l++) { left <<= 1; left -= h.count[l]; if (left < 0) return left; }
+    uint16_t offs[16]; offs[1] = 0;
+    for (int l = 1; l < 15; l++) offs[l+1] = offs[l] + h.count[l];
+    for (int i = 0; i < n; i++) if (len[i]) h.sym[offs[len[i]]++] = i;
+    return left;
+}
+
+// Decodes from the low `avail` bits of `bits`: the symbol, -1 if the code runs
+// past what's buffered, -2 if no code matches.
+static int huffDecode(const Huff& h, uint64_t bits, int avail, int& used) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+        if (len > avail) return -1;
+        code |= (int)(bits >> (len - 1)) & 1;
+        int count = h.count[len];
+        if (code - count < first) { used = len; return h.sym[index + (code - first)]; }
+        index += count; first += count; first <<= 1; code <<= 1;
+    }
+    return -2;
+}
+
+static bool flush() {
+    if (if_wpos == if_flushed) return true;
+    uint32_t off = if_flushed & (INFLATE_WINDOW - 1), n = if_wpos - if_flushed;
+    if_flushed = if_wpos;
+    if (!if_out(if_win + off, n)) { if_abort = true; return false; }
+    return true;
+}
+
+static inline bool put(uint8_t b) {
+    if_win[if_wpos++ & (INFLATE_WINDOW - 1)] = b;
+    return (if_wpos & (INFLATE_WINDOW - 1)) || flush();
+}
+
+bool inflateInit(ContentCoding coding, BodySink out) {
+    if (!if_win) if_win = (uint8_t*)heap_caps_malloc(INFLATE_WINDOW, MALLOC_CAP_SPIRAM);
+    if (!if_win) if_win = (uint8_t*)malloc(INFLATE_WINDOW);
+    if (!if_fixedReady) {
+        uint16_t l[288]; int i = 0;
+        for (; i < 144; i++) l[i] = 8;
+        for (; i < 256; i++) l[i] = 9;
+        for (; i < 280; i++) l[i] = 7;
+        for (; i < 288; i++) l[i] = 8;
+        huffBuild(if_flit, l, 288);
+        for (i = 0; i < 30; i++) l[i] = 5;
+        huffBuild(if_fdist, l, 30);
+        if_fixedReady = true;
+    }
+    if_coding = coding; if_out = out;
+    if_state = if_win ? IS_WRAP : IS_ERROR;
+    if_wpos = if_flushed = 0; if_bits = 0; if_nbits = 0;
+    if_last = if_gzip = if_zlib = if_abort = false;
+    return if_win != nullptr;
+}
+
+bool inflateDone() { return if_state == IS_DONE; }
+
+// Every step below either completes with all the bits it needs already
+// buffered or returns without consuming anything, so input can end anywhere.
+bool inflateFeed(const uint8_t* p, size_t n) {
+    if_in = p; if_end = p + n;
+    while (true) {
+        switch (if_state) {
+        case IS_WRAP: {
+            if (!need(16)) return flush();
+            uint32_t b0 = peek(8), b1 = peek(16) >> 8;
+            if (b0 == 0x1f && b1 == 0x8b) { if_gzip = true; if_left = 10; if_state = IS_GZFIXED; }
+            else if (if_coding == CODING_GZIP) if_state = IS_ERROR;
+            else if ((b0 & 0x0f) == 8 && !(b1 & 0x20) && (b0 * 256 + b1) % 31 == 0) { drop(16); if_zlib = true; if_state = IS_BLOCK; }
+            else if_state = IS_BLOCK;
+            break;
+        }
+        case IS_GZFIXED:
+            while (if_left) {
+                if (!need(8)) return flush();
+                uint32_t b = peek(8), i = 10 - if_left; drop(8); if_left--;
+                if (i == 2 && b != 8) { if_state = IS_ERROR; break; }
+                if (i == 3) if_gzFlags = (uint8_t)b;
+            }
+            if (if_state != IS_ERROR) if_state = IS_GZFLAGS;
+            break;
+        case IS_GZFLAGS:
+            if      (if_gzFlags & 4)  { if_gzFlags &= ~4;  if_state = IS_GZXLEN; }
+            else if (if_gzFlags & 8)  { if_gzFlags &= ~8;  if_state = IS_GZZERO; }
+            else if (if_gzFlags & 16) { if_gzFlags &= ~16; if_state = IS_GZZERO; }
+            else if (if_gzFlags & 2)  { if_gzFlags &= ~2;  if_left = 2; if_after = IS_GZFLAGS; if_state = IS_SKIP; }
+            else if_state = IS_BLOCK;
+            break;
+        case IS_GZXLEN:
+            if (!need(16)) return flush();
+            if_left = peek(16); drop(16); if_after = IS_GZFLAGS; if_state = IS_SKIP;
+            break;
+        case IS_GZZERO:
+            while (true) {
+                if (!need(8)) return flush();
+                uint32_t b = peek(8); drop(8);
+                if (!b) break;
+            }
+            if_state = IS_GZFLAGS;
+            break;
+        case IS_SKIP:
+            while (if_left) { if (!need(8)) return flush(); drop(8); if_left--; }
+            if_state = if_after;
+            break;
+        case IS_BLOCK: {
+            if (!need(3)) return flush();
+            uint32_t h = peek(3); drop(3);
+            if_last = h & 1;
+            switch (h >> 1) {
+                case 0:  drop(if_nbits & 7); if_state = IS_STORED_LEN; break;
+                case 1:  if_L = &if_flit; if_D = &if_fdist; if_state = IS_CODES; break;
+                case 2:  if_state = IS_TABLE_COUNTS; break;
+                default: if_state = IS_ERROR; break;
+            }
+            break;
+        }
+        case IS_STORED_LEN: {
+            if (!need(32)) return flush();
+            uint32_t len = peek(16), nlen = peek(32) >> 16; drop(32);
+            if ((len ^ 0xffff) != nlen) { if_state = IS_ERROR; break; }
+            if_left = len; if_state = IS_STORED;
+            break;
+        }
+        case IS_STORED:
+            while (if_left) {
+                if (!need(8)) return flush();
+                uint8_t b = (uint8_t)peek(8); drop(8); if_left--;
+                if (!put(b)) return false;
+            }
+            if_state = if_last ? IS_TRAILER : IS_BLOCK;
+            break;
+        case IS_TABLE_COUNTS:
+            if (!need(14)) return flush();
+            if_nlen = 257 + peek(5); if_ndist = 1 + (peek(10) >> 5); if_ncode = 4 + (peek(14) >> 10); drop(14);
+            if (if_nlen > 286 || if_ndist > 30) { if_state = IS_ERROR; break; }
+            memset(if_cll, 0, sizeof(if_cll)); if_li = 0; if_state = IS_TABLE_CL;
+            break;
+        case IS_TABLE_CL:
+            while (if_li < if_ncode) {
+                if (!need(3)) return flush();
+                if_cll[CLORDER[if_li++]] = peek(3); drop(3);
+            }
+            if (huffBuild(if_cl, if_cll, 19) != 0) { if_state = IS_ERROR; break; }
+            if_li = 0; if_state = IS_TABLE_LENS;
+            break;
+        case IS_TABLE_LENS: {
+            while (if_li < if_nlen + if_ndist) {
+                refill();
+                int used, sym = huffDecode(if_cl, if_bits, if_nbits, used);
+                if (sym == -1) return flush();
+                if (sym < 0) { if_state = IS_ERROR; break; }
+                if (sym < 16) { drop(used); if_lens[if_li++] = sym; continue; }
+                int eb = sym == 16 ? 2 : sym == 17 ? 3 : 7;
+                if (used + eb > if_nbits) return flush();
+                int rep = (sym == 18 ? 11 : 3) + (int)((if_bits >> used) & ((1u << eb) - 1));
+                if ((sym == 16 && !if_li) || if_li + rep > if_nlen + if_ndist) { if_state = IS_ERROR; break; }
+                uint16_t v = sym == 16 ? if_lens[if_li - 1] : 0;
+                drop(used + eb);
+                while (rep--) if_lens[if_li++] = v;
+            }
+            if (if_state == IS_ERROR) break;
+            int el = huffBuild(if_lit, if_lens, if_nlen), ed = huffBuild(if_dist, if_lens + if_nlen, if_ndist);
+            if (!if_lens[256] || el < 0 || (el > 0 && if_nlen - if_lit.count[0] != 1) ||
+                ed < 0 || (ed > 0 && if_ndist - if_dist.count[0] != 1)) { if_state = IS_ERROR; break; }
+            if_L = &if_lit; if_D = &if_dist; if_state = IS_CODES;
+            break;
+        }
+        case IS_CODES:
+            while (true) {
+                refill();
+                int u1, sym = huffDecode(*if_L, if_bits, if_nbits, u1);
+                if (sym == -1) return flush();
+                if (sym < 0) { if_state = IS_ERROR; break; }
+                if (sym < 256) { drop(u1); if (!put((uint8_t)sym)) return false; continue; }
+                if (sym == 256) { drop(u1); if_state = if_last ? IS_TRAILER : IS_BLOCK; break; }
+                sym -= 257;
+                if (sym >= 29) { if_state = IS_ERROR; break; }
+                int le = LEXT[sym];
+                if (u1 + le > if_nbits) return flush();
+                uint32_t len = LBASE[sym] + (uint32_t)((if_bits >> u1) & ((1u << le) - 1));
+                int u2, ds = huffDecode(*if_D, if_bits >> (u1 + le), if_nbits - u1 - le, u2);
+                if (ds == -1) return flush();
+                if (ds < 0 || ds >= 30) { if_state = IS_ERROR; break; }
+                int de = DEXT[ds];
+                if (u1 + le + u2 + de > if_nbits) return flush();
+                uint32_t dist = DBASE[ds] + (uint32_t)((if_bits >> (u1 + le + u2)) & ((1u << de) - 1));
+                drop(u1 + le + u2 + de);
+                if (dist > if_wpos) { if_state = IS_ERROR; break; }
+                while (len--) if (!put(if_win[(if_wpos - dist) & (INFLATE_WINDOW - 1)])) return false;
+            }
+            break;
+        case IS_TRAILER:
+            drop(if_nbits & 7);
+            if_left = if_gzip ? 8 : if_zlib ? 4 : 0; if_after = IS_DONE; if_state = IS_SKIP;
+            break;
+        case IS_DONE:
+            return flush();
+        case IS_ERROR:
+            flush();
+            return false;
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include "page.h"
+
+#define INFLATE_WINDOW  32768
+
+// Push-model DEFLATE decoder for gzip / zlib / raw deflate bodies. Compressed
+// bytes can be fed in any split; output goes to the sink as it is produced,
+// through a fixed 32 KB history window in PSRAM. One instance, like the
+// stripper.
+bool inflateInit(ContentCoding coding, BodySink out);
+bool inflateFeed(const uint8_t* p, size_t n);
+bool inflateDone();
@@ -0,0 +1,505 @@
+#include "local.h"
+#include "text.h"
+#include <algorithm>
+
+#define LOCAL_TITLE  64
+#define FNV_BASIS    2166136261u
+
+struct LocalDoc { uint32_t id, str, urlHash; uint16_t urlLen; uint8_t titleLen; bool live; };
+struct LocalSeg { uint8_t* img; uint32_t seq; int level; };
+
+static fs::FS*   s_fs = nullptr;
+static LocalDoc* s_docs = nullptr;              // by id, as appended
+static int       s_docCount = 0, s_docCap = 0, s_live = 0;
+static char*     s_str = nullptr;               // url \0 title \0 of every doc
+static uint32_t  s_strLen = 0, s_strCap = 0;
+static LocalSeg  s_segs[LOCAL_MAX_SEGS];        // by doc range
+static int       s_segCount = 0;
+static uint32_t  s_nextDoc = 1, s_nextSeq = 1;
+static int       s_pending = 0;                 // held segments, the last ones, seq 0
+static unsigned long s_pendingSince = 0;
+
+static inline int     ilog2(uint32_t v)   { return 31 - __builtin_clz(v | 1); }
+static inline const LocalSegHead& head(const LocalSeg& s) { return *(const LocalSegHead*)s.img; }
+
+static uint32_t fnv(const char* s) {
+    uint32_t h = FNV_BASIS;
+    while (*s) { h ^= (uint8_t)*s++; h *= 16777619u; }
+    return h;
+}
+
+// ---- byte buffers and varints ---------------------------------------------
+
+struct Buf { uint8_t* p = nullptr; size_t len = 0, cap = 0; bool ok = true; };
+
+static bool bufRoom(Buf& b, size_t n) {
+    if (!b.ok || b.len + n <= b.cap) return b.ok;
+    size_t cap = max(b.cap * 2, b.len + n + 256);
+    uint8_t* p = (uint8_t*)heap_caps_realloc(b.p, cap, MALLOC_CAP_SPIRAM);
+    if (!p) return b.ok = false;
+    b.p = p; b.cap = cap;
+    return true;
+}
+static void bufPut(Buf& b, const void* p, size_t n) { if (bufRoom(b, n)) { memcpy(b.p + b.len, p, n); b.len += n; } }
+static void bufFree(Buf& b) { heap_caps_free(b.p); b = Buf(); }
+
+static Buf s_pendRec;                           // /lx-docs records of the held segments
+
+static void putVar(Buf& b, uint32_t v) {
+    uint8_t t[5]; int n = 0;
+    do { t[n++] = (v & 0x7F) | (v > 0x7F ? 0x80 : 0); v >>= 7; } while (v);
+    bufPut(b, t, n);
+}
+
+static bool getVar(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int sh = 0; sh < 35 && p < end; sh += 7) {
+        uint8_t c = *p++;
+        v |= (uint32_t)(c & 0x7F) << sh;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+// ---- words -----------------------------------------------------------------
+
+// A word is a run of letters, digits and non-ASCII bytes; t carries one
+// across calls, and last ends it with the text.
+struct Words { uint32_t h = FNV_BASIS; int n = 0; };
+
+template <typename F> static void words(Words& t, const uint8_t* p, size_t n, bool last, F emit) {
+    for (size_t i = 0; i <= n; i++) {
+        if (i < n && wordByte(p[i])) { t.h = (t.h ^ wordFold(p[i])) * 16777619u; t.n++; continue; }
+        if (i == n && !last) break;
+        if (t.n >= 2 && t.n <= LOCAL_WORD_MAX) emit(t.h | !t.h);
+        t.h = FNV_BASIS; t.n = 0;
+    }
+}
+
+// ---- segments --------------------------------------------------------------
+
+struct SegBuild { Buf data, skip; uint32_t terms = 0, prev = 0; };
+
+static void buildTerm(SegBuild& b, uint32_t hash, uint32_t df, const Buf& post) {
+    if (b.terms % LOCAL_SKIP == 0) { LocalSkip k = {hash, (uint32_t)b.data.len}; bufPut(b.skip, &k, sizeof(k)); b.prev = 0; }
+    putVar(b.data, hash - b.prev); putVar(b.data, df); putVar(b.data, post.len);
+    bufPut(b.data, post.p, post.len);
+    b.prev = hash; b.terms++;
+}
+
+static uint8_t* buildFinish(SegBuild& b, uint32_t docs, uint32_t minDoc, uint32_t maxDoc) {
+    LocalSegHead h = {};
+    memcpy(h.magic, LOCAL_MAGIC, 4); h.version = LOCAL_VERSION; h.headSize = sizeof(h);
+    h.termCount = b.terms; h.docCount = docs; h.minDoc = minDoc; h.maxDoc = maxDoc;
+    h.skipCount = b.skip.len / sizeof(LocalSkip);
+    h.fileSize = sizeof(h) + b.skip.len + b.data.len;
+    uint8_t* img = b.data.ok && b.skip.ok ? (uint8_t*)heap_caps_malloc(h.fileSize, MALLOC_CAP_SPIRAM) : nullptr;
+    if (img) {
+        memcpy(img, &h, sizeof(h));
+        if (b.skip.len) memcpy(img + sizeof(h), b.skip.p, b.skip.len);
+        if (b.data.len) memcpy(img + sizeof(h) + b.skip.len, b.data.p, b.data.len);
+    }
+    bufFree(b.data); bufFree(b.skip);
+    return img;
+}
+
+static bool segCheck(const uint8_t* img, size_t size) {
+    if (size < sizeof(LocalSegHead)) return false;
+    const LocalSegHead& h = *(const LocalSegHead*)img;
+    if (memcmp(h.magic, LOCAL_MAGIC, 4) || h.version != LOCAL_VERSION || h.headSize != sizeof(LocalSegHead) ||
+        h.fileSize != size || h.minDoc > h.maxDoc || (uint64_t)h.skipCount * sizeof(LocalSkip) > size - h.headSize)
+        return false;
+    const LocalSkip* sk = (const LocalSkip*)(img + h.headSize);
+    uint32_t data = size - h.headSize - h.skipCount * sizeof(LocalSkip);
+    for (uint32_t i = 0; i < h.skipCount; i++)
+        if (sk[i].off >= data || (i && (sk[i].off <= sk[i - 1].off || sk[i].hash <= sk[i - 1].hash))) return false;
+    return true;
+}
+
+static int levelOf(uint32_t docs) { int l = 0; while (docs >= LOCAL_FANOUT) { docs /= LOCAL_FANOUT; l++; } return l; }
+
+static void segPath(char* out, size_t n, uint32_t seq, const char* ext) { snprintf(out, n, LOCAL_SEG_PREFIX "%08x%s", (unsigned)seq, ext); }
+
+static bool segWrite(const uint8_t* img, uint32_t seq) {
+    char path[24], tmp[24];
+    segPath(path, sizeof(path), seq, ".seg"); segPath(tmp, sizeof(tmp), seq, ".tmp");
+    uint32_t n = ((const LocalSegHead*)img)->fileSize;
+    File f = s_fs->open(tmp, "w");
+    bool ok = f && f.write(img, n) == n;
+    if (f) f.close();
+    ok = ok && s_fs->rename(tmp, path);
+    if (!ok) s_fs->remove(tmp);
+    return ok;
+}
+
+static void segDrop(int i) {
+    char path[24]; segPath(path, sizeof(path), s_segs[i].seq, ".seg");
+    if (s_segs[i].seq) s_fs->remove(path);
+    heap_caps_free(s_segs[i].img);
+    memmove(s_segs + i, s_segs + i + 1, (s_segCount - i - 1) * sizeof(LocalSeg));
+    s_segCount--;
+}
+
+// The postings of hash in s: the last skip entry at or below it, then at
+// most LOCAL_SKIP terms decoded.
+static bool segFind(const LocalSeg& s, uint32_t hash, const uint8_t*& post, uint32_t& bytes) {
+    const LocalSegHead& h = head(s);
+    const LocalSkip* sk = (const LocalSkip*)(s.img + h.headSize);
+    const uint8_t *data = (const uint8_t*)(sk + h.skipCount), *end = s.img + h.fileSize;
+    int lo = 0, hi = h.skipCount;
+    while (lo < hi) { int m = (lo + hi) >> 1; if (sk[m].hash <= hash) lo = m + 1; else hi = m; }
+    if (!lo) return false;
+    const uint8_t* p = data + sk[lo - 1].off;
+    uint32_t at = 0;
+    for (int i = 0; i < LOCAL_SKIP; i++) {
+        uint32_t d, df, n;
+        if (!getVar(p, end, d) || !getVar(p, end, df) || !getVar(p, end, n) || n > (uint32_t)(end - p)) return false;
+        at += d;
+        if (at == hash) { post = p; bytes = n; return true; }
+        if (at > hash || (p += n) >= end) return false;
+    }
+    return false;
+}
+
+struct SegIt { const uint8_t *p, *end, *post; uint32_t left, idx, hash, bytes; bool on; };
+
+static void itInit(SegIt& it, const LocalSeg& s) {
+    const LocalSegHead& h = head(s);
+    it.p = s.img + h.headSize + h.skipCount * sizeof(LocalSkip); it.end = s.img + h.fileSize;
+    it.left = h.termCount; it.idx = 0; it.hash = 0; it.on = true;
+}
+
+static bool itNext(SegIt& it) {
+    uint32_t d, df;
+    if (it.idx % LOCAL_SKIP == 0) it.hash = 0;
+    it.on = it.left && getVar(it.p, it.end, d) && getVar(it.p, it.end, df) && getVar(it.p, it.end, it.bytes) &&
+            it.bytes <= (uint32_t)(it.end - it.p);
+    if (!it.on) return false;
+    it.hash += d; it.post = it.p; it.p += it.bytes; it.idx++; it.left--;
+    return true;
+}
+
+// ---- docs ------------------------------------------------------------------
+
+static LocalDoc* docById(uint32_t id) {
+    int lo = 0, hi = s_docCount;
+    while (lo < hi) { int m = (lo + hi) >> 1; if (s_docs[m].id < id) lo = m + 1; else hi = m; }
+    return lo < s_docCount && s_docs[lo].id == id ? &s_docs[lo] : nullptr;
+}
+
+static const char* docUrl(const LocalDoc& d)   { return s_str + d.str; }
+static const char* docTitle(const LocalDoc& d) { return s_str + d.str + d.urlLen + 1; }
+
+// A url's earlier record dies with a new one, and the oldest live doc past
+// LOCAL_MAX_DOCS.
+static bool docPush(uint32_t id, const char* url, uint16_t ul, const char* title, uint8_t tl) {
+    if (s_docCount == s_docCap) {
+        int cap = max(64, s_docCap * 2);
+        LocalDoc* d = (LocalDoc*)heap_caps_realloc(s_docs, cap * sizeof(LocalDoc), MALLOC_CAP_SPIRAM);
+        if (!d) return false;
+        s_docs = d; s_docCap = cap;
+    }
+    if (s_strLen + ul + tl + 2 > s_strCap) {
+        uint32_t cap = max(s_strCap * 2, s_strLen + ul + tl + 4096);
+        char* p = (char*)heap_caps_realloc(s_str, cap, MALLOC_CAP_SPIRAM);
+        if (!p) return false;
+        s_str = p; s_strCap = cap;
+    }
+    LocalDoc& d = s_docs[s_docCount];
+    d = {id, s_strLen, 0, ul, tl, true};
+    memcpy(s_str + s_strLen, url, ul); s_str[s_strLen + ul] = 0;
+    memcpy(s_str + s_strLen + ul + 1, title, tl); s_str[s_strLen + ul + 1 + tl] = 0;
+    s_strLen += ul + tl + 2;
+    d.urlHash = fnv(docUrl(d));
+    for (int i = 0; i < s_docCount; i++)
+        if (s_docs[i].live && s_docs[i].urlHash == d.urlHash && !strcmp(docUrl(s_docs[i]), docUrl(d))) { s_docs[i].live = false; s_live--; }
+    s_docCount++; s_live++;
+    for (int i = 0; s_live > LOCAL_MAX_DOCS; i++) if (s_docs[i].live) { s_docs[i].live = false; s_live--; }
+    return true;
+}
+
+// One /lx-docs record: u32 id, u16 url bytes, u8 title bytes, u8 0, url, title.
+static void docRecord(Buf& b, uint32_t id, const char* url, uint16_t ul, const char* title, uint8_t tl) {
+    uint8_t r[8];
+    memcpy(r, &id, 4); memcpy(r + 4, &ul, 2); r[6] = tl; r[7] = 0;
+    bufPut(b, r, 8); bufPut(b, url, ul); bufPut(b, title, tl);
+}
+
+// Rewrites /lx-docs with the live docs only, once the dead outnumber them.
+static void docsCompact() {
+    if (s_docCount <= 2 * LOCAL_MAX_DOCS) return;
+    Buf b;
+    for (int i = 0; i < s_docCount; i++) if (s_docs[i].live) docRecord(b, s_docs[i].id, docUrl(s_docs[i]), s_docs[i].urlLen, docTitle(s_docs[i]), s_docs[i].titleLen);
+    File f = b.ok ? s_fs->open(LOCAL_DOCS_FILE ".tmp", "w") : File();
+    bool ok = f && f.write(b.p, b.len) == b.len;
+    if (f) f.close();
+    if (ok) { s_fs->remove(LOCAL_DOCS_FILE); ok = s_fs->rename(LOCAL_DOCS_FILE ".tmp", LOCAL_DOCS_FILE); }
+    if (ok) {
+        LocalDoc* old = s_docs; char* str = s_str; int n = s_docCount;
+        s_docs = nullptr; s_str = nullptr; s_docCount = s_docCap = s_live = 0; s_strLen = s_strCap = 0;
+        for (int i = 0; i < n; i++)
+            if (old[i].live) docPush(old[i].id, str + old[i].str, old[i].urlLen, str + old[i].str + old[i].urlLen + 1, old[i].titleLen);
+        heap_caps_free(old); heap_caps_free(str);
+    }
+    bufFree(b);
+}
+
+// ---- merging ---------------------------------------------------------------
+
+// Segments a..b-1 (neighbours, so their postings concatenate in doc order)
+// become one, without the dead docs.
+static bool segMerge(int a, int b) {
+    SegIt its[LOCAL_MAX_SEGS];
+    for (int i = a; i < b; i++) { itInit(its[i], s_segs[i]); itNext(its[i]); }
+    SegBuild out; Buf post;
+    uint32_t docs = 0, lastDoc = 0;
+    uint8_t* seen = (uint8_t*)heap_caps_malloc(s_docCount + 1, MALLOC_CAP_SPIRAM);
+    if (!seen) return false;
+    memset(seen, 0, s_docCount + 1);
+    for (;;) {
+        uint32_t h = UINT32_MAX; bool any = false;
+        for (int i = a; i < b; i++) if (its[i].on && (!any || its[i].hash < h)) { h = its[i].hash; any = true; }
+        if (!any) break;
+        post.len = 0;
+        uint32_t df = 0, prev = 0;
+        for (int i = a; i < b; i++) {
+            if (!its[i].on || its[i].hash != h) continue;
+            const uint8_t *p = its[i].post, *end = p + its[i].bytes;
+            for (uint32_t doc = 0, d, tf; getVar(p, end, d) && getVar(p, end, tf);) {
+                doc += d;
+                LocalDoc* ld = docById(doc);
+                if (!ld || !ld->live) continue;
+                putVar(post, doc - prev); putVar(post, tf); prev = doc; df++;
+                int k = ld - s_docs;
+                if (!seen[k]) { seen[k] = 1; docs++; lastDoc = max(lastDoc, doc); }
+            }
+            itNext(its[i]);
+        }
+        if (df) buildTerm(out, h, df, post);
+    }
+    heap_caps_free(seen); bufFree(post);
+    LocalSegHead first = head(s_segs[a]), last = head(s_segs[b - 1]);
+    uint8_t* img = docs ? buildFinish(out, docs, first.minDoc, last.maxDoc) : nullptr;
+    if (!docs) { bufFree(out.data); bufFree(out.skip); }
+    else if (!img) return false;
+    uint32_t seq = s_nextSeq++;
+    if (img && !segWrite(img, seq)) { heap_caps_free(img); return false; }
+    for (int i = b - 1; i >= a; i--) segDrop(i);
+    if (img) {
+        memmove(s_segs + a + 1, s_segs + a, (s_segCount - a) * sizeof(LocalSeg));
+        s_segs[a] = {img, seq, levelOf(docs)};
+        s_segCount++;
+    }
+    return true;
+}
+
+static int liveIn(const LocalSegHead& h) {
+    int n = 0;
+    for (int i = 0; i < s_docCount; i++) n += s_docs[i].live && s_docs[i].id >= h.minDoc && s_docs[i].id <= h.maxDoc;
+    return n;
+}
+
+// LOCAL_FANOUT neighbours on one level merge, newest first; a segment that
+// is mostly dead docs is rewritten on its own.
+static void localMaintain() {
+    for (bool again = true; again;) {
+        again = false;
+        for (int i = s_segCount - LOCAL_FANOUT; i >= 0 && !again; i--) {
+            bool same = true;
+            for (int j = i + 1; j < i + LOCAL_FANOUT; j++) same &= s_segs[j].level == s_segs[i].level;
+            if (same) again = segMerge(i, i + LOCAL_FANOUT);
+        }
+        for (int i = 0; i < s_segCount && !again; i++) {
+            const LocalSegHead& h = head(s_segs[i]);
+            if (h.docCount >= LOCAL_FANOUT && 2 * liveIn(h) < (int)h.docCount) again = segMerge(i, i + 1);
+        }
+    }
+}
+
+// ---- API -------------------------------------------------------------------
+
+static uint8_t* readAll(File& f, size_t& n) {
+    n = f.size();
+    uint8_t* p = (uint8_t*)heap_caps_malloc(max(n, (size_t)1), MALLOC_CAP_SPIRAM);
+    if (p && f.read(p, n) != n) { heap_caps_free(p); p = nullptr; }
+    return p;
+}
+
+void localBegin(fs::FS& fs) {
+    while (s_segCount) heap_caps_free(s_segs[--s_segCount].img);
+    bufFree(s_pendRec); s_pending = 0;
+    heap_caps_free(s_docs); heap_caps_free(s_str);
+    s_docs = nullptr; s_str = nullptr; s_docCount = s_docCap = s_live = 0; s_strLen = s_strCap = 0;
+    s_fs = &fs; s_nextDoc = s_nextSeq = 1;
+
+    // A record cut short by a reset ends the list.
+    if (File f = s_fs->open(LOCAL_DOCS_FILE, "r")) {
+        size_t n; uint8_t* p = readAll(f, n);
+        for (size_t at = 0; p && at + 8 <= n;) {
+            uint32_t id; uint16_t ul; memcpy(&id, p + at, 4); memcpy(&ul, p + at + 4, 2);
+            uint8_t tl = p[at + 6];
+            if (at + 8 + ul + tl > n || id < s_nextDoc) break;
+            docPush(id, (const char*)p + at + 8, ul, (const char*)p + at + 8 + ul, tl);
+            s_nextDoc = id + 1; at += 8 + ul + tl;
+        }
+        heap_caps_free(p);
+    }
+
+    String drop[LOCAL_MAX_SEGS]; int drops = 0;
+    File dir = fs.open("/");
+    for (File f = dir ? dir.openNextFile() : File(); f; f = dir.openNextFile()) {
+        const char* nm = f.name(); if (*nm == '/') nm++;
+        size_t len = strlen(nm);
+        if (strncmp(nm, LOCAL_SEG_PREFIX + 1, strlen(LOCAL_SEG_PREFIX) - 1) || len != 15) continue;
+        uint32_t seq = strtoul(nm + 3, nullptr, 16);
+        bool seg = !strcmp(nm + 11, ".seg");
+        size_t n; uint8_t* img = seg && s_segCount < LOCAL_MAX_SEGS ? readAll(f, n) : nullptr;
+        s_nextSeq = max(s_nextSeq, seq + 1);
+        if (!img || !segCheck(img, n)) {
+            heap_caps_free(img);
+            if (drops < LOCAL_MAX_SEGS) drop[drops++] = String("/") + nm;
+            continue;
+        }
+        int i = s_segCount++;
+        const LocalSegHead& h = *(const LocalSegHead*)img;
+        while (i > 0 && head(s_segs[i - 1]).minDoc > h.minDoc) { s_segs[i] = s_segs[i - 1]; i--; }
+        s_segs[i] = {img, seq, levelOf(h.docCount)};
+        s_nextDoc = max(s_nextDoc, h.maxDoc + 1);
+    }
+    for (int i = 0; i < drops; i++) fs.remove(drop[i].c_str());
+    // A merge that didn't get to delete its inputs left them inside its range.
+    for (int i = 0; i < s_segCount;) {
+        const LocalSegHead& h = head(s_segs[i]);
+        bool covered = false;
+        for (int j = 0; j < s_segCount && !covered; j++)
+            covered = j != i && s_segs[j].seq > s_segs[i].seq && head(s_segs[j]).minDoc <= h.minDoc && head(s_segs[j]).maxDoc >= h.maxDoc;
+        if (covered) segDrop(i); else i++;
+    }
+}
+
+bool localAdd(const String& url) {
+    if (!s_fs || g_pageLen < 20 || url.length() > 0xFFFF) return false;
+    struct Slot { uint32_t hash, tf; };
+    const uint32_t slots = LOCAL_TERMS * 2;
+    Slot* tab = (Slot*)heap_caps_malloc(slots * sizeof(Slot), MALLOC_CAP_SPIRAM);
+    if (!tab) return false;
+    memset(tab, 0, slots * sizeof(Slot));
+    int terms = 0;
+    auto add = [&](uint32_t h) {
+        for (uint32_t i = (h * 2654435761u) & (slots - 1);; i = (i + 1) & (slots - 1)) {
+            if (tab[i].hash == h) { tab[i].tf++; return; }
+            if (!tab[i].hash) { if (terms < LOCAL_TERMS) { tab[i] = {h, 1}; terms++; } return; }
+        }
+    };
+    Words w; uint8_t buf[1024];
+    for (uint32_t at = 0, n; at < g_pageLen; at += n) {
+        n = min((uint32_t)sizeof(buf), (uint32_t)g_pageLen - at);
+        pageRead(at, (char*)buf, n);
+        words(w, buf, n, at + n >= g_pageLen, add);
+    }
+    int k = 0;
+    for (uint32_t i = 0; i < slots; i++) if (tab[i].hash) tab[k++] = tab[i];
+    std::sort(tab, tab + k, [](const Slot& a, const Slot& b) { return a.hash < b.hash; });
+
+    uint32_t id = s_nextDoc++;
+    SegBuild b; Buf post;
+    for (int i = 0; i < k; i++) { post.len = 0; putVar(post, id); putVar(post, tab[i].tf); buildTerm(b, tab[i].hash, 1, post); }
+    heap_caps_free(tab);
+    bool ok = post.ok; bufFree(post);
+    uint8_t* img = ok ? buildFinish(b, 1, id, id) : nullptr;
+    if (!img) { bufFree(b.data); bufFree(b.skip); return false; }
+    if (s_segCount == LOCAL_MAX_SEGS) localFlush(true);
+    if (s_segCount == LOCAL_MAX_SEGS) { heap_caps_free(img); return false; }
+    s_segs[s_segCount++] = {img, 0, 0};
+    if (!s_pending++) s_pendingSince = millis();
+
+    char title[LOCAL_TITLE]; pageTitle(title, sizeof(title));
+    uint16_t ul = url.length(); uint8_t tl = strlen(title);
+    size_t at = s_pendRec.len;
+    docRecord(s_pendRec, id, url.c_str(), ul, title, tl);
+    // Without its record the segment's postings belong to nobody and go at
+    // the next merge.
+    ok = s_pendRec.ok && docPush(id, url.c_str(), ul, title, tl);
+    if (!ok) { s_pendRec.len = at; s_pendRec.ok = true; }
+    return ok;
+}
+
+// The held segments become one on flash, then their records follow: a
+// segment without records is dropped at a merge, records without a segment
+// just never match.
+bool localFlush(bool force) {
+    if (!s_pending || (!force && s_pending < LOCAL_PENDING && millis() - s_pendingSince < LOCAL_FLUSH_MS)) return true;
+    int a = s_segCount - s_pending;
+    bool ok;
+    if (s_pending > 1) ok = segMerge(a, s_segCount);
+    else if ((ok = segWrite(s_segs[a].img, s_nextSeq))) s_segs[a].seq = s_nextSeq++;
+    if (!ok) while (s_segCount > a) segDrop(s_segCount - 1);
+    s_pending = 0;
+    File f = ok && s_pendRec.len ? s_fs->open(LOCAL_DOCS_FILE, "a") : File();
+    ok = ok && (!s_pendRec.len || (f && f.write(s_pendRec.p, s_pendRec.len) == s_pendRec.len));
+    if (f) f.close();
+    bufFree(s_pendRec);
+    localMaintain();
+    docsCompact();
+    return ok;
+}
+
+bool localHas(const String& url) {
+    uint32_t h = fnv(url.c_str());
+    for (int i = s_docCount - 1; i >= 0; i--)
+        if (s_docs[i].live && s_docs[i].urlHash == h && !strcmp(docUrl(s_docs[i]), url.c_str())) return true;
+    return false;
+}
+
+// Every term must be there. A doc scores, per term, (1 + log2 tf) times an
+// idf of 1 + log2(16 live / df).
+int localQuery(const char* q, LocalHit* out, int cap) {
+    uint32_t terms[LOCAL_QUERY_TERMS]; int nt = 0;
+    Words w;
+    words(w, (const uint8_t*)q, strlen(q), true, [&](uint32_t h) {
+        for (int i = 0; i < nt; i++) if (terms[i] == h) return;
+        if (nt < LOCAL_QUERY_TERMS) terms[nt++] = h;
+    });
+    if (!nt || !s_live || cap <= 0) return 0;
+    struct Acc { uint32_t score; uint8_t terms; };
+    struct Post { int doc; uint32_t tf; };
+    Acc*  acc  = (Acc*)heap_caps_malloc(s_docCount * sizeof(Acc), MALLOC_CAP_SPIRAM);
+    Post* post = (Post*)heap_caps_malloc(s_docCount * sizeof(Post), MALLOC_CAP_SPIRAM);
+    int n = 0;
+    if (acc && post) {
+        memset(acc, 0, s_docCount * sizeof(Acc));
+        for (int t = 0; t < nt; t++) {
+            int df = 0;
+            for (int s = 0; s < s_segCount; s++) {
+                const uint8_t* p; uint32_t bytes;
+                if (!segFind(s_segs[s], terms[t], p, bytes)) continue;
+                const uint8_t* end = p + bytes;
+                for (uint32_t doc = 0, d, tf; getVar(p, end, d) && getVar(p, end, tf);) {
+                    doc += d;
+                    LocalDoc* ld = docById(doc);
+                    if (ld && ld->live && df < s_docCount) post[df++] = {(int)(ld - s_docs), tf};
+                }
+            }
+            if (!df) { n = -1; break; }
+            uint32_t idf = 1 + ilog2((uint32_t)(16 * s_live / df));
+            for (int i = 0; i < df; i++) { acc[post[i].doc].score += idf * (1 + ilog2(post[i].tf)); acc[post[i].doc].terms++; }
+        }
+        // Best first; on a tie the newer page.
+        for (int i = s_docCount - 1; n >= 0 && i >= 0; i--) {
+            if (acc[i].terms != nt) continue;
+            if (n == cap && acc[i].score <= out[n - 1].score) continue;
+            int j = min(n, cap - 1);
+            for (; j > 0 && out[j - 1].score < acc[i].score; j--) out[j] = out[j - 1];
+            out[j] = {docUrl(s_docs[i]), docTitle(s_docs[i]), acc[i].score};
+            if (n < cap) n++;
+        }
+    }
+    heap_caps_free(acc); heap_caps_free(post);
+    return max(n, 0);
+}
+
+LocalStats localStats() {
+    LocalStats st = {s_docCount, s_live, s_segCount, s_pending, 0};
+    for (int i = 0; i < s_segCount; i++) st.bytes += head(s_segs[i]).fileSize;
+    return st;
+}
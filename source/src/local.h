@@ -0,0 +1,65 @@
+#pragma once
+#include <FS.h>
+#include "page.h"
+
+// Local search over pages already read. Every page that loads in full, and
+// every page saved with W, has its words (ASCII-folded, 2 to LOCAL_WORD_MAX
+// bytes, hashed FNV-1a) put in an inverted index on flash:
+//   /lx-docs           one record per page: id, url, title, appended
+//   /lx-<seq>.seg      an index segment over a run of doc ids
+// A page becomes a segment of its own. Segments merge in tiers: when
+// LOCAL_FANOUT of them hold the same order of magnitude of docs (a level),
+// they become one segment of the next level, so a page is rewritten about
+// log4(docs) times over its life and a query visits at most a few dozen
+// segments. A doc is dead once a later record has its url or it falls out
+// of the newest LOCAL_MAX_DOCS; merges drop its postings.
+//
+// localAdd touches no flash: the page's segment and record wait in PSRAM,
+// already searchable, until localFlush writes them as one segment and runs
+// the merges. That happens once LOCAL_PENDING pages are held or the oldest
+// has waited LOCAL_FLUSH_MS, or when forced; held pages are lost to a reset.
+//
+// Segment file, little-endian, kept whole in PSRAM once read:
+//   LocalSegHead
+//   LocalSkip[skipCount]   hash and data offset of every LOCAL_SKIP-th term
+//   data: per term, by hash:
+//     varint hash delta (from 0 at each skip entry), varint df,
+//     varint bytes of postings, then df x (varint doc delta, varint tf)
+#define LOCAL_DOCS_FILE  "/lx-docs"
+#define LOCAL_SEG_PREFIX "/lx-"
+#define LOCAL_MAGIC      "CWLX"
+#define LOCAL_VERSION    1
+#define LOCAL_MAX_DOCS   256
+#define LOCAL_FANOUT     4
+#define LOCAL_MAX_SEGS   32
+#define LOCAL_SKIP       32
+#define LOCAL_TERMS      4096                  // distinct words indexed per page
+#define LOCAL_WORD_MAX   32
+#define LOCAL_QUERY_TERMS 8
+#define LOCAL_PENDING    8
+#define LOCAL_FLUSH_MS   (5 * 60 * 1000UL)
+
+struct LocalSegHead {
+    char     magic[4];
+    uint16_t version, headSize;
+    uint32_t fileSize;
+    uint32_t termCount, docCount;
+    uint32_t minDoc, maxDoc;
+    uint32_t skipCount;
+};
+struct LocalSkip { uint32_t hash, off; };
+
+struct LocalHit { const char* url; const char* title; uint32_t score; };
+
+void localBegin(fs::FS& fs);
+// Indexes the page in the store under url.
+bool localAdd(const String& url);
+// Writes the held pages if due (or force); false only if a write failed.
+bool localFlush(bool force);
+bool localHas(const String& url);
+// Pages holding every word of q, best first. The strings stay good until
+// the next localAdd.
+int  localQuery(const char* q, LocalHit* out, int max);
+
+struct LocalStats { int docs, live, segments, pending; size_t bytes; };
+LocalStats localStats();
@@ -2,24 +2,22 @@
 #include <TFT_eSPI.h>
 #include <Wire.h>
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 #include <Preferences.h>
+#include "page.h"
+#include "net.h"
+#include "cache.h"
+#include "prefetch.h"
+#include "text.h"
+#include "html.h"
+#include "trace.h"
+#include "saved.h"
+#include "find.h"
+#include "local.h"
+#include <SPIFFS.h>
 
 TFT_eSPI tft = TFT_eSPI();
 
-#define SCREEN_W     320
-#define SCREEN_H     240
-#define CHAR_W         8
-#define CHAR_H        16
-#define STAT_H        16
-#define HINT_H        16
-#define CONT_Y        STAT_H
-#define CONT_H        (SCREEN_H - STAT_H - HINT_H)
-#define CONT_ROWS     (CONT_H / CHAR_H)
-#define CONT_COLS     (SCREEN_W / CHAR_W)
-#define HINT_Y        (SCREEN_H - HINT_H)
-
 #define SB_W    300
 #define SB_H     26
 #define SB_X    ((SCREEN_W - SB_W) / 2)
@@ -34,6 +32,7 @@ TFT_eSPI tft = TFT_eSPI();
 #define C_LTGRAY   0x8410
 #define C_DKGRAY   0x4208
 #define C_HIBLUE   0x3800
+#define C_CODEBG   0xE71C
 
 #define KEYBOARD_ADDR  0x55
 #define I2C_SDA        18
@@ -44,33 +43,16 @@ TFT_eSPI tft = TFT_eSPI();
 #define TB_DOWN        15
 #define TB_CLICK        0
 
-#define PSRAM_PAGE_SIZE  (200 * 1024)
-#define MAX_LINES         400
-#define MAX_LINKS          30
-#define LINK_URL_LEN      256
-
-struct LineSpan  { uint32_t start; uint16_t len; };
-struct LinkEntry { char url[LINK_URL_LEN]; };
-
-static char*      g_pageText  = nullptr;
-static size_t     g_pageLen   = 0;
-static LineSpan*  g_lines     = nullptr;
-static int        g_lineCount = 0;
-static LinkEntry* g_links     = nullptr;
-static int        g_linkCount = 0;
-
-#define DDG_LITE_HOST  "lite.duckduckgo.com"
-#define DDG_LITE_PATH  "/lite/"
-#define DDG_LITE_PORT  443
-
+// WIFI_JOIN, SEARCHING and LOADING are network operations in progress:
+// loop() polls them and keeps reading the keys. NOTICE holds a message on
+// screen until a key or its timeout, then goes on to s_noticeNext.
 enum AppState {
     STATE_BOOT, STATE_WIFI_SCAN, STATE_SEARCH_IDLE,
-    STATE_RESULTS, STATE_PAGE_VIEW
+    STATE_RESULTS, STATE_PAGE_VIEW, STATE_SAVED,
+    STATE_WIFI_JOIN, STATE_SEARCHING, STATE_LOADING, STATE_NOTICE
 };
 AppState appState      = STATE_BOOT;
 int      scrollPos     = 0;
-String   currentURL    = "";
-String   baseDomain    = "";
 String   g_searchQuery = "";
 
 String  wifiSSIDs[20];
@@ -79,23 +61,40 @@ int     wifiCount    = 0;
 int     wifiSelected = 0;
 int     wifiScrollOff= 0;
 
-#define HISTORY_MAX 16
-String urlHistory[HISTORY_MAX];
-int    historyCount = 0;
+#define HISTORY_MAX PAGE_CACHE_SLOTS
+// Offsets into s_histPool; the pool is rebuilt from the live entries when
+// pushes after backing out have filled it.
+static StrPool  s_histPool;
+static uint32_t urlHistory[HISTORY_MAX];
+int             historyCount = 0;
+
+static String histAt(int i) { return String(poolAt(s_histPool, urlHistory[i])); }
+
+static void histPush(const String& url) {
+    if (historyCount >= HISTORY_MAX) return;
+    uint32_t off = poolAdd(s_histPool, url.c_str(), url.length());
+    if (off == POOL_NONE) {
+        StrPool fresh = {};
+        for (int i = 0; i < historyCount; i++) {
+            const char* u = poolAt(s_histPool, urlHistory[i]);
+            urlHistory[i] = poolAdd(fresh, u, strlen(u));
+        }
+        poolFree(s_histPool); s_histPool = fresh;
+        off = poolAdd(s_histPool, url.c_str(), url.length());
+    }
+    if (off != POOL_NONE) urlHistory[historyCount++] = off;
+}
 
-#define MAX_RESULTS       100
 #define RESULTS_PER_PAGE    4
 #define ROWS_PER_RESULT     3
+#define LOCAL_RESULTS       4               // pages already read, listed ahead of DDG
 
-struct SearchResult { char title[80]; char url[256]; char snippet[160]; };
-static SearchResult g_results[MAX_RESULTS];
-static int          g_resultCount  = 0;
 static int          g_resultScroll = 0;
 static int          g_resultCursor = 0;
 
-static WiFiClientSecure* g_ssl       = nullptr;
 static unsigned long     lastStatusMs = 0;
 #define STATUS_INTERVAL 3000
+#define PAGE_SCROLL_MS    16
 static Preferences prefs;
 
 static void getBattery(int& pct, bool& charging) {
@@ -114,8 +113,49 @@ static char readKey() {
     return 0;
 }
 
+// Glyph runs: text is rasterised a whole run at a time into one of
+// two line buffers and pushed as a single image (DMA on the panel itself, so
+// the next run rasterises while the last one is still going out).
+static uint16_t s_runBuf[2][SCREEN_W * GLCD_H];
+static int      s_runIdx = 0;
+static bool     s_dmaOK  = false;
+static uint32_t s_runPx  = 0, s_runUs = 0;
+
+static void textRun(TFT_eSPI& g, int x, int y, const char* s, int n, uint16_t fg, uint16_t bg, bool bold = false) {
+    uint32_t t0 = micros();
+    bool dma = s_dmaOK && &g == &tft;
+    if (dma) tft.startWrite();
+    int i = 0;
+    while (i < n) {
+        int cols, k = textRunLen(s + i, n - i, max(0, (g.width() - x) / GLCD_W), cols);
+        if (k > 0 && fg != bg) {
+            uint16_t* buf = s_runBuf[s_runIdx];
+            int w = textRaster(buf, cols * GLCD_W, s + i, k, fg, bg, bold);
+            if (dma) { tft.pushImageDMA(x, y, w, GLCD_H, buf); s_runIdx ^= 1; }
+            else g.pushImage(x, y, w, GLCD_H, buf);
+            x += w; i += k; s_runPx += w * GLCD_H;
+            continue;
+        }
+        g.setTextColor(fg, bg); g.setCursor(x, y); g.print(s[i++]);
+        x = g.getCursorX(); y = g.getCursorY();
+    }
+    if (dma) { tft.dmaWait(); tft.endWrite(); }
+    g.setCursor(x, y);
+    s_runUs += micros() - t0;
+}
+
+// Bytes of s that fit in cols cells, cut on a code point boundary.
+static int fitCols(const char* s, int cols) {
+    int c; return textRunLen(s, (int)strlen(s), cols, c);
+}
+
+static void textRun(int x, int y, const char* s, uint16_t fg, uint16_t bg) {
+    textRun(tft, x, y, s, (int)strlen(s), fg, bg);
+}
+
 static void ptext(int x, int y, const char* s, uint16_t fg, uint16_t bg, int sz = 1) {
     tft.setTextSize(sz);
+    if (sz == 1) { textRun(x, y, s, fg, bg); return; }
     tft.setTextColor(fg, bg);
     tft.setCursor(x, y);
     tft.print(s);
@@ -126,7 +166,14 @@ static void pcenter(int y, const char* s, uint16_t fg, uint16_t bg, int sz = 1)
     ptext((SCREEN_W - w) / 2, y, s, fg, bg, sz);
 }
 
-static void drawStatusBar(const char* label = nullptr) {
+static void drawStatusBar(const char* label = nullptr, bool onlyIfChanged = false) {
+    static char drawn[96] = "";
+    uint32_t freeK = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024;
+    char ram[16]; snprintf(ram, 16, "RAM:%lukb", (unsigned long)freeK);
+    const char* mid = label ? label : currentURL.c_str();
+    char key[96]; snprintf(key, sizeof(key), "%s|%s", ram, mid ? mid : "");
+    if (onlyIfChanged && !strcmp(key, drawn)) return;
+    strlcpy(drawn, key, sizeof(drawn));
 
     tft.fillRect(0, 0, SCREEN_W, STAT_H, C_WHITE);
 
@@ -134,27 +181,20 @@ static void drawStatusBar(const char* label = nullptr) {
 
     tft.setTextSize(1);
 
-    uint32_t freeK = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024;
-    char ram[16]; snprintf(ram, 16, "RAM:%lukb", (unsigned long)freeK);
     int ramX = SCREEN_W - (int)strlen(ram) * CHAR_W - 3;
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor(ramX, 1);
-    tft.print(ram);
+    textRun(ramX, 1, ram, C_DKGRAY, C_WHITE);
 
-    const char* mid = label ? label : currentURL.c_str();
     if (mid && mid[0]) {
         if (strncmp(mid, "https://", 8) == 0) mid += 8;
         else if (strncmp(mid, "http://", 7) == 0) mid += 7;
         int avail = (ramX - 4) / CHAR_W;
         if (avail > 3) {
-            tft.setTextColor(C_DKGRAY, C_WHITE);
-            tft.setCursor(3, 1);
             int len = (int)strlen(mid);
             if (len > avail) {
-                for (int i = 0; i < avail - 2; i++) tft.print(mid[i]);
-                tft.print("..");
+                textRun(tft, 3, 1, mid, avail - 2, C_DKGRAY, C_WHITE);
+                textRun(tft, tft.getCursorX(), 1, "..", 2, C_DKGRAY, C_WHITE);
             } else {
-                tft.print(mid);
+                textRun(tft, 3, 1, mid, len, C_DKGRAY, C_WHITE);
             }
         }
     }
@@ -164,9 +204,7 @@ static void drawHintBar(const char* msg) {
     tft.fillRect(0, HINT_Y, SCREEN_W, HINT_H, C_WHITE);
     tft.drawFastHLine(0, HINT_Y, SCREEN_W, C_LTGRAY);
     tft.setTextSize(1);
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor(3, HINT_Y + 1);
-    tft.print(msg);
+    textRun(3, HINT_Y + 1, msg, C_DKGRAY, C_WHITE);
 }
 
 static void drawBoot(int pct) {
@@ -220,7 +258,7 @@ static void doWifiScan() {
 static void drawWifiList() {
     tft.fillScreen(C_WHITE);
     drawStatusBar("WiFi Setup");
-    drawHintBar("UP/DN=select  ENTER=connect  R=rescan");
+    drawHintBar("UP/DN=select  ENTER=connect  R=rescan  L=saved");
 
     tft.setTextSize(1);
 
@@ -320,58 +358,6 @@ static String enterPassword(const String& ssid) {
     return pw;
 }
 
-static bool connectWifi(const String& ssid, const String& pw) {
-    tft.fillScreen(C_WHITE);
-    drawStatusBar("Connecting...");
-    drawHintBar("Please wait...");
-
-    tft.setTextSize(1);
-
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor(104, CONT_Y + 50);
-    tft.print("Connecting to:");
-
-    String s = ssid.substring(0, 32);
-    int sw = (int)s.length() * CHAR_W;
-    tft.setTextColor(C_BLACK, C_WHITE);
-    tft.setCursor((SCREEN_W - sw) / 2, CONT_Y + 70);
-    tft.print(s);
-
-    WiFi.begin(ssid.c_str(), pw.c_str());
-    int dots = 0, attempts = 0;
-
-    while (WiFi.status() != WL_CONNECTED && attempts < 24) {
-        delay(500);
-        tft.setTextColor(C_BLACK, C_WHITE);
-        tft.setCursor(10 + dots * (CHAR_W + 2), CONT_Y + 100);
-        tft.print('.');
-        dots = (dots + 1) % 38;
-        attempts++;
-    }
-
-    if (WiFi.status() == WL_CONNECTED) {
-        if (!g_ssl) { g_ssl = new WiFiClientSecure(); g_ssl->setInsecure(); }
-
-        tft.setTextColor(C_GREEN, C_WHITE);
-        tft.setCursor(120, CONT_Y + 130);
-        tft.print("Connected!");
-
-        String ip = WiFi.localIP().toString();
-        int ipW = ip.length() * CHAR_W;
-        tft.setTextColor(C_DKGRAY, C_WHITE);
-        tft.setCursor((SCREEN_W - ipW) / 2, CONT_Y + 150);
-        tft.print(ip);
-        delay(1000);
-        return true;
-    }
-
-    tft.setTextColor(C_RED, C_WHITE);
-    tft.setCursor(132, CONT_Y + 130);
-    tft.print("Failed!");
-    delay(2000);
-    return false;
-}
-
 static void saveCredentials(const String& ssid, const String& pw) {
     prefs.begin("wifi", false);
     prefs.putString("ssid", ssid);
@@ -379,46 +365,90 @@ static void saveCredentials(const String& ssid, const String& pw) {
     prefs.end();
 }
 
-static bool loadAndConnect() {
-    prefs.begin("wifi", true);
-    String ssid = prefs.getString("ssid", "");
-    String pw   = prefs.getString("pw",   "");
-    prefs.end();
-    if (ssid.isEmpty()) return false;
+static struct {
+    String        ssid, pw;
+    bool          boot;
+    unsigned long t0, dotAt;
+    int           dots;
+} s_join;
+
+// Manual joins get 12 s and ESC; the one at boot gets 8 s and any key skips
+// it to the network list.
+#define JOIN_MS       12000
+#define JOIN_BOOT_MS   8000
 
+static void joinStart(const String& ssid, const String& pw, bool boot) {
     tft.fillScreen(C_WHITE);
     drawStatusBar("Connecting...");
-    drawHintBar("Press any key to skip");
+    drawHintBar(boot ? "Press any key to skip" : "Please wait...  ESC=cancel");
 
     tft.setTextSize(1);
 
     tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor(88, CONT_Y + 50);
-    tft.print("Reconnecting to:");
+    tft.setCursor(boot ? 88 : 104, CONT_Y + 50);
+    tft.print(boot ? "Reconnecting to:" : "Connecting to:");
+
     String s = ssid.substring(0, 32);
     tft.setTextColor(C_BLACK, C_WHITE);
     tft.setCursor((SCREEN_W - (int)s.length() * CHAR_W) / 2, CONT_Y + 70);
     tft.print(s);
 
+    s_join.ssid = ssid; s_join.pw = pw; s_join.boot = boot;
+    s_join.t0 = s_join.dotAt = millis(); s_join.dots = 0;
     WiFi.begin(ssid.c_str(), pw.c_str());
-    unsigned long t = millis(); int dots = 0;
-    while (WiFi.status() != WL_CONNECTED && millis() - t < 8000) {
-        delay(300);
-        tft.setTextColor(C_BLACK, C_WHITE);
-        tft.setCursor(10 + dots * (CHAR_W + 2), CONT_Y + 100);
-        tft.print('.');
-        dots = (dots + 1) % 38;
-        char k = readKey(); if (k) { WiFi.disconnect(); return false; }
-    }
+    appState = STATE_WIFI_JOIN;
+}
+
+static void showState(AppState st);
+static void notice(AppState next, unsigned long ms);
+
+static void joinPoll(char key) {
+    bool boot = s_join.boot;
     if (WiFi.status() == WL_CONNECTED) {
-        if (!g_ssl) { g_ssl = new WiFiClientSecure(); g_ssl->setInsecure(); }
+        // A new network may answer differently; look all three hosts up again
+        // now, while the user is still typing the first query.
+        netDropAll();
+        dnsFlush();
+        dnsWarm();
         tft.setTextColor(C_GREEN, C_WHITE);
         tft.setCursor(120, CONT_Y + 130);
         tft.print("Connected!");
-        delay(600);
-        return true;
+        if (!boot) {
+            saveCredentials(s_join.ssid, s_join.pw);
+            String ip = WiFi.localIP().toString();
+            tft.setTextColor(C_DKGRAY, C_WHITE);
+            tft.setCursor((SCREEN_W - (int)ip.length() * CHAR_W) / 2, CONT_Y + 150);
+            tft.print(ip);
+        }
+        notice(STATE_SEARCH_IDLE, boot ? 600 : 1000);
+        return;
+    }
+    bool skip = boot ? key != 0 : key == 27;
+    if (skip || millis() - s_join.t0 > (boot ? JOIN_BOOT_MS : JOIN_MS)) {
+        WiFi.disconnect();
+        if (boot) { doWifiScan(); showState(STATE_WIFI_SCAN); return; }
+        if (skip) { showState(STATE_WIFI_SCAN); return; }
+        tft.setTextColor(C_RED, C_WHITE);
+        tft.setCursor(132, CONT_Y + 130);
+        tft.print("Failed!");
+        notice(STATE_WIFI_SCAN, 2000);
+        return;
     }
-    return false;
+    if (millis() - s_join.dotAt >= (boot ? 300u : 500u)) {
+        s_join.dotAt = millis();
+        tft.setTextColor(C_BLACK, C_WHITE);
+        tft.setCursor(10 + s_join.dots * (CHAR_W + 2), CONT_Y + 100);
+        tft.print('.');
+        s_join.dots = (s_join.dots + 1) % 38;
+    }
+}
+
+static bool loadCredentials(String& ssid, String& pw) {
+    prefs.begin("wifi", true);
+    ssid = prefs.getString("ssid", "");
+    pw   = prefs.getString("pw",   "");
+    prefs.end();
+    return !ssid.isEmpty();
 }
 
 static String urlEncodeQuery(const String& q) {
@@ -447,9 +477,7 @@ static void drawSearchBox(int byY, const String& query, bool activeCursor) {
     int start = max(0, qlen - maxVis);
 
     tft.setTextSize(1);
-    tft.setTextColor(C_BLACK, C_WHITE);
-    tft.setCursor(textX, textY);
-    for (int i = start; i < qlen; i++) tft.print(query[i]);
+    textRun(tft, textX, textY, query.c_str() + start, qlen - start, C_BLACK, C_WHITE);
 
     if (activeCursor) {
         int visible = qlen - start;
@@ -459,95 +487,86 @@ static void drawSearchBox(int byY, const String& query, bool activeCursor) {
     }
 }
 
-static bool extractAttrVal(const char* tag, const char* attr, char* out, int outLen) {
-    const char* p = strstr(tag, attr); if (!p) return false;
-    p += strlen(attr);
-    while (*p == ' ' || *p == '=') p++;
-    char q = (*p == '"' || *p == '\'') ? *p++ : 0;
-    int i = 0;
-    while (*p && i < outLen - 1) {
-        if (q && *p == q) break;
-        if (!q && (*p == ' ' || *p == '>')) break;
-        out[i++] = *p++;
-    }
-    out[i] = 0; return i > 0;
-}
-
-static void inlineStrip(char* s) {
-    char *r = s, *w = s; bool intag = false;
-    while (*r) {
-        if (*r == '<') { intag = true;  r++; continue; }
-        if (*r == '>') { intag = false; r++; continue; }
-        if (!intag) {
-            if (*r == '&') {
-                char* semi = strchr(r, ';');
-                if (semi && semi - r < 10) {
-                    char ent[12] = {}; memcpy(ent, r+1, semi-r-1);
-                    char d = 0;
-                    if (!strcmp(ent,"amp"))  d = '&'; else if (!strcmp(ent,"lt"))   d = '<';
-                    else if (!strcmp(ent,"gt"))  d = '>'; else if (!strcmp(ent,"nbsp")) d = ' ';
-                    else if (!strcmp(ent,"quot")) d = '"';
-                    if (d) { *w++ = d; r = semi + 1; continue; }
-                }
-            }
-            *w++ = *r;
-        }
-        r++;
-    }
-    *w = 0;
-    r = s; w = s; bool sp = true;
-    while (*r) {
-        if (*r == '\n' || *r == '\r' || *r == '\t') *r = ' ';
-        if (*r == ' ' && sp) { r++; continue; }
-        sp = (*r == ' '); *w++ = *r++;
-    }
-    if (w > s && *(w-1) == ' ') w--;
-    *w = 0;
-}
-
-static void parseDDGLite(const String& html) {
-
-    const char* p = html.c_str();
-    const int   n = (int)html.length();
-    while (g_resultCount < MAX_RESULTS) {
-        const char* anchor = strstr(p, "result-link"); if (!anchor) break;
-        const char* aStart = anchor;
-        while (aStart > p && *aStart != '<') aStart--;
-        if (*aStart != '<') { p = anchor + 11; continue; }
-        const char* aTagEnd = strchr(aStart, '>'); if (!aTagEnd) break;
-        char href[256] = {};
-        { char tb[512] = {}; int tl = min((int)(aTagEnd - aStart), 510); memcpy(tb, aStart, tl);
-          if (!extractAttrVal(tb, "href", href, sizeof(href))) { p = aTagEnd + 1; continue; } }
-        if (strncmp(href, "http", 4) != 0) { p = aTagEnd + 1; continue; }
-        const char* ts = aTagEnd + 1;
-        const char* te = strstr(ts, "</a>");
-        char title[80] = {};
-        if (te) { int tl = min((int)(te - ts), 78); memcpy(title, ts, tl); inlineStrip(title); }
-        if (!title[0]) strcpy(title, "(no title)");
-        char snippet[160] = {};
-        const char* st = te ? strstr(te, "result-snippet") : nullptr;
-        if (st) {
-            const char* ss2 = strchr(st, '>');
-            if (ss2++) {
-                const char* se = strstr(ss2, "</td>"); if (!se) se = strstr(ss2, "</span>");
-                if (se) { int sl = min((int)(se - ss2), 158); memcpy(snippet, ss2, sl); inlineStrip(snippet); }
-            }
-        }
-        SearchResult& sr = g_results[g_resultCount++];
-        strlcpy(sr.title,   title,   sizeof(sr.title));
-        strlcpy(sr.url,     href,    sizeof(sr.url));
-        strlcpy(sr.snippet, snippet, sizeof(sr.snippet));
-        p = te ? te + 4 : aTagEnd + 1;
-        if (p - html.c_str() >= n) break;
+static void drawResults();
+
+static size_t s_searchBytes  = 0;
+static bool   s_resultsShown = false;
+static int    s_resultsDrawn = 0;
+static int    s_localHits    = 0;        // results from the local index, ahead of DDG's
+
+// Results so far, while DDG is still sending; redrawn as the first screen
+// fills.
+static void drawPartialResults() {
+    drawResults(); drawHintBar("Searching DuckDuckGo...  ESC=stop");
+    s_resultsShown = true; s_resultsDrawn = g_resultCount;
+}
+
+static bool searchSink(const uint8_t* p, size_t n) {
+    if (!s_searchBytes && !s_resultsShown) {
+        tft.fillRect(0, CONT_Y + 90, SCREEN_W, CHAR_H, C_WHITE);
+        tft.setTextColor(C_DKGRAY, C_WHITE);
+        tft.setCursor((SCREEN_W - 14 * CHAR_W) / 2, CONT_Y + 90);
+        tft.print("Downloading...");
     }
+    ddgFeed((const char*)p, n); s_searchBytes += n;
+    if ((s_resultsShown || g_resultCount >= RESULTS_PER_PAGE) && s_resultsDrawn < min(g_resultCount, RESULTS_PER_PAGE))
+        drawPartialResults();
+    return true;
+}
+
+// Search and page loads share one connection state machine; only one runs at
+// a time.
+static HttpFetch s_fetch;
+
+static String ddgRequest(const String& body) {
+    return String("POST ") + DDG_LITE_PATH + " HTTP/1.1\r\n"
+           "Host: " DDG_LITE_HOST "\r\n"
+           "Content-Type: application/x-www-form-urlencoded\r\n"
+           "Content-Length: " + String(body.length()) + "\r\n"
+           "User-Agent: Mozilla/5.0 (compatible; CanuckWeb/1.00)\r\n"
+           "Accept: text/html\r\n"
+           "Connection: keep-alive\r\n\r\n" + body;
+}
+
+// The next DDG Lite page is fetched behind the list once the cursor nears
+// its end, on s_fetch; whatever else needs s_fetch stops it first.
+static bool s_moreBusy = false;
+
+static bool moreSink(const uint8_t* p, size_t n) {
+    int before = g_resultCount;
+    ddgFeed((const char*)p, n);
+    if (appState == STATE_RESULTS && g_resultCount > before && before < g_resultScroll + RESULTS_PER_PAGE) drawResults();
+    return true;
 }
 
-static int doSearch(const String& query) {
+static void moreStart() {
+    if (s_moreBusy || !*ddgNext() || g_resultCount >= MAX_RESULTS || g_resultCursor < g_resultCount - 2 * RESULTS_PER_PAGE)
+        return;
+    String req = ddgRequest(ddgNext());
+    ddgInit();
+    fetchBegin(s_fetch, DDG_LITE_HOST, DDG_LITE_PORT, req, moreSink, 15000);
+    s_moreBusy = true;
+}
+
+static void moreStop() { if (s_moreBusy) { fetchAbort(s_fetch); s_moreBusy = false; } }
+
+static void drawResultsNav();
+
+static void morePoll() {
+    if (!s_moreBusy || fetchPoll(s_fetch) < FETCH_DONE) return;
+    s_moreBusy = false;
+    ddgFinish();
+    if (appState == STATE_RESULTS) drawResultsNav();
+}
+
+static void searchStart(const String& query) {
+    traceStart('S', query.c_str());
+    prefetchCancel(); moreStop();
     g_resultCount = 0; g_resultScroll = 0; g_resultCursor = 0;
 
     tft.fillScreen(C_WHITE);
     drawStatusBar("Searching...");
-    drawHintBar("Please wait...");
+    drawHintBar("Please wait...  ESC=cancel");
     tft.setTextSize(1);
     tft.setTextColor(C_DKGRAY, C_WHITE);
     tft.setCursor(68, CONT_Y + 50);
@@ -557,70 +576,48 @@ static int doSearch(const String& query) {
     tft.setCursor((SCREEN_W - (int)dq.length() * CHAR_W) / 2, CONT_Y + 70);
     tft.print(dq);
 
-    String body = "q=" + urlEncodeQuery(query);
-    String req  = String("POST ") + DDG_LITE_PATH + " HTTP/1.0\r\n"
-                  "Host: " DDG_LITE_HOST "\r\n"
-                  "Content-Type: application/x-www-form-urlencoded\r\n"
-                  "Content-Length: " + String(body.length()) + "\r\n"
-                  "User-Agent: Mozilla/5.0 (compatible; CanuckWeb/1.00)\r\n"
-                  "Accept: text/html\r\n"
-                  "Connection: close\r\n\r\n" + body;
-
-    if (!g_ssl) { g_ssl = new WiFiClientSecure(); g_ssl->setInsecure(); }
+    String req = ddgRequest("q=" + urlEncodeQuery(query));
 
     tft.setTextColor(C_DKGRAY, C_WHITE);
     tft.setCursor((SCREEN_W - 13 * CHAR_W) / 2, CONT_Y + 90);
     tft.print("Connecting...");
 
-    if (!g_ssl->connect(DDG_LITE_HOST, DDG_LITE_PORT)) {
-        tft.setTextColor(C_RED, C_WHITE);
-        tft.setCursor((SCREEN_W - 16 * CHAR_W) / 2, CONT_Y + 110);
-        tft.print("Connection failed");
-        delay(3000); return 0;
-    }
-    g_ssl->print(req);
-
-    unsigned long t0 = millis();
-    String response; response.reserve(30000);
-    bool headersDone = false; String headerBuf;
-
-    while (millis() - t0 < 15000) {
-        if (g_ssl->available()) {
-            char c = (char)g_ssl->read();
-            if (!headersDone) {
-                headerBuf += c;
-                if (headerBuf.endsWith("\r\n\r\n")) {
-                    headersDone = true;
-                    if (headerBuf.indexOf("200") < 0) { g_ssl->stop(); delay(3000); return 0; }
-                    tft.fillRect(0, CONT_Y + 90, SCREEN_W, CHAR_H, C_WHITE);
-                    tft.setTextColor(C_DKGRAY, C_WHITE);
-                    tft.setCursor((SCREEN_W - 14 * CHAR_W) / 2, CONT_Y + 90);
-                    tft.print("Downloading...");
-                }
-            } else {
-                response += c;
-            }
-        } else if (!g_ssl->connected()) break;
-        else delay(2);
-    }
-    g_ssl->stop();
-
-    if (!headersDone || response.length() < 100) {
-        tft.setTextColor(C_RED, C_WHITE);
-        tft.setCursor((SCREEN_W - 15 * CHAR_W) / 2, CONT_Y + 110);
-        tft.print("No data received");
-        delay(3000); return 0;
-    }
+    // Pages read before answer at once; DDG's results follow them in.
+    LocalHit hits[LOCAL_RESULTS];
+    int n = s_localHits = localQuery(query.c_str(), hits, LOCAL_RESULTS);
+    for (int i = 0; i < n; i++)
+        resultAdd(*hits[i].title ? hits[i].title : hits[i].url, hits[i].url,
+                  savedHas(hits[i].url) ? "Saved for offline reading" : "Read earlier");
+    ddgInit(); s_searchBytes = 0; s_resultsShown = false; s_resultsDrawn = 0;
+    if (n) drawPartialResults();
+    fetchBegin(s_fetch, DDG_LITE_HOST, DDG_LITE_PORT, req, searchSink, 15000);
+    appState = STATE_SEARCHING;
+}
 
-    parseDDGLite(response);
+static void searchFail(const char* msg) {
+    tft.setTextColor(C_RED, C_WHITE);
+    tft.setCursor((SCREEN_W - (int)strlen(msg) * CHAR_W) / 2, CONT_Y + 110);
+    tft.print(msg);
+    notice(STATE_RESULTS, 3000);
+}
 
-    tft.fillRect(0, CONT_Y + 110, SCREEN_W, CHAR_H, C_WHITE);
-    char found[24]; snprintf(found, 24, "Found: %d results", g_resultCount);
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor((SCREEN_W - (int)strlen(found) * CHAR_W) / 2, CONT_Y + 110);
-    tft.print(found);
-    delay(400);
-    return g_resultCount;
+// ESC stops the search; results already on screen stay.
+static void searchPoll(char key) {
+    if (key == 27) {
+        fetchAbort(s_fetch); traceNote(-2, s_searchBytes);
+        if (!s_resultsShown) { g_resultCount = 0; showState(STATE_SEARCH_IDLE); return; }
+    } else if (fetchPoll(s_fetch) < FETCH_DONE) return;
+    int code = s_fetch.result;
+    if (key != 27) traceNote(code, s_searchBytes);
+    if (code == -1) { searchFail("Connection failed"); return; }
+    if (code > 0 && code != 200) {
+        char msg[20]; snprintf(msg, sizeof(msg), "HTTP %d", code);
+        searchFail(msg); return;
+    }
+    ddgFinish();
+    if (!s_resultsShown && s_searchBytes < 100) { searchFail("No data received"); return; }
+    if (g_resultCount > s_localHits) prefetchStart(s_localHits);
+    showState(STATE_RESULTS);
 }
 
 static void drawIdleScreen() {
@@ -638,9 +635,10 @@ static void drawIdleScreen() {
 }
 
 static void drawResults() {
+    TraceScope t(TR_DRAW);
     tft.fillScreen(C_WHITE);
     drawStatusBar("Results");
-    drawHintBar("BALL=select  CLICK/ENTER=open  S=search");
+    drawHintBar("BALL=select  CLICK/ENTER=open  S=search  L=saved");
 
     int boxY = CONT_Y + 4;
     drawSearchBox(boxY, g_searchQuery, false);
@@ -661,51 +659,44 @@ static void drawResults() {
     int visible = min(RESULTS_PER_PAGE, g_resultCount - g_resultScroll);
     for (int i = 0; i < visible; i++) {
         int idx  = g_resultScroll + i;
-        auto& r  = g_results[idx];
+        SearchResult r = resultAt(idx);
         bool hi  = (idx == g_resultCursor);
         int yTop = startY + i * (blockH + 2);
 
-        if (hi) {
-            tft.fillRect(0, yTop, SCREEN_W, CHAR_H, C_BLUE);
-            tft.setTextColor(C_WHITE, C_BLUE);
-        } else {
-            tft.fillRect(0, yTop, SCREEN_W, CHAR_H, C_WHITE);
-            tft.setTextColor(C_BLACK, C_WHITE);
-        }
+        uint16_t fg = hi ? C_WHITE : C_BLACK, bg = hi ? C_BLUE : C_WHITE;
+        tft.fillRect(0, yTop, SCREEN_W, CHAR_H, bg);
         tft.setTextSize(1);
-        tft.setCursor(6, yTop + 1);
 
         int tmax = CONT_COLS - 4;
-        for (int c = 0; c < tmax && r.title[c]; c++) tft.print(r.title[c]);
+        textRun(tft, 6, yTop + 1, r.title, fitCols(r.title, tmax), fg, bg);
 
         char badge[5]; snprintf(badge, 5, "#%d", idx + 1);
-        tft.setCursor(SCREEN_W - (int)strlen(badge) * CHAR_W - 4, yTop + 1);
-        tft.print(badge);
+        textRun(SCREEN_W - (int)strlen(badge) * CHAR_W - 4, yTop + 1, badge, fg, bg);
 
         tft.fillRect(0, yTop + CHAR_H, SCREEN_W, CHAR_H, C_WHITE);
-        tft.setTextColor(C_DKGRAY, C_WHITE);
-        tft.setCursor(6, yTop + CHAR_H + 1);
         const char* u = r.url;
         if (strncmp(u, "https://", 8) == 0) u += 8;
         else if (strncmp(u, "http://", 7) == 0) u += 7;
-        for (int c = 0; c < CONT_COLS - 1 && u[c]; c++) tft.print(u[c]);
+        textRun(tft, 6, yTop + CHAR_H + 1, u, (int)strnlen(u, CONT_COLS - 1), C_DKGRAY, C_WHITE);
 
         tft.fillRect(0, yTop + CHAR_H * 2, SCREEN_W, CHAR_H, C_WHITE);
-        tft.setTextColor(C_LTGRAY, C_WHITE);
-        tft.setCursor(6, yTop + CHAR_H * 2 + 1);
-        for (int c = 0; c < CONT_COLS - 1 && r.snippet[c]; c++) tft.print(r.snippet[c]);
+        textRun(tft, 6, yTop + CHAR_H * 2 + 1, r.snippet, fitCols(r.snippet, CONT_COLS - 1), C_LTGRAY, C_WHITE);
 
         tft.drawFastHLine(0, yTop + blockH + 1, SCREEN_W, C_LTGRAY);
     }
+    drawResultsNav();
+}
 
+// "5-8 / 60", redrawn alone as more results come in behind the list.
+static void drawResultsNav() {
+    if (g_resultCount == 0) return;
     char nav[20];
     snprintf(nav, 20, "%d-%d / %d",
              g_resultScroll + 1,
              min(g_resultScroll + RESULTS_PER_PAGE, g_resultCount),
              g_resultCount);
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor(SCREEN_W - (int)strlen(nav) * CHAR_W - 4, HINT_Y - CHAR_H - 1);
-    tft.print(nav);
+    tft.fillRect(SCREEN_W - 20 * CHAR_W - 4, HINT_Y - CHAR_H - 1, 20 * CHAR_W, CHAR_H, C_WHITE);
+    textRun(SCREEN_W - (int)strlen(nav) * CHAR_W - 4, HINT_Y - CHAR_H - 1, nav, C_DKGRAY, C_WHITE);
 }
 
 static String enterText(const char* ttl, const char* hint, const char* placeholder) {
@@ -714,13 +705,8 @@ static String enterText(const char* ttl, const char* hint, const char* placehold
     drawHintBar(hint);
 
     tft.setTextSize(1);
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor((SCREEN_W - (int)strlen(ttl) * CHAR_W) / 2, CONT_Y + 20);
-    tft.print(ttl);
-
-    tft.setTextColor(C_LTGRAY, C_WHITE);
-    tft.setCursor((SCREEN_W - (int)strlen(placeholder) * CHAR_W) / 2, CONT_Y + 40);
-    tft.print(placeholder);
+    textRun((SCREEN_W - (int)strlen(ttl) * CHAR_W) / 2, CONT_Y + 20, ttl, C_DKGRAY, C_WHITE);
+    textRun((SCREEN_W - (int)strlen(placeholder) * CHAR_W) / 2, CONT_Y + 40, placeholder, C_LTGRAY, C_WHITE);
 
     int boxY = CONT_Y + 70;
     tft.drawRect(SB_X,   boxY,   SB_W,   SB_H,   C_ORANGE);
@@ -735,378 +721,714 @@ static String enterText(const char* ttl, const char* hint, const char* placehold
         if ((k == 8 || k == 127) && text.length() > 0) {
             text.remove(text.length() - 1);
             tft.fillRect(SB_X+2, boxY+2, SB_W-4, SB_H-4, C_WHITE);
-            tft.setTextColor(C_BLACK, C_WHITE);
-            tft.setCursor(SB_X + 6, boxY + 5);
-            for (int i = 0; i < (int)text.length(); i++) tft.print(text[i]);
+            textRun(SB_X + 6, boxY + 5, text.c_str(), C_BLACK, C_WHITE);
         } else if (k >= 32 && k < 127) {
             text += (char)k;
-            tft.setTextColor(C_BLACK, C_WHITE);
             int cx = SB_X + 6 + (int)(text.length() - 1) * CHAR_W;
-            if (cx + CHAR_W < SB_X + SB_W - 4) {
-                tft.setCursor(cx, boxY + 5);
-                tft.print(text[text.length() - 1]);
-            }
+            if (cx + CHAR_W < SB_X + SB_W - 4)
+                textRun(tft, cx, boxY + 5, text.c_str() + text.length() - 1, 1, C_BLACK, C_WHITE);
         }
         delay(40);
     }
     return text;
 }
 
-enum StripState { SS_TEXT, SS_TAG, SS_SCRIPT, SS_STYLE, SS_HEAD, SS_COMMENT };
-static StripState ss_state = SS_TEXT; static char ss_tagBuf[128]; static int ss_tagPos = 0;
-static bool ss_inAnchor = false; static char entBuf[16]; static int entLen = 0;
-static bool inEntity = false; static int ss_dashCount = 0;
+static void displayPage();
+static void drawPageBody();
+static void drawScrollBar(TFT_eSPI& g, int y0);
+
+static TFT_eSprite pageSpr     = TFT_eSprite(&tft);
+static bool        s_sprOK     = false;
+static int         s_sprScroll = -1;
+static int         s_findIdx   = -1;       // the hit on show, -1 with no find open
+static int         s_findCount = 0;
+static int         s_linkTop   = 0;        // links with a label on screen: [s_linkTop, s_linkEnd)
+static int         s_linkEnd   = 0;
+static int         s_linkFocus = -1;       // the link the trackball picked, -1 for none
+static int         s_hintKeys  = -1;       // links the hint bar offers keys for
+#define LINK_KEYS  9                       // links on screen numbered for keys 1-9
+
+static size_t s_glyphBytes = 0;            // the smooth font loaded at boot, 0 with none
+
+// Progressive page view: the first screen goes up once CONT_ROWS lines are
+// wrapped and the blocked-page check has a full window to look at; after
+// that the trackball scrolls whatever has arrived while the body keeps
+// coming, and ESC stops the load there.
+#define PROGRESSIVE_MIN_BYTES 2048
+#define CDX_MAX               4096
+
+// A page load runs cache -> prefetch -> r.jina.ai; a block page from the
+// prefetch goes to the Wayback leg alone. If Jina has no unblocked screen up
+// after HEDGE_DELAY_MS, or ends without a usable page, the Wayback leg starts
+// alongside it: the availability API, then the snapshot through Jina on the
+// second pooled connection, spooled in PSRAM (up to HEDGE_BUDGET bytes) while
+// the live page still holds the stripper. The first acceptable body wins and
+// the other fetch is aborted. The live leg wins as soon as it has an
+// unblocked screen up; a spooled snapshot that completes first wins outright,
+// as judging it means stripping it over the live page.
+#define HEDGE_DELAY_MS        4000
+#define HEDGE_BUDGET          (256 * 1024)
+
+enum LoadStep  { LOAD_PREFETCH, LOAD_RACE };
+enum LegState  { LEG_IDLE, LEG_CDX, LEG_PAGE, LEG_WON, LEG_LOST };
+enum HistoryOp { HIST_NONE, HIST_PUSH, HIST_RESET };
+
+static struct {
+    String        url, prevURL;
+    AppState      from;
+    HistoryOp     hist;
+    LoadStep      step;
+    LegState      live, wayback;
+    bool          spooled;               // the Wayback body is going to the spool
+    bool          streaming;             // some leg has the stripper
+    unsigned long t0;
+} s_load;
+static HttpFetch s_hedge;
+
+static unsigned long s_fetchStart = 0, s_ttfl = 0;
+static int           s_httpCode   = 0;
+static bool          s_pageShown  = false;
+static bool          s_pvUp = HIGH, s_pvDn = HIGH;
+static int           s_pvLines = 0;
+static char          s_cdx[CDX_MAX + 1];
+static size_t        s_cdxLen = 0;
+
+static bool pageTap(const uint8_t*, size_t) {
+    // A block page stops its body here, and the Wayback leg starts.
+    if (pageBlockHit()) return false;
+    if (s_pageShown || g_lineCount < CONT_ROWS || g_pageLen < PROGRESSIVE_MIN_BYTES || pageIsBlocked()) return true;
+    s_pageShown = true; s_ttfl = millis() - s_fetchStart; scrollPos = 0;
+    s_pvUp = s_pvDn = HIGH; s_pvLines = g_lineCount;
+    displayPage(); drawHintBar("Loading...  BALL=scroll  ESC=stop");
+    return true;
+}
+
+static void fetchStatus(const char* line1, const char* line2 = nullptr) {
+
+    tft.setTextSize(1);
+    tft.fillRect(0, CONT_Y+60, SCREEN_W, CHAR_H*2+4, C_WHITE);
+    if (line1) textRun((SCREEN_W-(int)strlen(line1)*CHAR_W)/2, CONT_Y+60, line1, C_DKGRAY, C_WHITE);
+    if (line2) {
+        int l2 = min((int)strlen(line2), CONT_COLS);
+        textRun(tft, (SCREEN_W - l2*CHAR_W)/2, CONT_Y+78, line2, l2, C_LTGRAY, C_WHITE);
+    }
+}
+
+static void loadScreen(const String& url) {
+    tft.fillScreen(C_WHITE);
+    drawStatusBar("Loading...");
+    drawHintBar("Please wait...  ESC=cancel");
+    tft.setTextSize(1);
+
+    tft.setTextColor(C_BLACK, C_WHITE);
+    tft.setCursor((SCREEN_W-12*CHAR_W)/2, CONT_Y+30);
+    tft.print("Loading page");
+
+    String disp=url; if(disp.startsWith("https://")) disp=disp.substring(8);
+    if((int)disp.length()>CONT_COLS) disp=disp.substring(0,CONT_COLS-3)+"...";
+    tft.setTextColor(C_DKGRAY, C_WHITE);
+    tft.setCursor((SCREEN_W-(int)disp.length()*CHAR_W)/2, CONT_Y+48);
+    tft.print(disp);
+}
+
+static BodySink jinaHead(const HttpHead& h) {
+    s_load.streaming=true;
+    return streamBegin(pageTap,h.coding,FORMAT_MARKDOWN);
+}
 
-static void stripInit() {
-    ss_state = SS_TEXT; ss_tagPos = 0; ss_inAnchor = false;
-    inEntity = false; entLen = 0; ss_dashCount = 0;
-    memset(ss_tagBuf, 0, sizeof(ss_tagBuf)); g_pageLen = 0; g_linkCount = 0;
+// The snapshot goes straight to the stripper once the live leg is out.
+static BodySink archiveHead(const HttpHead& h) {
+    s_load.spooled=s_load.live!=LEG_LOST;
+    if (!s_load.spooled) return jinaHead(h);
+    spoolBegin(HEDGE_BUDGET,h.coding);
+    return spoolSink;
 }
-static void sw(char c) { if (g_pageLen < PSRAM_PAGE_SIZE-2) g_pageText[g_pageLen++] = c; }
-static void sws(const char* s) { while (*s) sw(*s++); }
 
-static char decodeEnt(const char* e, int len) {
-    if (len < 3) return ' ';
-    char inner[16] = {}; int cl = min(len-2, 14); memcpy(inner, e+1, cl);
-    if (!strcmp(inner,"amp"))   return '&'; if (!strcmp(inner,"nbsp")) return ' ';
-    if (!strcmp(inner,"lt"))    return '<'; if (!strcmp(inner,"gt"))   return '>';
-    if (!strcmp(inner,"quot"))  return '"'; if (!strcmp(inner,"apos")) return '\'';
-    if (!strcmp(inner,"mdash")) return '-'; if (!strcmp(inner,"ndash")) return '-';
-    if (!strcmp(inner,"hellip")) return '.';
-    if (inner[0] == '#') { int c2 = atoi(inner+1); if (c2>=32&&c2<128) return (char)c2; }
-    return ' ';
+static void jinaStart() {
+    moreStop();
+    s_load.step=LOAD_RACE; s_load.live=LEG_PAGE; s_load.wayback=LEG_IDLE; s_load.streaming=false; s_load.t0=millis();
+    fetchStatus("via r.jina.ai...");
+    fetchBegin(s_fetch,JINA_HOST,JINA_PORT,jinaRequest(s_load.url),nullptr,30000);
+    s_fetch.onHead=jinaHead;
 }
 
-static bool isBlockTag(const char* n) {
-    return (!strcmp(n,"p")||!strcmp(n,"div")||!strcmp(n,"br")||!strcmp(n,"h1")||
-            !strcmp(n,"h2")||!strcmp(n,"h3")||!strcmp(n,"h4")||!strcmp(n,"li")||
-            !strcmp(n,"tr")||!strcmp(n,"td")||!strcmp(n,"th")||!strcmp(n,"article")||
-            !strcmp(n,"section")||!strcmp(n,"header")||!strcmp(n,"footer")||
-            !strcmp(n,"nav")||!strcmp(n,"main"));
+static bool cdxSink(const uint8_t* p, size_t n) {
+    if (s_cdxLen+n>CDX_MAX) return false;
+    memcpy(s_cdx+s_cdxLen,p,n); s_cdxLen+=n; s_cdx[s_cdxLen]=0; return true;
 }
 
-static bool extractHref(const char* tag, char* out, int outLen) {
-    const char* p = strstr(tag, "href"); if (!p) return false; p += 4;
-    while (*p == ' ' || *p == '=') p++;
-    char quote = (*p == '"' || *p == '\'') ? *p++ : 0;
-    int i = 0;
-    while (*p && i < outLen-1) {
-        if (quote && *p == quote) break;
-        if (!quote && (*p == ' ' || *p == '>')) break;
-        out[i++] = *p++;
+static void cdxStart() {
+    fetchStatus(s_load.live==LEG_LOST ? "Trying Wayback Machine..." : "via r.jina.ai + Wayback...");
+    s_load.wayback=LEG_CDX; s_load.spooled=false; s_cdxLen=0; s_cdx[0]=0;
+    String req=String("GET /wayback/available?url=")+s_load.url+" HTTP/1.1\r\n"
+               "Host: " WAYBACK_HOST "\r\n"
+               "User-Agent: " HTTP_USER_AGENT "\r\n"
+               "Connection: keep-alive\r\n\r\n";
+    fetchBegin(s_hedge,WAYBACK_HOST,WAYBACK_PORT,req,cdxSink,10000);
+    s_hedge.traced=false;
+}
+
+static void legsAbort() {
+    if (s_load.step!=LOAD_RACE) return;
+    if (s_load.live==LEG_PAGE) fetchAbort(s_fetch);
+    if (s_load.wayback==LEG_CDX||s_load.wayback==LEG_PAGE) fetchAbort(s_hedge);
+    spoolFree();
+}
+
+static void pageShow(HistoryOp hist, const String& url) {
+    if (hist==HIST_RESET) { historyCount=0; poolReset(s_histPool); }
+    if (hist!=HIST_NONE) histPush(url);
+    showState(STATE_PAGE_VIEW);
+}
+
+// Internal heap: free KB, and the share of it outside the largest free block.
+// Logged either side of a page load to watch fragmentation.
+struct HeapMark { uint32_t freeK, fragPct; };
+static HeapMark s_heapAtOpen;
+
+static HeapMark heapMark() {
+    size_t fr = heap_caps_get_free_size(MALLOC_CAP_INTERNAL), big = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    return { (uint32_t)(fr / 1024), fr ? (uint32_t)(100 - big * 100 / fr) : 0 };
+}
+
+// complete is false when the body stopped short (ESC on a page already on
+// screen, an idle timeout, a short read): what arrived is kept and shown, but
+// not cached or indexed.
+static void loadDone(bool complete) {
+    prefetchPause(false);
+    if (s_load.step==LOAD_RACE) traceVia(s_load.live==LEG_WON ? 'j' : s_load.wayback==LEG_WON ? 'w' : '-');
+    traceNote(s_httpCode,g_pageLen);
+    { TraceScope t(TR_LINES); lineFeed(true); }
+    pageTrim(); if (complete) { cacheStore(s_load.url); localAdd(s_load.url); }
+    if (!s_pageShown) { scrollPos=0; s_ttfl=millis()-s_fetchStart; }
+    HeapMark hm=heapMark();
+    Serial.printf("page: ttfl=%lums total=%lums %u bytes %d lines %d links%s%s, store %u KB, links %u KB, "
+                  "heap %luKB/%lu%% frag -> %luKB/%lu%%\n", s_ttfl, millis()-s_fetchStart,
+                  (unsigned)g_pageLen, g_lineCount, g_linkCount, s_pageShown ? " progressive" : "", complete ? "" : " partial",
+                  (unsigned)(pageMemBytes() / 1024), (unsigned)(linkMemBytes() / 1024),
+                  (unsigned long)s_heapAtOpen.freeK, (unsigned long)s_heapAtOpen.fragPct, (unsigned long)hm.freeK, (unsigned long)hm.fragPct);
+    pageShow(s_load.hist,s_load.url);
+}
+
+// Back to the previous page and screen; with a reason, after showing it.
+static void loadFail(const char* why) {
+    prefetchPause(false);
+    traceNote(s_httpCode,g_pageLen);
+    if (why) fetchStatus("Page unavailable",why);
+    if (!s_load.prevURL.isEmpty()&&(cacheLoad(s_load.prevURL)||savedLoad(s_load.prevURL))) { currentURL=s_load.prevURL; updateBaseDomain(s_load.prevURL); }
+    pageTrim(); s_sprScroll=-1;
+    if (why) notice(s_load.from,3000); else showState(s_load.from);
+}
+
+static void pageOpen(const String& url, HistoryOp hist, bool useCache = true) {
+    traceStart('P', url.startsWith("https://") ? url.c_str() + 8 : url.c_str());
+    s_load.prevURL=currentURL; s_load.url=url; s_load.hist=hist; s_load.from=appState;
+    s_findIdx=-1; s_linkFocus=-1; s_heapAtOpen=heapMark();
+    currentURL=url; updateBaseDomain(url);
+    bool hit;
+    { TraceScope t(TR_CACHE); hit=useCache&&(cacheLoad(url)||savedLoad(url)); }
+    if (hit) { pageTrim(); scrollPos=0; s_sprScroll=-1; traceNote(0,g_pageLen); pageShow(hist,url); return; }
+    s_fetchStart=millis(); s_ttfl=0; s_pageShown=false; s_sprScroll=-1; s_httpCode=0;
+    loadScreen(url);
+    appState=STATE_LOADING;
+    s_load.t0=millis();
+    if (useCache) { s_load.step=LOAD_PREFETCH; return; }
+    prefetchPause(true);
+    jinaStart();
+}
+
+static void waybackLose(const char* why);
+
+// The live leg, polled first each time round.
+static void livePoll() {
+    if (fetchPoll(s_fetch)<FETCH_DONE) {
+        if (s_pageShown&&(s_load.wayback==LEG_CDX||s_load.wayback==LEG_PAGE)) { fetchAbort(s_hedge); spoolFree(); s_load.wayback=LEG_LOST; }
+        else if (!s_pageShown&&s_load.wayback==LEG_IDLE&&millis()-s_load.t0>=HEDGE_DELAY_MS) cdxStart();
+        return;
     }
-    out[i] = 0; return i > 0;
-}
-
-static String resolveURL(const char* href) {
-    String h(href);
-    if (h.startsWith("http://") || h.startsWith("https://")) return h;
-    if (h.startsWith("//")) return "https:" + h;
-    if (h.startsWith("/"))  return baseDomain + h;
-    if (h.startsWith("#"))  return currentURL;
-    return baseDomain + "/" + h;
-}
-
-static void stripFeed(char c) {
-    switch (ss_state) {
-        case SS_SCRIPT:
-            if (c=='<') ss_tagPos=0;
-            else if (ss_tagPos==0&&c=='/') ss_tagPos=1;
-            else if (ss_tagPos==1) { ss_tagBuf[0]=c; ss_tagBuf[1]=0; if(tolower(c)=='s') ss_tagPos=2; else ss_tagPos=0; }
-            else if (ss_tagPos>=2&&ss_tagPos<8) {
-                ss_tagBuf[ss_tagPos-1]=c; ss_tagBuf[ss_tagPos]=0;
-                if (tolower(c)=='>') { ss_state=SS_TEXT; ss_tagPos=0; }
-                else if (!strncasecmp(ss_tagBuf,"script",ss_tagPos-1)) ss_tagPos++;
-                else ss_tagPos=0;
+    s_httpCode=s_fetch.result;
+    bool ok=s_load.streaming&&streamEnd()&&s_fetch.result==200&&g_pageLen>20&&!pageIsBlocked();
+    s_load.streaming=false;
+    if (ok) {
+        if (s_load.wayback==LEG_CDX||s_load.wayback==LEG_PAGE) fetchAbort(s_hedge);
+        spoolFree(); s_load.live=LEG_WON; loadDone(s_fetch.complete);
+        return;
+    }
+    s_load.live=LEG_LOST;
+    char codeStr[20]; snprintf(codeStr,20,"HTTP %d",s_fetch.result);
+    if (s_pageShown) { s_pageShown=false; loadScreen(s_load.url); }
+    if (s_load.wayback==LEG_IDLE) { cdxStart(); return; }
+    if (s_load.wayback==LEG_LOST) { loadFail(codeStr); return; }
+    fetchStatus("via Wayback + Jina...",codeStr);
+    // Its body so far comes out of the spool; the rest streams.
+    if (s_load.wayback==LEG_PAGE&&s_load.spooled) {
+        s_load.spooled=false; s_load.streaming=true;
+        if (!spoolDrain(pageTap,FORMAT_MARKDOWN)) { fetchAbort(s_hedge); waybackLose("Wayback unreadable"); }
+    }
+}
+
+static void waybackLose(const char* why) {
+    if (s_load.live==LEG_LOST&&s_load.streaming) { streamEnd(); s_load.streaming=false; }
+    spoolFree(); s_load.wayback=LEG_LOST;
+    if (s_load.live==LEG_LOST) loadFail(why);
+}
+
+static void waybackPoll() {
+    if (s_load.wayback!=LEG_CDX&&s_load.wayback!=LEG_PAGE) return;
+    if (fetchPoll(s_hedge)<FETCH_DONE) return;
+    if (s_load.wayback==LEG_CDX) {
+        if (s_hedge.result!=200) { if (s_load.live==LEG_LOST) s_httpCode=s_hedge.result; waybackLose("Wayback unavailable"); return; }
+        String cdx=s_cdx;
+        int urlIdx=cdx.indexOf("\"url\":\""); if (urlIdx<0) { waybackLose("Not in Wayback"); return; }
+        urlIdx+=7; int urlEnd=cdx.indexOf('"',urlIdx); if (urlEnd<0) { waybackLose("Not in Wayback"); return; }
+        String archiveURL=cdx.substring(urlIdx,urlEnd); archiveURL.replace("\\/","/");
+        s_load.wayback=LEG_PAGE;
+        fetchBegin(s_hedge,JINA_HOST,JINA_PORT,jinaRequest(archiveURL),nullptr,30000);
+        s_hedge.onHead=archiveHead; s_hedge.traced=false;
+        return;
+    }
+    char codeStr[20]; snprintf(codeStr,20,"HTTP %d",s_hedge.result);
+    if (s_hedge.result!=200||(s_load.spooled&&!s_hedge.complete)) { waybackLose(codeStr); return; }
+    // Done before the live leg: that one goes, and the snapshot takes the page.
+    if (s_load.spooled) {
+        fetchAbort(s_fetch); s_load.live=LEG_LOST;
+        if (s_load.streaming) streamEnd();
+        if (s_pageShown) { s_pageShown=false; loadScreen(s_load.url); }
+        s_load.spooled=false; s_load.streaming=true;
+        if (!spoolDrain(pageTap,FORMAT_MARKDOWN)) { waybackLose("Wayback unreadable"); return; }
+    }
+    s_httpCode=s_hedge.result;
+    bool ok=streamEnd()&&g_pageLen>20;
+    s_load.streaming=false; spoolFree();
+    if (!ok) { s_load.wayback=LEG_LOST; loadFail(codeStr); return; }
+    s_load.wayback=LEG_WON; loadDone(s_hedge.complete);
+}
+
+static void loadPoll(char key, bool up, bool dn) {
+    if (key==27) {
+        bool keep=s_pageShown&&s_load.streaming;
+        legsAbort();
+        if (s_load.streaming) streamEnd();
+        if (keep) loadDone(false); else loadFail(nullptr);
+        return;
+    }
+    if (s_pageShown) {
+        if (up==LOW&&s_pvUp==HIGH&&scrollPos>0) { scrollPos--; drawPageBody(); }
+        else if (dn==LOW&&s_pvDn==HIGH&&scrollPos<g_lineCount-CONT_ROWS) { scrollPos++; drawPageBody(); }
+        else if (g_lineCount!=s_pvLines) drawScrollBar(tft,CONT_Y);
+        s_pvUp=up; s_pvDn=dn; s_pvLines=g_lineCount;
+    }
+    switch (s_load.step) {
+    case LOAD_PREFETCH: {
+        int r;
+        { TraceScope t(TR_CACHE); r=prefetchTake(s_load.url); }
+        if (r<0&&millis()-s_load.t0<PREFETCH_WAIT_MS) return;
+        if (r==1) { loadDone(true); return; }
+        prefetchPause(true);
+        if (r==0) { jinaStart(); return; }
+        // Jina already came back with a block page: straight to Wayback.
+        moreStop();
+        s_load.step=LOAD_RACE; s_load.live=LEG_LOST; s_load.wayback=LEG_IDLE; s_load.streaming=false;
+        cdxStart();
+        return;
+    }
+    case LOAD_RACE:
+        if (s_load.live==LEG_PAGE) livePoll();
+        if (appState==STATE_LOADING) waybackPoll();
+        return;
+    }
+}
+
+static void drawScrollBar(TFT_eSPI& g, int y0) {
+    if (g_lineCount <= CONT_ROWS) return;
+    int maxS   = max(0, g_lineCount - CONT_ROWS);
+    int barH   = CONT_H;
+    int thumbH = max(4, barH * CONT_ROWS / g_lineCount);
+    int thumbY = y0 + (barH - thumbH) * scrollPos / max(1, maxS);
+    g.fillRect(SCREEN_W-3, y0, 3, barH, C_LTGRAY);
+    g.fillRect(SCREEN_W-3, thumbY, 3, thumbH, C_BLACK);
+}
+
+// One run per StyleSpan that overlaps the row; pages without spans are a
+// single plain run.
+static void drawRuns(TFT_eSPI& g, int x, int y, const char* buf, int n, uint32_t at, uint16_t fg, uint16_t bg) {
+    int si = g_spanCount ? spanFind(at) : -1;
+    for (int i = 0; i < n; si++) {
+        int end = n;
+        if (si + 1 < g_spanCount) end = constrain((int)(spanAt(si + 1).start - at), i + 1, n);
+        uint8_t st = si >= 0 ? spanAt(si).style : (uint8_t)BLK_TEXT;
+        uint16_t f = (st & STY_LINK) ? C_BLUE : (st & STY_EM) ? C_DKGRAY : fg;
+        textRun(g, x, y, buf + i, end - i, f, (st & STY_CODE) ? C_CODEBG : bg, st & STY_BOLD);
+        x = g.getCursorX(); i = end;
+    }
+}
+
+// The first link whose label reaches into a row starting at off.
+static int linkFrom(uint32_t off) {
+    int i = linkFirst(off);
+    return i > 0 && g_links[i - 1].at + linkLabelLen(i - 1) > off ? i - 1 : i;
+}
+
+static bool linkKeyed(int i) { return i >= s_linkTop && i - s_linkTop < LINK_KEYS; }
+
+// Link i's label as drawn: the key that opens it in place of its number for
+// the first LINK_KEYS on screen, blank for the rest. Returns its length.
+static int linkLabel(int i, char* lbl) {
+    int len = linkLabelLen(i);
+    memset(lbl, ' ', len); lbl[0] = '['; lbl[len - 1] = ']';
+    if (linkKeyed(i)) lbl[1] = '1' + (i - s_linkTop);
+    return len;
+}
+static uint16_t linkFg(int i)              { return i == s_linkFocus || linkKeyed(i) ? C_WHITE : C_BLUE; }
+static uint16_t linkBg(int i, uint16_t bg) { return i == s_linkFocus ? C_RED : linkKeyed(i) ? C_BLUE : bg; }
+
+// H1 is FONT4 over two rows (its second row redraws the whole heading one row
+// up and lets the clip take the top half), H2/H3 are FONT2 in one.
+static void drawPageRow(TFT_eSPI& g, int y0, int row) {
+    int li = scrollPos + row; if (li >= g_lineCount) return;
+    LineSpan ls = lineAt(li); if (ls.len == 0) return;
+    char buf[CONT_COLS * 4 + 1]; int n = min((int)ls.len, CONT_COLS * 4);
+    pageRead(ls.start, buf, n); buf[n] = 0; n = (int)strlen(buf);
+    int y = y0 + row * CHAR_H;
+    switch (ls.block) {
+        case BLK_H1: case BLK_H2: case BLK_H3: {
+            // FONT2/FONT4 are ASCII only.
+            char fold[CONT_COLS * 6 + 1]; fold[asciiFold(buf, n, fold)] = 0;
+            int hy = ls.block == BLK_H1 ? y - ls.cont * CHAR_H + 3 : y;
+            g.setTextFont(ls.block == BLK_H1 ? 4 : 2);
+            g.setTextColor(C_BLACK, C_WHITE);
+            g.drawString(fold, 0, hy);
+            if (ls.block == BLK_H2) g.drawFastHLine(0, y + CHAR_H - 1, g.textWidth(fold), C_LTGRAY);
+            // Labels go over in the heading font: the old one is blanked to
+            // its own width, as the key or spaces are narrower than digits.
+            for (int i = linkFrom(ls.start); i < g_linkCount && g_links[i].at < ls.start + n; i++) {
+                uint32_t at = g_links[i].at; char lbl[8]; int len = linkLabel(i, lbl);
+                int a = max(at, ls.start) - ls.start, b = min(at + len, ls.start + n) - ls.start;
+                char piece[8]; memcpy(piece, buf + a, b - a); piece[b - a] = 0;
+                fold[asciiFold(buf, a, fold)] = 0;
+                int x = g.textWidth(fold), w = g.textWidth(piece);
+                memcpy(piece, lbl + (ls.start + a - at), b - a);
+                g.fillRect(x, hy, w, g.fontHeight(), linkBg(i, C_WHITE));
+                g.setTextColor(linkFg(i), linkBg(i, C_WHITE));
+                g.drawString(piece, x, hy);
             }
+            g.setTextFont(1);
             return;
-        case SS_STYLE:  if (c=='<') ss_tagPos=0; return;
-        case SS_HEAD:   if (c=='<') ss_tagPos=0; return;
-        case SS_COMMENT:
-            if (c=='-') ss_dashCount++;
-            else if (c=='>'&&ss_dashCount>=2) { ss_state=SS_TEXT; ss_dashCount=0; }
-            else ss_dashCount=0;
-            return;
-        case SS_TAG:
-            if (c=='>') {
-                ss_tagBuf[ss_tagPos<127?ss_tagPos:127]=0;
-                char* tag=ss_tagBuf;
-                if (tag[0]=='!') { ss_state=SS_TEXT; ss_tagPos=0; return; }
-                bool closing=(tag[0]=='/'); if (closing) tag++;
-                char name[32]={};int ni=0;
-                while (tag[ni]&&tag[ni]!=' '&&ni<31) { name[ni]=(char)tolower(tag[ni]); ni++; }
-                if (!closing) {
-                    if      (!strcmp(name,"script")) ss_state=SS_SCRIPT;
-                    else if (!strcmp(name,"style"))  ss_state=SS_STYLE;
-                    else if (!strcmp(name,"head"))   ss_state=SS_HEAD;
-                    else if (!strcmp(name,"a")) {
-                        char href[LINK_URL_LEN]={};
-                        if (extractHref(tag,href,LINK_URL_LEN)&&g_linkCount<MAX_LINKS) {
-                            String res=resolveURL(href);
-                            if (!res.startsWith("javascript")&&!res.startsWith("mailto")) {
-                                strncpy(g_links[g_linkCount].url,res.c_str(),LINK_URL_LEN-1);
-                                g_linkCount++;
-                                char lbl[5]; snprintf(lbl,5,"[%d]",g_linkCount);
-                                sws(lbl); ss_inAnchor=true;
-                            }
-                        }
-                        ss_state=SS_TEXT;
-                    } else {
-                        ss_state=SS_TEXT;
-                        if (isBlockTag(name)&&g_pageLen>0&&g_pageText[g_pageLen-1]!='\n') sw('\n');
-                    }
-                } else {
-                    ss_state=SS_TEXT;
-                    if (!strcmp(name,"a")) ss_inAnchor=false;
-                    if (isBlockTag(name)&&g_pageLen>0&&g_pageText[g_pageLen-1]!='\n') sw('\n');
-                }
-                ss_tagPos=0;
-            } else {
-                if (ss_tagPos==1&&ss_tagBuf[0]=='!'&&c=='-') { ss_state=SS_COMMENT; ss_tagPos=0; return; }
-                if (ss_tagPos<127) ss_tagBuf[ss_tagPos++]=c;
-            }
+        }
+        case BLK_RULE:
+            g.drawFastHLine(0, y + CHAR_H / 2, SCREEN_W - 8, C_LTGRAY);
             return;
-        case SS_TEXT:
-            if (c=='<') { ss_state=SS_TAG; ss_tagPos=0; if(inEntity){inEntity=false;entLen=0;} return; }
-            if (c=='&') { inEntity=true; entLen=0; entBuf[entLen++]=c; return; }
-            if (inEntity) {
-                if (entLen<15) entBuf[entLen++]=c;
-                if (c==';') {
-                    entBuf[entLen]=0; char d=decodeEnt(entBuf,entLen);
-                    if (d==' ') { if(g_pageLen>0&&g_pageText[g_pageLen-1]!=' ') sw(' '); }
-                    else if (d) sw(d);
-                    inEntity=false; entLen=0;
-                } else if (entLen>12||c==' '||c=='\n') { inEntity=false; entLen=0; }
-                return;
-            }
-            if (c=='\r') return;
-            if (c=='\t') c=' ';
-            if (c=='\n'&&g_pageLen>0&&g_pageText[g_pageLen-1]=='\n') return;
-            if (c==' '&&g_pageLen>0&&g_pageText[g_pageLen-1]==' ') return;
-            if ((unsigned char)c<32&&c!='\n') return;
-            sw(c); return;
+        case BLK_PRE:
+            g.fillRect(0, y, SCREEN_W - 4, CHAR_H, C_CODEBG);
+            drawRuns(g, 0, y, buf, n, ls.start, C_BLACK, C_CODEBG);
+            break;
+        case BLK_QUOTE:
+            g.fillRect(0, y, 2, CHAR_H, C_LTGRAY);
+            drawRuns(g, CHAR_W, y, buf, n, ls.start, C_DKGRAY, C_WHITE);
+            break;
+        default:
+            drawRuns(g, 0, y, buf, n, ls.start, C_BLACK, C_WHITE);
     }
+    int x0 = ls.block == BLK_QUOTE ? CHAR_W : 0;
+    // Link labels: the first LINK_KEYS on screen show the key that opens them
+    // in place of their number on the page, the rest go blank, the focus is
+    // lit. A label cut by the wrap is drawn a piece per row.
+    for (int i = linkFrom(ls.start); i < g_linkCount && g_links[i].at < ls.start + n; i++) {
+        uint32_t at = g_links[i].at; char lbl[8]; int len = linkLabel(i, lbl);
+        int a = max(at, ls.start) - ls.start, b = min(at + len, ls.start + n) - ls.start;
+        textRun(g, x0 + textColumns(buf, a) * CHAR_W, y, lbl + (ls.start + a - at), b - a,
+                linkFg(i), linkBg(i, ls.block == BLK_PRE ? C_CODEBG : C_WHITE));
+    }
+    // The find hit on show, over whatever style the row has.
+    if (s_findIdx < 0) return;
+    uint32_t h = findHit(s_findIdx), he = h + findLen();
+    if (he <= ls.start || h >= ls.start + n) return;
+    int a = h > ls.start ? h - ls.start : 0, b = min((uint32_t)n, he - ls.start);
+    textRun(g, x0 + textColumns(buf, a) * CHAR_W, y, buf + a, b - a, C_WHITE, C_ORANGE);
+}
+
+// Marks the screen rows link i's label is on. An H1 row takes its second
+// row along, as its font spans both.
+static void linkRows(int i, bool* rows) {
+    if (i < 0 || i >= g_linkCount) return;
+    uint32_t at = g_links[i].at;
+    int e = findRow(at + linkLabelLen(i) - 1); LineSpan l;
+    if (e + 1 < g_lineCount && (lineRead(e + 1, &l, 1), l.cont)) e++;
+    for (int r = findRow(at) - scrollPos; r <= e - scrollPos; r++)
+        if (r >= 0 && r < CONT_ROWS) rows[r] = true;
+}
+
+// The links with a label on screen, from two binary searches on the label
+// offsets. A focus scrolled off moves to the nearest link still on.
+static void linkView() {
+    int last = min(scrollPos + CONT_ROWS, g_lineCount) - 1;
+    if (last < scrollPos) { s_linkTop = s_linkEnd = 0; s_linkFocus = -1; return; }
+    const LineSpan& l = lineAt(last);
+    s_linkTop = linkFirst(lineAt(scrollPos).start); s_linkEnd = linkFirst(l.start + l.len);
+    if (s_linkFocus >= 0) s_linkFocus = s_linkTop == s_linkEnd ? -1 : constrain(s_linkFocus, s_linkTop, s_linkEnd - 1);
 }
 
-static int readChunkSize(Stream* s) {
-    unsigned long t=millis(); char buf[16]; int pos=0; bool cr=false;
-    while (millis()-t<3000) {
-        if (!s->available()){delay(1);continue;}
-        char c=s->read(); if(c=='\r'){cr=true;continue;} if(c=='\n'&&cr) break;
-        if(pos<14) buf[pos++]=c; cr=false;
+// With the sprite, a scroll of a few rows shifts the pixels already there and
+// rasterises only the rows it exposes, then goes out as one window write.
+static void drawPageBody() {
+    TraceScope t(TR_DRAW);
+    int maxS = max(0, g_lineCount - CONT_ROWS);
+    scrollPos = constrain(scrollPos, 0, maxS);
+    pageEnsure(scrollPos, CONT_ROWS);
+    int top = s_linkTop, focus = s_linkFocus;
+    linkView();
+    if (!s_sprOK) {
+        tft.setViewport(0, CONT_Y, SCREEN_W, CONT_H, false);
+        tft.fillRect(0, CONT_Y, SCREEN_W, CONT_H, C_WHITE);
+        tft.setTextSize(1);
+        for (int row = 0; row < CONT_ROWS; row++) drawPageRow(tft, CONT_Y, row);
+        drawScrollBar(tft, CONT_Y);
+        tft.resetViewport();
+        return;
     }
-    buf[pos]=0; return (int)strtol(buf,nullptr,16);
-}
-#define MAX_RAW                   400000
-#define STREAM_FIRST_BYTE_TIMEOUT   8000
-#define STREAM_IDLE_TIMEOUT         4000
-
-static bool readStream(Stream* s, int contentLen, bool chunked) {
-    stripInit(); uint8_t buf[512]; int total=0;
-    unsigned long fbw=millis();
-    while (!s->available()&&millis()-fbw<STREAM_FIRST_BYTE_TIMEOUT) delay(5);
-    if (!s->available()) return false;
-    if (chunked) {
-        while (total<MAX_RAW) {
-            int csz=readChunkSize(s); if(csz<=0) break;
-            int rem=csz;
-            while (rem>0&&total<MAX_RAW) {
-                unsigned long tw=millis();
-                while (!s->available()&&millis()-tw<STREAM_IDLE_TIMEOUT) delay(2);
-                if (!s->available()) break;
-                int toRead=min(min(rem,(int)sizeof(buf)),s->available());
-                s->setTimeout(STREAM_IDLE_TIMEOUT);
-                int got=(int)s->readBytes(buf,toRead); if(got<=0) break;
-                for(int i=0;i<got;i++) stripFeed((char)buf[i]);
-                rem-=got; total+=got;
-            }
-            unsigned long tc=millis(); int nl=0;
-            while (nl<2&&millis()-tc<800) {
-                if(s->available()){char c=s->read();if(c=='\r'||c=='\n')nl++;else break;}
-                else delay(1);
-            }
+    int d = scrollPos - s_sprScroll;
+    if (s_sprScroll < 0 || abs(d) >= CONT_ROWS) {
+        pageSpr.fillSprite(C_WHITE);
+        for (int row = 0; row < CONT_ROWS; row++) drawPageRow(pageSpr, 0, row);
+    } else if (d != 0) {
+        pageSpr.scroll(0, -d * CHAR_H);
+        int from = d > 0 ? CONT_ROWS - d : 0, to = d > 0 ? CONT_ROWS : -d;
+        // Kept rows go again only where a label now reads differently:
+        // renumbered, or the focus moved onto it.
+        bool redo[CONT_ROWS] = {};
+        if (top != s_linkTop)
+            for (int i = s_linkTop; i < min(s_linkEnd, max(top, s_linkTop) + LINK_KEYS); i++) linkRows(i, redo);
+        if (focus != s_linkFocus) linkRows(s_linkFocus, redo);
+        for (int row = 0; row < CONT_ROWS; row++) {
+            bool fresh = row >= from && row < to;
+            if (!fresh && !redo[row]) continue;
+            if (!fresh) pageSpr.fillRect(0, row * CHAR_H, SCREEN_W, CHAR_H, C_WHITE);
+            drawPageRow(pageSpr, 0, row);
         }
+    }
+    s_sprScroll = scrollPos;
+    drawScrollBar(pageSpr, 0);
+    pageSpr.pushSprite(0, CONT_Y);
+}
+
+static void pageHint() {
+    s_hintKeys = min(s_linkEnd - s_linkTop, LINK_KEYS);
+    if (s_findIdx >= 0) {
+        char hint[52]; snprintf(hint,52,"%d/%d  ENTER=next  BKSP=prev  ESC=done",s_findIdx+1,s_findCount);
+        drawHintBar(hint);
+    } else if (s_linkFocus >= 0) {
+        // Where the picked link goes; CLICK or ENTER opens it.
+        char url[LINK_URL_LEN]; linkUrl(s_linkFocus, url, sizeof(url));
+        drawHintBar(strncmp(url, "https://", 8) ? url : url + 8);
+    } else if (s_hintKeys > 0) {
+        char hint[52]; snprintf(hint,52,"1-%d:link CLICK:pick N:URL B:back /:find W:save",s_hintKeys);
+        drawHintBar(hint);
     } else {
-        int rem=(contentLen>0)?contentLen:MAX_RAW;
-        unsigned long lastData=millis();
-        while (rem>0&&total<MAX_RAW) {
-            if (s->available()) {
-                int toRead=min(min(rem,(int)sizeof(buf)),s->available());
-                s->setTimeout(STREAM_IDLE_TIMEOUT);
-                int got=(int)s->readBytes(buf,toRead); if(got<=0) break;
-                for(int i=0;i<got;i++) stripFeed((char)buf[i]);
-                rem-=got; total+=got; lastData=millis();
-            } else { if(millis()-lastData>STREAM_IDLE_TIMEOUT) break; delay(5); }
-        }
+        drawHintBar("N:URL B:back R:reload /:find W:save L:list");
     }
-    if (g_pageLen<PSRAM_PAGE_SIZE-1) g_pageText[g_pageLen]=0;
-    return g_pageLen>5;
-}
-
-static void buildLineCache() {
-    g_lineCount=0; if(!g_pageText||g_pageLen==0) return;
-    uint32_t pos=0;
-    while (pos<g_pageLen&&g_lineCount<MAX_LINES) {
-        uint32_t ls=pos; int col=0; bool wrapped=false;
-        while (pos<g_pageLen) {
-            char c=g_pageText[pos];
-            if (c=='\n') {
-                uint16_t len=(uint16_t)(pos-ls);
-                if(len>0) g_lines[g_lineCount++]={ls,len};
-                pos++; wrapped=false; break;
-            }
-            col++; pos++;
-            if (col>=CONT_COLS) {
-                uint32_t wrapAt=pos;
-                for(int b=(int)pos-1;b>(int)ls;b--) if(g_pageText[b]==' '){wrapAt=(uint32_t)(b+1);break;}
-                uint16_t len=(uint16_t)(wrapAt-ls); if(len==0) len=(uint16_t)(pos-ls);
-                if(g_lineCount<MAX_LINES) g_lines[g_lineCount++]={ls,len};
-                pos=ls+len; while(pos<g_pageLen&&g_pageText[pos]==' ') pos++;
-                wrapped=true; break;
-            }
-        }
-        if (!wrapped&&pos>=g_pageLen&&ls<g_pageLen) {
-            uint16_t len=(uint16_t)(g_pageLen-ls);
-            if(len>0&&g_lineCount<MAX_LINES) g_lines[g_lineCount++]={ls,len}; break;
+}
+
+static void displayPage() {
+    drawPageBody();
+    drawStatusBar();
+    pageHint();
+}
+
+// Moves the trackball focus to link i (-1 for none). Only the rows under the
+// old and the new label are drawn again, and each goes out on its own.
+static void linkFocus(int i) {
+    bool redo[CONT_ROWS] = {};
+    linkRows(s_linkFocus, redo); s_linkFocus = i; linkRows(i, redo);
+    for (int row = 0; row < CONT_ROWS; row++) {
+        if (!redo[row]) continue;
+        if (s_sprOK) {
+            pageSpr.fillRect(0, row * CHAR_H, SCREEN_W, CHAR_H, C_WHITE);
+            drawPageRow(pageSpr, 0, row);
+            drawScrollBar(pageSpr, 0);
+            pageSpr.pushSprite(0, CONT_Y + row * CHAR_H, 0, row * CHAR_H, SCREEN_W, CHAR_H);
+        } else {
+            tft.setViewport(0, CONT_Y + row * CHAR_H, SCREEN_W - 3, CHAR_H, false);
+            tft.fillRect(0, CONT_Y + row * CHAR_H, SCREEN_W - 3, CHAR_H, C_WHITE);
+            drawPageRow(tft, CONT_Y, row);
+            tft.resetViewport();
         }
     }
 }
 
-static void updateBaseDomain(const String& url) {
-    int se=url.indexOf("://"); if(se<0){baseDomain="https://"+url;return;}
-    int he=url.indexOf('/',se+3); baseDomain=(he<0)?url:url.substring(0,he);
+// Scrolls hit i to the third row and redraws the whole body, so the last
+// highlight goes too.
+static void findGo(int i) {
+    s_findIdx = (i + s_findCount) % s_findCount;
+    scrollPos = findRow(findHit(s_findIdx)) - 2;
+    s_sprScroll = -1;
+    displayPage();
 }
 
-static void fetchStatus(const char* line1, const char* line2 = nullptr) {
+// Asks for the text and starts at the first hit at or below the top row.
+static void findStart() {
+    s_findIdx = -1;
+    String q = enterText("Find in page", "Type text  ENTER=find  ESC=cancel", "");
+    s_findCount = q.isEmpty() ? 0 : findQuery(q.c_str());
+    if (s_findCount == 0) {
+        s_sprScroll = -1; displayPage();
+        if (!q.isEmpty()) drawHintBar("Not found  /:find again");
+        return;
+    }
+    uint32_t top = scrollPos < g_lineCount ? lineAt(scrollPos).start : 0;
+    int i = 0;
+    while (i < s_findCount && findHit(i) < top) i++;
+    findGo(i < s_findCount ? i : 0);
+}
 
-    tft.setTextSize(1);
-    tft.fillRect(0, CONT_Y+60, SCREEN_W, CHAR_H*2+4, C_WHITE);
-    if (line1) {
-        tft.setTextColor(C_DKGRAY, C_WHITE);
-        tft.setCursor((SCREEN_W-(int)strlen(line1)*CHAR_W)/2, CONT_Y+60);
-        tft.print(line1);
+// BGR565 like the C_ colours: purple, cyan, olive, teal for the ones without a name.
+static const uint16_t PHASE_COLORS[TR_PHASES] = {
+    C_GREEN, 0xA014, C_RED, C_ORANGE, C_BLUE, 0xFE40, 0x0618, 0x8500, C_DKGRAY
+};
+
+// The last requests, newest on top, as bars of per-phase self time on one
+// scale; time no phase claims (result parsing, status draws, waits) is the
+// grey tail. Every span still in the ring also goes out on serial for
+// tools/trace2chrome.py. Any key or a click closes it.
+static void showPerf() {
+    TraceReq reqs[TRACE_REQS];
+    int n = traceRecent(reqs, min(TRACE_REQS, CONT_ROWS - 2));
+    tft.fillScreen(C_WHITE);
+    char title[32];
+    if (s_glyphBytes) snprintf(title, sizeof(title), "Perf  glyphs %u KB", (unsigned)(s_glyphBytes / 1024));
+    drawStatusBar(s_glyphBytes ? title : "Perf");
+    // Text raster rate since the last look.
+    char hint[52];
+    snprintf(hint, sizeof(hint), "text %lu kpx/s  trace on serial  ANY KEY=close",
+             s_runUs ? (unsigned long)((uint64_t)s_runPx * 1000 / s_runUs) : 0ul);
+    drawHintBar(hint);
+    s_runPx = s_runUs = 0;
+    int x = 4, y = CONT_Y + 4;
+    for (int p = 0; p < TR_PHASES; p++) {
+        const char* nm = tracePhaseName(p);
+        int w = GLCD_W + 4 + (int)strlen(nm) * GLCD_W + 8;
+        if (x + w > SCREEN_W) { x = 4; y += CHAR_H; }
+        tft.fillRect(x, y + 1, GLCD_W, GLCD_W, PHASE_COLORS[p]);
+        textRun(x + GLCD_W + 4, y, nm, C_DKGRAY, C_WHITE);
+        x += w;
     }
-    if (line2) {
-        tft.setTextColor(C_LTGRAY, C_WHITE);
-        int l2 = min((int)strlen(line2), CONT_COLS);
-        tft.setCursor((SCREEN_W - l2*CHAR_W)/2, CONT_Y+78);
-        for(int i=0;i<l2;i++) tft.print(line2[i]);
+    uint32_t scale = 1;
+    for (int i = 0; i < n; i++) scale = max(scale, reqs[i].total);
+    const int W = SCREEN_W - 8;
+    for (int i = 0; i < n; i++) {
+        const TraceReq& r = reqs[i];
+        int yr = CONT_Y + (2 + i) * CHAR_H;
+        char line[CONT_COLS + 1];
+        int k = snprintf(line, sizeof(line), "%c%c %5lums ", r.kind, r.via ? r.via : ' ', (unsigned long)(r.total / 1000));
+        snprintf(line + k, sizeof(line) - k, "%s", r.label);
+        textRun(tft, 4, yr, line, fitCols(line, CONT_COLS - 1), C_BLACK, C_WHITE);
+        uint32_t at = 0;
+        for (int p = 0; p <= TR_PHASES; p++) {
+            uint32_t d = p < TR_PHASES ? r.self[p] : r.total - min(r.total, at);
+            int x0 = (int)((uint64_t)at * W / scale), x1 = (int)((uint64_t)(at + d) * W / scale);
+            if (x1 > x0) tft.fillRect(4 + x0, yr + GLCD_H + 2, x1 - x0, 5, p < TR_PHASES ? PHASE_COLORS[p] : C_LTGRAY);
+            at += d;
+        }
     }
+    if (!n) textRun(4, CONT_Y + 2 * CHAR_H, "No requests traced yet.", C_DKGRAY, C_WHITE);
+    traceDump([](const char* l) { Serial.println(l); });
+    while (!readKey() && digitalRead(TB_CLICK) == HIGH) delay(10);
+    while (digitalRead(TB_CLICK) == LOW) delay(10);
 }
 
-static bool jinaFetch(const String& targetURL, const char* statusLine) {
-    String jinaURL = "https://r.jina.ai/" + targetURL;
-    HTTPClient http;
-    const char* hdrs[] = {"Transfer-Encoding","Content-Encoding"};
-    http.collectHeaders(hdrs,2); http.setTimeout(30000);
-    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    http.setUserAgent("Mozilla/5.0 (compatible; CanuckWeb/3.0)");
-    http.addHeader("Accept-Encoding","identity");
-    http.addHeader("X-Return-Format","text");
-    http.addHeader("X-No-Cache","true");
-    if (!g_ssl) { g_ssl=new WiFiClientSecure(); g_ssl->setInsecure(); }
-    http.begin(*g_ssl,jinaURL);
-    fetchStatus(statusLine);
-    int code=http.GET();
-    char codeStr[20]; snprintf(codeStr,20,"HTTP %d",code);
-    fetchStatus(statusLine, codeStr);
-    if (code!=200) { http.end(); return false; }
-    String te=http.header("Transfer-Encoding"); te.toLowerCase();
-    bool chunked=(te.indexOf("chunked")>=0);
-    int cLen=http.getSize(); Stream* s=&http.getStream();
-    bool ok=readStream(s,cLen,chunked); http.end();
-    return ok&&g_pageLen>20;
-}
-
-static bool pageIsBlocked() {
-    if (g_pageLen<10) return true;
-    char buf[2049]; int scan=min((int)g_pageLen,2048);
-    for(int i=0;i<scan;i++) buf[i]=tolower(g_pageText[i]); buf[scan]=0;
-    const char* sigs[]={
-        "enable javascript","please enable","access denied","subscribe to continue",
-        "subscribe to read","sign in to read","create an account","log in to continue",
-        "you've reached your","premium content","403 forbidden","just a moment",
-        "checking your browser","ddos protection","ray id","verifying you are human",nullptr
-    };
-    for(int i=0;sigs[i];i++) if(strstr(buf,sigs[i])) return true;
-    return false;
-}
-
-static bool waybackFetch(const String& url) {
-    fetchStatus("Trying Wayback Machine...");
-    String cdxURL="http://archive.org/wayback/available?url="+url;
-    HTTPClient cdxHttp; cdxHttp.setTimeout(10000);
-    cdxHttp.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-    cdxHttp.setUserAgent("Mozilla/5.0 (compatible; CanuckWeb/3.0)");
-    static WiFiClient plainClient; cdxHttp.begin(plainClient,cdxURL);
-    int cdxCode=cdxHttp.GET();
-    if (cdxCode!=200) { cdxHttp.end(); fetchStatus("Wayback unavailable"); delay(2000); return false; }
-    String cdxBody=cdxHttp.getString(); cdxHttp.end();
-    int urlIdx=cdxBody.indexOf("\"url\":\""); if(urlIdx<0){ fetchStatus("Not in Wayback"); delay(2500); return false; }
-    urlIdx+=7; int urlEnd=cdxBody.indexOf('"',urlIdx); if(urlEnd<0) return false;
-    String archiveURL=cdxBody.substring(urlIdx,urlEnd); archiveURL.replace("\\/","/");
-    return jinaFetch(archiveURL,"via Wayback + Jina...");
-}
-
-static bool fetchPage(const String& url) {
-    currentURL=url; updateBaseDomain(url);
+// The reading list: every page saved with W, two rows each, by title.
+#define SAVED_ROWS 6
+static SavedInfo* s_saved = nullptr;
+static int        s_savedCount = 0, s_savedCursor = 0, s_savedScroll = 0;
+static AppState   s_savedFrom = STATE_SEARCH_IDLE;
+
+static bool       s_fsOK = false;        // SPIFFS mounted
+
+static void drawSaved() {
+    TraceScope t(TR_DRAW);
     tft.fillScreen(C_WHITE);
-    drawStatusBar("Loading...");
-    drawHintBar("Please wait...");
+    drawStatusBar("Saved");
+    if (!s_fsOK) {
+        drawHintBar("F=format flash (erases it all)  B=back");
+        textRun((SCREEN_W - 28 * CHAR_W) / 2, CONT_Y + 80, "Flash storage did not mount.", C_DKGRAY, C_WHITE);
+        return;
+    }
+    drawHintBar("BALL=select  ENTER=open  D=delete  B=back");
     tft.setTextSize(1);
+    if (s_savedCount == 0) {
+        textRun((SCREEN_W - 34 * CHAR_W) / 2, CONT_Y + 80, "Nothing saved yet. W saves a page.", C_DKGRAY, C_WHITE);
+        return;
+    }
+    int blockH = 2 * CHAR_H;
+    for (int i = 0; i < min(SAVED_ROWS, s_savedCount - s_savedScroll); i++) {
+        int idx = s_savedScroll + i, yTop = CONT_Y + 4 + i * (blockH + 2);
+        const SavedInfo& e = s_saved[idx];
+        bool hi = idx == s_savedCursor;
+        uint16_t fg = hi ? C_WHITE : C_BLACK, bg = hi ? C_BLUE : C_WHITE;
+        const char* u = e.url;
+        if (strncmp(u, "https://", 8) == 0) u += 8;
+        else if (strncmp(u, "http://", 7) == 0) u += 7;
+        const char* title = e.title[0] ? e.title : u;
+        tft.fillRect(0, yTop, SCREEN_W, CHAR_H, bg);
+        textRun(tft, 6, yTop + 1, title, fitCols(title, CONT_COLS - 8), fg, bg);
+        char kb[8]; snprintf(kb, 8, "%uK", (unsigned)((e.bytes + 1023) / 1024));
+        textRun(SCREEN_W - (int)strlen(kb) * CHAR_W - 4, yTop + 1, kb, fg, bg);
+        textRun(tft, 6, yTop + CHAR_H + 1, u, (int)strnlen(u, CONT_COLS - 1), C_DKGRAY, C_WHITE);
+        tft.drawFastHLine(0, yTop + blockH + 1, SCREEN_W, C_LTGRAY);
+    }
+    char nav[20]; snprintf(nav, 20, "%d / %d", s_savedCursor + 1, s_savedCount);
+    textRun(SCREEN_W - (int)strlen(nav) * CHAR_W - 4, HINT_Y - CHAR_H - 1, nav, C_DKGRAY, C_WHITE);
+}
 
-    tft.setTextColor(C_BLACK, C_WHITE);
-    tft.setCursor((SCREEN_W-12*CHAR_W)/2, CONT_Y+30);
-    tft.print("Loading page");
-
-    String disp=url; if(disp.startsWith("https://")) disp=disp.substring(8);
-    if((int)disp.length()>CONT_COLS) disp=disp.substring(0,CONT_COLS-3)+"...";
-    tft.setTextColor(C_DKGRAY, C_WHITE);
-    tft.setCursor((SCREEN_W-(int)disp.length()*CHAR_W)/2, CONT_Y+48);
-    tft.print(disp);
+// Re-reads the list; from is where B goes back to.
+static void savedShow(AppState from) {
+    if (!s_saved) s_saved = (SavedInfo*)heap_caps_malloc(SAVED_MAX * sizeof(SavedInfo), MALLOC_CAP_SPIRAM);
+    s_savedCount = s_saved ? savedList(s_saved, SAVED_MAX) : 0;
+    s_savedCursor = constrain(s_savedCursor, 0, max(0, s_savedCount - 1));
+    s_savedScroll = constrain(s_savedScroll, max(0, s_savedCursor - SAVED_ROWS + 1), s_savedCursor);
+    if (from != STATE_SAVED) s_savedFrom = from;
+    showState(STATE_SAVED);
+}
 
-    bool ok=jinaFetch(url,"via r.jina.ai...");
-    if (ok&&pageIsBlocked()) { ok=waybackFetch(url); }
-    if (!ok) ok=waybackFetch(url);
-    if (!ok||g_pageLen<20) {
-        fetchStatus("Page unavailable");
-        delay(3000); return false;
+static void showState(AppState st) {
+    appState = st;
+    switch (st) {
+        case STATE_WIFI_SCAN:   drawWifiList(); break;
+        case STATE_SEARCH_IDLE: drawIdleScreen(); break;
+        case STATE_RESULTS:     drawResults(); break;
+        case STATE_PAGE_VIEW:   displayPage(); lastStatusMs = millis(); break;
+        case STATE_SAVED:       drawSaved(); break;
+        default: break;
     }
-    buildLineCache(); scrollPos=0; return true;
 }
 
-static void displayPage() {
-
-    tft.fillRect(0, CONT_Y, SCREEN_W, CONT_H, C_WHITE);
-    int maxS = max(0, g_lineCount - CONT_ROWS);
-    scrollPos = constrain(scrollPos, 0, maxS);
+static AppState      s_noticeNext = STATE_SEARCH_IDLE;
+static unsigned long s_noticeAt = 0, s_noticeMs = 0;
 
-    tft.setTextSize(1);
-    for (int row = 0; row < CONT_ROWS; row++) {
-        int li = scrollPos + row; if (li >= g_lineCount) break;
-        LineSpan& ls = g_lines[li]; if (ls.len == 0) continue;
-        int pl = min((int)ls.len, CONT_COLS - 1);
-        tft.setTextColor(C_BLACK, C_WHITE);
-        tft.setCursor(0, CONT_Y + row * CHAR_H);
-        for (int i = 0; i < pl && g_pageText[ls.start+i]; i++)
-            tft.print(g_pageText[ls.start+i]);
-    }
+static void notice(AppState next, unsigned long ms) {
+    s_noticeNext = next; s_noticeAt = millis(); s_noticeMs = ms;
+    appState = STATE_NOTICE;
+}
 
-    if (g_lineCount > CONT_ROWS) {
-        int barH   = CONT_H;
-        int thumbH = max(4, barH * CONT_ROWS / g_lineCount);
-        int thumbY = CONT_Y + (barH - thumbH) * scrollPos / max(1, maxS);
-        tft.fillRect(SCREEN_W-3, CONT_Y, 3, barH, C_LTGRAY);
-        tft.fillRect(SCREEN_W-3, thumbY, 3, thumbH, C_BLACK);
-    }
+// A smooth font in SPIFFS (/glyphs.vlw, made with TFT_eSPI's font tool at
+// about 8 px) takes over the non-ASCII glyphs; without one the built-in set
+// covers Latin-1 and French.
+static void loadGlyphFont() {
+    File f = SPIFFS.open("/glyphs.vlw", "r");
+    if (!f) return;
+    size_t n = f.size();
+    uint8_t* vlw = (uint8_t*)heap_caps_malloc(n, MALLOC_CAP_SPIRAM);
+    if (vlw && f.read(vlw, n) == n && glyphFont(vlw, n)) s_glyphBytes = n;
+    else heap_caps_free(vlw);
+    f.close();
+}
 
-    drawStatusBar();
-    if (g_linkCount > 0) {
-        char hint[52]; snprintf(hint,52,"1-%d:link  N:URL  B:back  R:reload  S:srch",g_linkCount);
-        drawHintBar(hint);
-    } else {
-        drawHintBar("N:URL  B:back  R:reload  S:search  Q:quit");
-    }
+// A partition that won't mount is left as it is (it holds the reading list
+// and the glyph font); formatting it is the user's call, from the list.
+static bool fsMount(bool format) {
+    if (format && !SPIFFS.format()) return false;
+    if (!SPIFFS.begin(false)) return false;
+    loadGlyphFont(); savedBegin(SPIFFS); localBegin(SPIFFS);
+    return true;
 }
 
 void setup() {
@@ -1119,12 +1441,14 @@ void setup() {
     pinMode(TB_DOWN, INPUT_PULLUP);
     pinMode(TB_CLICK, INPUT_PULLUP);
 
-    g_pageText = (char*)heap_caps_malloc(PSRAM_PAGE_SIZE, MALLOC_CAP_SPIRAM);
-    g_lines    = (LineSpan*)heap_caps_malloc(MAX_LINES * sizeof(LineSpan), MALLOC_CAP_SPIRAM);
     g_links    = (LinkEntry*)heap_caps_malloc(MAX_LINKS * sizeof(LinkEntry), MALLOC_CAP_SPIRAM);
-    if (!g_pageText) g_pageText = (char*)malloc(32 * 1024);
-    if (!g_lines)    g_lines    = (LineSpan*)malloc(MAX_LINES * sizeof(LineSpan));
     if (!g_links)    g_links    = (LinkEntry*)malloc(MAX_LINKS * sizeof(LinkEntry));
+    prefetchInit();
+    s_dmaOK = tft.initDMA();
+    s_fsOK = fsMount(false);
+    pageSpr.setColorDepth(16);
+    s_sprOK = pageSpr.createSprite(SCREEN_W, CONT_H) != nullptr;
+    if (s_sprOK) pageSpr.setScrollRect(0, 0, SCREEN_W, CONT_H, C_WHITE);
 
     drawBoot(0);
     for (int p = 1; p <= 100; p++) { drawBoot(p); delay(100); }
@@ -1132,19 +1456,17 @@ void setup() {
 
     WiFi.mode(WIFI_STA); WiFi.setAutoReconnect(true);
 
-    if (loadAndConnect()) {
-        appState = STATE_SEARCH_IDLE;
-        drawIdleScreen();
-    } else {
-        doWifiScan();
-        drawWifiList();
-        appState = STATE_WIFI_SCAN;
-    }
+    String ssid, pw;
+    if (loadCredentials(ssid, pw)) joinStart(ssid, pw, true);
+    else { doWifiScan(); showState(STATE_WIFI_SCAN); }
 }
 
 void loop() {
+    // A search or page load stays one traced request until it finishes.
+    if (appState != STATE_SEARCHING && appState != STATE_LOADING) { traceIdle(); localFlush(false); }
+    morePoll();
     if (appState == STATE_PAGE_VIEW && millis() - lastStatusMs > STATUS_INTERVAL) {
-        drawStatusBar(); lastStatusMs = millis();
+        drawStatusBar(nullptr, true); lastStatusMs = millis();
     }
 
     static bool lastUp = HIGH, lastDown = HIGH, lastClick = HIGH;
@@ -1153,7 +1475,19 @@ void loop() {
     bool click = digitalRead(TB_CLICK);
     char key   = readKey();
 
-    if (appState == STATE_WIFI_SCAN) {
+    if (appState == STATE_WIFI_JOIN) {
+        joinPoll(key);
+
+    } else if (appState == STATE_SEARCHING) {
+        searchPoll(key);
+
+    } else if (appState == STATE_LOADING) {
+        loadPoll(key, up, dn);
+
+    } else if (appState == STATE_NOTICE) {
+        if (key || (click == LOW && lastClick == HIGH) || millis() - s_noticeAt >= s_noticeMs) showState(s_noticeNext);
+
+    } else if (appState == STATE_WIFI_SCAN) {
         if (up == LOW && lastUp == HIGH) {
             if (wifiSelected > 0) { wifiSelected--; if(wifiSelected<wifiScrollOff) wifiScrollOff--; drawWifiList(); }
             delay(150);
@@ -1170,27 +1504,16 @@ void loop() {
             if (wifiCount == 0) { doWifiScan(); drawWifiList(); goto end; }
             String ssid = wifiSSIDs[wifiSelected];
             String pw   = enterPassword(ssid);
-            if (connectWifi(ssid, pw)) {
-                saveCredentials(ssid, pw);
-                appState = STATE_SEARCH_IDLE;
-                drawIdleScreen();
-            } else {
-                drawWifiList();
-            }
+            joinStart(ssid, pw, false);
+            goto end;
         }
         if (key == 'r' || key == 'R') { doWifiScan(); drawWifiList(); }
+        if (key == 'l' || key == 'L') savedShow(STATE_WIFI_SCAN);
 
     } else if (appState == STATE_SEARCH_IDLE) {
         bool redraw = false;
-        bool searching = false;
         if (key == '\n' || key == '\r') {
-            if (g_searchQuery.length() > 0) {
-                searching = true;
-                tft.fillScreen(C_WHITE);
-                doSearch(g_searchQuery);
-                drawResults();
-                appState = STATE_RESULTS;
-            }
+            if (g_searchQuery.length() > 0) { searchStart(g_searchQuery); goto end; }
         } else if (key == 27) {
             g_searchQuery = ""; redraw = true;
         } else if ((key == 8 || key == 127) && g_searchQuery.length() > 0) {
@@ -1201,16 +1524,12 @@ void loop() {
             String url = enterText("Enter URL", "Type URL  ENTER=go  ESC=cancel", "https://");
             if (url.length() > 0) {
                 if (!url.startsWith("http")) url = "https://" + url;
-                if (fetchPage(url)) {
-                    urlHistory[0] = url; historyCount = 1;
-                    displayPage(); lastStatusMs = millis();
-                    appState = STATE_PAGE_VIEW;
-                } else drawIdleScreen();
+                pageOpen(url, HIST_RESET);
             } else drawIdleScreen();
             goto end;
         }
         static unsigned long lastBlink = 0;
-        if (!searching && (redraw || millis() - lastBlink > 480)) {
+        if (redraw || millis() - lastBlink > 480) {
             drawSearchBox(SB_Y, g_searchQuery, true);
             lastBlink = millis();
         }
@@ -1223,6 +1542,7 @@ void loop() {
                 if (g_resultCursor >= g_resultScroll + RESULTS_PER_PAGE)
                     g_resultScroll = g_resultCursor - RESULTS_PER_PAGE + 1;
                 redraw = true;
+                moreStart();
             }
             delay(150);
         }
@@ -1236,12 +1556,8 @@ void loop() {
         }
         if ((click == LOW && lastClick == HIGH) || key == '\n' || key == '\r') {
             if (g_resultCursor < g_resultCount) {
-                String url = String(g_results[g_resultCursor].url);
-                if (url.length() > 0 && fetchPage(url)) {
-                    if (historyCount < HISTORY_MAX) urlHistory[historyCount++] = url;
-                    displayPage(); lastStatusMs = millis();
-                    appState = STATE_PAGE_VIEW;
-                } else drawResults();
+                String url = String(resultAt(g_resultCursor).url);
+                if (url.length() > 0) pageOpen(url, HIST_PUSH);
             }
             goto end;
         }
@@ -1249,11 +1565,8 @@ void loop() {
             int idx = key - '1';
             if (idx < g_resultCount) {
                 g_resultCursor = idx;
-                String url = String(g_results[idx].url);
-                if (url.length() > 0 && fetchPage(url)) {
-                    if (historyCount < HISTORY_MAX) urlHistory[historyCount++] = url;
-                    displayPage(); lastStatusMs = millis(); appState = STATE_PAGE_VIEW;
-                } else drawResults();
+                String url = String(resultAt(idx).url);
+                if (url.length() > 0) pageOpen(url, HIST_PUSH); else drawResults();
             }
         } else if (key == 's' || key == 'S' || key == '/') {
             appState = STATE_SEARCH_IDLE; drawIdleScreen();
@@ -1263,59 +1576,121 @@ void loop() {
             String url = enterText("Enter URL","Type URL  ENTER=go  ESC=cancel","https://");
             if (url.length() > 0) {
                 if (!url.startsWith("http")) url = "https://" + url;
-                if (fetchPage(url)) {
-                    if (historyCount < HISTORY_MAX) urlHistory[historyCount++] = url;
-                    displayPage(); lastStatusMs = millis(); appState = STATE_PAGE_VIEW;
-                } else drawResults();
+                pageOpen(url, HIST_PUSH);
             } else drawResults();
+        } else if (key == 'p' || key == 'P') {
+            showPerf(); drawResults();
+        } else if (key == 'l' || key == 'L') {
+            savedShow(STATE_RESULTS); goto end;
         }
         if (redraw) drawResults();
 
     } else if (appState == STATE_PAGE_VIEW) {
+        // With a link picked the ball steps through the links on screen,
+        // and scrolls once there are no more.
+        int focus = s_linkFocus;
         if (up == LOW && lastUp == HIGH) {
-            if (scrollPos > 0) { scrollPos--; displayPage(); } delay(80);
+            if (focus > s_linkTop) linkFocus(focus - 1);
+            else if (scrollPos > 0) { scrollPos--; drawPageBody(); }
+            delay(PAGE_SCROLL_MS);
         }
         if (dn == LOW && lastDown == HIGH) {
             int ms = max(0, g_lineCount - CONT_ROWS);
-            if (scrollPos < ms) { scrollPos++; displayPage(); } delay(80);
+            if (focus >= 0 && focus + 1 < s_linkEnd) linkFocus(focus + 1);
+            else if (scrollPos < ms) { scrollPos++; drawPageBody(); }
+            delay(PAGE_SCROLL_MS);
         }
-        if (key >= '1' && key <= '9') {
-            int li = key - '1';
-            if (li < g_linkCount) {
-                String lu = String(g_links[li].url);
-                if (fetchPage(lu)) {
-                    if (historyCount < HISTORY_MAX) urlHistory[historyCount++] = lu;
-                    displayPage(); lastStatusMs = millis();
-                } else displayPage();
+        if (s_linkFocus != focus || min(s_linkEnd - s_linkTop, LINK_KEYS) != s_hintKeys) pageHint();
+        bool pick = click == LOW && lastClick == HIGH;
+        if (s_findIdx < 0 && s_linkFocus >= 0 && (pick || key == '\n' || key == '\r')) {
+            char url[LINK_URL_LEN]; linkUrl(s_linkFocus, url, sizeof(url));
+            pageOpen(String(url), HIST_PUSH);
+        } else if (pick) {
+            if (s_linkTop < s_linkEnd) { linkFocus(s_linkTop); pageHint(); }
+        } else if (key >= '1' && key <= '9') {
+            int li = s_linkTop + key - '1';
+            if (li < s_linkEnd) {
+                char url[LINK_URL_LEN]; linkUrl(li, url, sizeof(url));
+                pageOpen(String(url), HIST_PUSH);
             }
         } else if (key == 'b' || key == 'B') {
             if (historyCount > 1) {
                 historyCount--;
-                String prev = urlHistory[historyCount - 1];
-                if (fetchPage(prev)) { displayPage(); lastStatusMs = millis(); }
+                pageOpen(histAt(historyCount - 1), HIST_NONE);
             } else {
                 if (g_resultCount > 0) { drawResults(); appState = STATE_RESULTS; }
                 else { drawIdleScreen(); appState = STATE_SEARCH_IDLE; }
             }
         } else if (key == 'r' || key == 'R') {
-            if (!currentURL.isEmpty() && fetchPage(currentURL)) { displayPage(); lastStatusMs = millis(); }
+            if (!currentURL.isEmpty()) pageOpen(currentURL, HIST_NONE, false);
         } else if (key == 'n' || key == 'N') {
             String url = enterText("Enter URL","Type URL  ENTER=go  ESC=cancel","https://");
             if (url.length() > 0) {
                 if (!url.startsWith("http")) url = "https://" + url;
-                if (fetchPage(url)) {
-                    if (historyCount < HISTORY_MAX) urlHistory[historyCount++] = url;
-                    displayPage(); lastStatusMs = millis();
-                } else displayPage();
+                pageOpen(url, HIST_PUSH);
             } else displayPage();
-        } else if (key == 's' || key == 'S' || key == '/') {
+        } else if (key == 's' || key == 'S') {
             appState = STATE_SEARCH_IDLE; drawIdleScreen();
+        } else if (key == '/' || key == 'f' || key == 'F') {
+            findStart();
+        } else if (s_findIdx >= 0 && (key == '\n' || key == '\r')) {
+            findGo(s_findIdx + 1);
+        } else if (s_findIdx >= 0 && (key == 8 || key == 127)) {
+            findGo(s_findIdx - 1);
+        } else if (s_findIdx >= 0 && key == 27) {
+            s_findIdx = -1; s_sprScroll = -1; displayPage();
+        } else if (s_linkFocus >= 0 && key == 27) {
+            linkFocus(-1); pageHint();
+        } else if (key == 'p' || key == 'P') {
+            showPerf(); displayPage();
+        } else if (key == 'w' || key == 'W') {
+            bool ok = savedStore(currentURL);
+            if (ok && !localHas(currentURL)) localAdd(currentURL);
+            if (ok) localFlush(true);
+            drawHintBar(ok ? "Saved for offline reading  L=list" : s_fsOK ? "Could not save this page" : "Flash not mounted  L=format it");
+        } else if (key == 'l' || key == 'L') {
+            savedShow(STATE_PAGE_VIEW);
         } else if (key == 'q' || key == 'Q') {
             ESP.restart();
         }
+
+    } else if (appState == STATE_SAVED) {
+        bool redraw = false;
+        if (dn == LOW && lastDown == HIGH) {
+            if (s_savedCursor < s_savedCount - 1) {
+                s_savedCursor++;
+                if (s_savedCursor >= s_savedScroll + SAVED_ROWS) s_savedScroll = s_savedCursor - SAVED_ROWS + 1;
+                redraw = true;
+            }
+            delay(150);
+        }
+        if (up == LOW && lastUp == HIGH) {
+            if (s_savedCursor > 0) {
+                s_savedCursor--;
+                if (s_savedCursor < s_savedScroll) s_savedScroll = s_savedCursor;
+                redraw = true;
+            }
+            delay(150);
+        }
+        if ((click == LOW && lastClick == HIGH) || key == '\n' || key == '\r') {
+            if (s_savedCursor < s_savedCount) pageOpen(String(s_saved[s_savedCursor].url), HIST_PUSH);
+            goto end;
+        }
+        if ((key == 'd' || key == 'D') && s_savedCursor < s_savedCount) {
+            savedRemove(String(s_saved[s_savedCursor].url));
+            savedShow(STATE_SAVED); goto end;
+        } else if (key == 'b' || key == 'B' || key == 27) {
+            showState(s_savedFrom); goto end;
+        } else if (!s_fsOK && (key == 'f' || key == 'F')) {
+            drawHintBar("Erase all of flash?  Y=format  other=cancel");
+            while (!(key = readKey())) delay(10);
+            if (key == 'y' || key == 'Y') { drawHintBar("Formatting..."); s_fsOK = fsMount(true); }
+            savedShow(STATE_SAVED); goto end;
+        }
+        if (redraw) drawSaved();
     }
 
 end:
     lastUp = up; lastDown = dn; lastClick = click;
-    delay(10);
+    delay(appState == STATE_SEARCHING || appState == STATE_LOADING ? 1 : 10);
 }
@@ -0,0 +1,272 @@
+#include "net.h"
+#include <lwip/dns.h>
+#include "trace.h"
+
+enum { DNS_NONE, DNS_PENDING, DNS_OK, DNS_FAILED };
+
+struct PoolSlot {
+    const char*   host;
+    uint16_t      port;
+    bool          tls;
+    WiFiClient*   client;
+    unsigned long lastUsed;
+    uint32_t      handshakes;
+    uint32_t      reuses;
+    bool          busy;
+    uint32_t      ip;
+    unsigned long queriedAt, resolvedAt;
+    volatile uint8_t dns;
+};
+
+static PoolSlot g_pool[] = {
+    { DDG_LITE_HOST, DDG_LITE_PORT, true,  nullptr, 0, 0, 0, false, 0, 0, 0, DNS_NONE },
+    { JINA_HOST,     JINA_PORT,     true,  nullptr, 0, 0, 0, false, 0, 0, 0, DNS_NONE },
+    { WAYBACK_HOST,  WAYBACK_PORT,  false, nullptr, 0, 0, 0, false, 0, 0, 0, DNS_NONE },
+    // A page load racing the Wayback copy against the live one holds two.
+    { JINA_HOST,     JINA_PORT,     true,  nullptr, 0, 0, 0, false, 0, 0, 0, DNS_NONE },
+};
+#define POOL_SLOTS (int)(sizeof(g_pool) / sizeof(g_pool[0]))
+
+// A free slot for the host, one with a live connection first.
+static PoolSlot* poolFind(const char* host, uint16_t port) {
+    PoolSlot* idle = nullptr;
+    for (int i = 0; i < POOL_SLOTS; i++) {
+        PoolSlot& s = g_pool[i];
+        if (s.busy || s.port != port || strcmp(s.host, host)) continue;
+        if (s.client && s.client->connected()) return &s;
+        if (!idle) idle = &s;
+    }
+    return idle;
+}
+
+// Slots for the same host share the first one's address.
+static PoolSlot& dnsSlot(PoolSlot& s) {
+    for (int i = 0; i < POOL_SLOTS; i++) if (!strcmp(g_pool[i].host, s.host)) return g_pool[i];
+    return s;
+}
+
+static PoolSlot* poolOwner(WiFiClient* c) {
+    for (int i = 0; i < POOL_SLOTS; i++) if (g_pool[i].client == c) return &g_pool[i];
+    return nullptr;
+}
+
+// Answers come back on lwIP's thread: the address is stored before the state
+// that publishes it.
+static void dnsFound(const char*, const ip_addr_t* ip, void* arg) {
+    PoolSlot* s = (PoolSlot*)arg;
+    s->ip = ip ? ip->u_addr.ip4.addr : 0;
+    s->resolvedAt = millis();
+    s->dns = s->ip ? DNS_OK : DNS_FAILED;
+}
+
+// Called the way WiFi.hostByName calls it, minus the wait: several can be in
+// flight at once.
+static void dnsQuery(PoolSlot& s) {
+    ip_addr_t addr;
+    s.dns = DNS_PENDING; s.queriedAt = millis();
+    err_t err = dns_gethostbyname(s.host, &addr, dnsFound, &s);
+    if (err == ERR_OK) dnsFound(s.host, &addr, &s);
+    else if (err != ERR_INPROGRESS) s.dns = DNS_FAILED;
+}
+
+static bool dnsFresh(const PoolSlot& s) { return s.dns == DNS_OK && millis() - s.resolvedAt < DNS_TTL_MS; }
+static bool dnsWaiting(const PoolSlot& s) { return s.dns == DNS_PENDING && millis() - s.queriedAt < DNS_TIMEOUT_MS; }
+
+void dnsFlush() {
+    for (int i = 0; i < POOL_SLOTS; i++) if (g_pool[i].dns != DNS_PENDING) g_pool[i].dns = DNS_NONE;
+}
+
+void dnsWarm() {
+    for (int i = 0; i < POOL_SLOTS; i++)
+        if (&dnsSlot(g_pool[i]) == &g_pool[i] && !dnsFresh(g_pool[i]) && !dnsWaiting(g_pool[i])) dnsQuery(g_pool[i]);
+}
+
+static bool dnsLookup(PoolSlot& slot, IPAddress& ip) {
+    PoolSlot& s = dnsSlot(slot);
+    if (!dnsFresh(s) && !dnsWaiting(s)) dnsQuery(s);
+    while (dnsWaiting(s)) delay(2);
+    if (s.dns != DNS_OK) { s.dns = DNS_NONE; return false; }
+    ip = IPAddress(s.ip);
+    return true;
+}
+
+// By address, with the name still going out as SNI; a failed connect drops
+// the address.
+static bool slotConnect(PoolSlot& s, WiFiClient* c, uint16_t port) {
+    IPAddress ip;
+    { TraceScope t(TR_DNS); if (!dnsLookup(s, ip)) return false; }
+    TraceScope t(TR_CONNECT);
+    bool ok = s.tls ? ((WiFiClientSecure*)c)->connect(ip, port, s.host, nullptr, nullptr, nullptr)
+                    : c->connect(ip, port);
+    if (!ok) dnsSlot(s).dns = DNS_NONE;
+    return ok;
+}
+
+bool netConnect(WiFiClient* c, const char* host, uint16_t port) {
+    for (int i = 0; i < POOL_SLOTS; i++)
+        if (g_pool[i].port == port && !strcmp(g_pool[i].host, host)) return slotConnect(g_pool[i], c, port);
+    return false;
+}
+
+WiFiClient* netOpen(const char* host, uint16_t port, bool* reused) {
+    if (reused) *reused = false;
+    PoolSlot* s = poolFind(host, port); if (!s) return nullptr;
+    if (!s->client) {
+        if (s->tls) { WiFiClientSecure* sc = new WiFiClientSecure(); sc->setInsecure(); s->client = sc; }
+        else s->client = new WiFiClient();
+    }
+    if (s->client->connected() && millis() - s->lastUsed < POOL_IDLE_MS) {
+        while (s->client->available() > 0) s->client->read();
+        s->reuses++; s->lastUsed = millis(); s->busy = true;
+        if (reused) *reused = true;
+        return s->client;
+    }
+    s->client->stop();
+    if (!slotConnect(*s, s->client, port)) return nullptr;
+    s->handshakes++; s->lastUsed = millis(); s->busy = true;
+    return s->client;
+}
+
+void netRelease(WiFiClient* c, bool keepAlive) {
+    if (!c) return;
+    if (!keepAlive) c->stop();
+    if (PoolSlot* s = poolOwner(c)) { s->lastUsed = millis(); s->busy = false; }
+}
+
+void netDropAll() {
+    for (int i = 0; i < POOL_SLOTS; i++) if (g_pool[i].client) g_pool[i].client->stop();
+}
+
+int netStats(PoolStats* out, int max) {
+    int n = 0;
+    for (int i = 0; i < POOL_SLOTS && n < max; i++) {
+        PoolSlot& s = g_pool[i];
+        out[n++] = { s.host, s.handshakes, s.reuses, s.client && s.client->connected() };
+    }
+    return n;
+}
+
+static void headInit(HeadParser& p) {
+    p.head = { 0, -1, false, false, CODING_IDENTITY };
+    p.len = 0; p.first = true;
+}
+
+// One byte of a response head. Returns 1 at the blank line, -1 on a bad
+// status line, 0 otherwise.
+static int headByte(HeadParser& p, char ch) {
+    if (ch == '\r') return 0;
+    if (ch != '\n') { if (p.len < (int)sizeof(p.line) - 1) p.line[p.len++] = ch; return 0; }
+    char* line = p.line; line[p.len] = 0; p.len = 0;
+    HttpHead& h = p.head;
+    if (p.first) {
+        p.first = false;
+        const char* sp = strchr(line, ' '); if (!sp) return -1;
+        h.code  = atoi(sp + 1);
+        h.close = !strncmp(line, "HTTP/1.0", 8);
+        return 0;
+    }
+    if (!line[0]) return h.code > 0 ? 1 : -1;
+    char* colon = strchr(line, ':'); if (!colon) return 0;
+    *colon = 0; const char* v = colon + 1; while (*v == ' ') v++;
+    if      (!strcasecmp(line, "Content-Length"))    h.contentLen = atoi(v);
+    else if (!strcasecmp(line, "Transfer-Encoding")) h.chunked = strcasestr(v, "chunked") != nullptr;
+    else if (!strcasecmp(line, "Connection"))        h.close = strcasestr(v, "close") != nullptr;
+    else if (!strcasecmp(line, "Content-Encoding"))  h.coding = parseCoding(v);
+    return 0;
+}
+
+bool readHead(WiFiClient* c, HttpHead& h, unsigned long timeoutMs) {
+    HeadParser p; headInit(p);
+    unsigned long t = millis();
+    while (millis() - t < timeoutMs) {
+        if (!c->available()) { if (!c->connected()) return false; delay(2); continue; }
+        int r = headByte(p, (char)c->read());
+        if (r) { h = p.head; return r > 0; }
+    }
+    return false;
+}
+
+// Spans outlive a poll, so they open and close on state changes; a fetch
+// running alongside the traced one stays out (traced false), as its spans
+// would not nest.
+static void fetchEnter(HttpFetch& f, FetchState st) {
+    if (f.traced && (f.state == FETCH_HEAD || f.state == FETCH_BODY)) traceEnd();
+    if (f.traced && st == FETCH_HEAD) traceBegin(TR_TTFB);
+    if (f.traced && st == FETCH_BODY) traceBegin(TR_BODY);
+    f.state = st;
+}
+
+static FetchState fetchFail(HttpFetch& f, int result) {
+    if (f.c) { f.c->stop(); netRelease(f.c, false); f.c = nullptr; }
+    f.result = result; fetchEnter(f, FETCH_FAILED);
+    return f.state;
+}
+
+void fetchBegin(HttpFetch& f, const char* host, uint16_t port, const String& req, BodySink sink, unsigned long timeoutMs) {
+    f.host = host; f.port = port; f.req = req; f.sink = sink; f.onHead = nullptr; f.timeoutMs = timeoutMs;
+    f.c = nullptr; f.reused = false; f.traced = true; f.attempt = 0; f.result = 0; f.complete = false;
+    f.body.total = 0; headInit(f.hp); f.state = FETCH_CONNECT;
+}
+
+FetchState fetchPoll(HttpFetch& f) {
+    switch (f.state) {
+    case FETCH_CONNECT:
+        // connect() and its TLS handshake are the one step that still blocks;
+        // a pooled connection skips them.
+        if (f.c) { netRelease(f.c, false); f.c = nullptr; }
+        f.c = netOpen(f.host, f.port, &f.reused);
+        if (!f.c) return fetchFail(f, -1);
+        f.c->print(f.req);
+        headInit(f.hp); f.since = millis();
+        fetchEnter(f, FETCH_HEAD);
+        return f.state;
+    case FETCH_HEAD: {
+        int r = 0;
+        for (int n = 0; n < 512 && !r && f.c->available(); n++) r = headByte(f.hp, (char)f.c->read());
+        if (r == 0) {
+            if (f.c->available() || (f.c->connected() && millis() - f.since < f.timeoutMs)) return f.state;
+            // A kept-alive socket the server had already dropped: once more on a fresh one.
+            if (f.reused && f.attempt++ == 0) { fetchEnter(f, FETCH_CONNECT); return f.state; }
+            return fetchFail(f, 0);
+        }
+        if (r < 0) return fetchFail(f, 0);
+        if (f.hp.head.code != 200) return fetchFail(f, f.hp.head.code);
+        if (f.onHead) f.sink = f.onHead(f.hp.head);
+        if (!f.sink) return fetchFail(f, 0);
+        bodyInit(f.body, f.hp.head.contentLen, f.hp.head.chunked);
+        fetchEnter(f, FETCH_BODY);
+        return f.state;
+    }
+    case FETCH_BODY: {
+        BodyState st = bodyPoll(f.body, f.c, f.sink);
+        if (st == BODY_MORE) return f.state;
+        f.complete = st == BODY_DONE;
+        netRelease(f.c, f.complete && !f.hp.head.close); f.c = nullptr;
+        f.result = f.hp.head.code; fetchEnter(f, FETCH_DONE);
+        return f.state;
+    }
+    default:
+        return f.state;
+    }
+}
+
+void fetchAbort(HttpFetch& f) {
+    if (f.state < FETCH_DONE) fetchFail(f, -2);
+}
+
+int httpExchange(const char* host, uint16_t port, const String& req, HttpHead& head, BodySink sink, unsigned long timeoutMs) {
+    HttpFetch f; fetchBegin(f, host, port, req, sink, timeoutMs);
+    while (fetchPoll(f) < FETCH_DONE) if (f.state != FETCH_CONNECT && !f.c->available()) delay(1);
+    head = f.hp.head;
+    return f.result;
+}
+
+String jinaRequest(const String& target) {
+    return String("GET /") + target + " HTTP/1.1\r\n"
+           "Host: " JINA_HOST "\r\n"
+           "User-Agent: " HTTP_USER_AGENT "\r\n"
+           "Accept-Encoding: gzip, deflate\r\n"
+           "X-Return-Format: markdown\r\n"
+           "X-No-Cache: true\r\n"
+           "Connection: keep-alive\r\n\r\n";
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include "page.h"
+
+#define DDG_LITE_HOST  "lite.duckduckgo.com"
+#define DDG_LITE_PATH  "/lite/"
+#define DDG_LITE_PORT  443
+#define JINA_HOST      "r.jina.ai"
+#define JINA_PORT      443
+#define WAYBACK_HOST   "archive.org"
+#define WAYBACK_PORT   80
+
+#define POOL_IDLE_MS   60000
+
+// The three hosts' addresses are cached here rather than looked up inside
+// every connect(). lwIP doesn't pass the record's TTL to the callback, so
+// entries live DNS_TTL_MS; a refresh after that is answered from lwIP's own
+// table if the record is still good there. A failed connect drops the entry.
+#define DNS_TTL_MS     300000
+#define DNS_TIMEOUT_MS 5000
+#define HTTP_USER_AGENT "Mozilla/5.0 (compatible; CanuckWeb/3.0)"
+
+struct HttpHead { int code; int contentLen; bool chunked; bool close; ContentCoding coding; };
+
+struct PoolStats { const char* host; uint32_t handshakes; uint32_t reuses; bool live; };
+
+// A connection is the caller's from netOpen until netRelease; a second
+// netOpen for the host meanwhile gets another slot if there is one (Jina
+// has two), else nullptr.
+WiFiClient* netOpen(const char* host, uint16_t port, bool* reused = nullptr);
+void        netRelease(WiFiClient* c, bool keepAlive);
+void        netDropAll();
+// Connects a client of the caller's own (a WiFiClientSecure for a TLS host)
+// through the same address cache. The prefetch task calls it too: at worst
+// both cores put the same lookup to lwIP.
+bool        netConnect(WiFiClient* c, const char* host, uint16_t port);
+void        dnsFlush();
+// Starts lookups for every host whose entry is missing or stale, all at
+// once, and returns; netOpen waits for one that is still in flight.
+void        dnsWarm();
+int         netStats(PoolStats* out, int max);
+bool        readHead(WiFiClient* c, HttpHead& h, unsigned long timeoutMs);
+
+// One request on a pooled connection as a state machine: fetchPoll does
+// whatever the socket allows right now and returns, so loop() keeps running
+// between polls. Past the connect it never waits; timeouts are on millis().
+// onHead, if set, sees the head before the body and returns the sink for it.
+// result is what httpExchange returns: the status, 0 if no usable head came
+// back, -1 if no connection, -2 after fetchAbort.
+enum FetchState { FETCH_CONNECT, FETCH_HEAD, FETCH_BODY, FETCH_DONE, FETCH_FAILED };
+struct HeadParser { HttpHead head; char line[128]; int len; bool first; };
+struct HttpFetch {
+    const char*   host;
+    uint16_t      port;
+    String        req;
+    BodySink      sink;
+    BodySink      (*onHead)(const HttpHead& h);
+    unsigned long timeoutMs, since;
+    FetchState    state;
+    WiFiClient*   c;
+    bool          reused, complete, traced;
+    int           attempt, result;
+    HeadParser    hp;
+    BodyReader    body;
+};
+void       fetchBegin(HttpFetch& f, const char* host, uint16_t port, const String& req, BodySink sink, unsigned long timeoutMs);
+FetchState fetchPoll(HttpFetch& f);
+void       fetchAbort(HttpFetch& f);
+
+// The blocking form: polls to the end.
+int         httpExchange(const char* host, uint16_t port, const String& req, HttpHead& head, BodySink sink, unsigned long timeoutMs);
+
+// GET for a Jina reader page, as the page load and the prefetch task send it.
+String      jinaRequest(const String& target);
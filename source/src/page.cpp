@@ -0,0 +1,1221 @@
+#include "page.h"
+#include "inflate.h"
+#include "html.h"
+#include "trace.h"
+#include "find.h"
+
+char*         g_pageSegs[PAGE_MAX_SEGS];
+size_t        g_pageLen     = 0;
+LineSpan*     g_lineSegs[LINE_MAX_SEGS];
+int           g_lineCount   = 0;
+StyleSpan*    g_spanSegs[SPAN_MAX_SEGS];
+int           g_spanCount   = 0;
+LinkEntry*    g_links       = nullptr;
+int           g_linkCount   = 0;
+int           g_resultCount = 0;
+String        currentURL    = "";
+String        baseDomain    = "";
+
+// Segment 0 may fall back to internal RAM so boards without PSRAM still get
+// a (short) page; everything past it is PSRAM or nothing.
+static void* segAlloc(size_t n, bool first) {
+    void* p=heap_caps_malloc(n,MALLOC_CAP_SPIRAM);
+    return (p||!first)?p:malloc(n);
+}
+static bool pageSeg(uint32_t s) {
+    if (s>=PAGE_MAX_SEGS) return false;
+    if (!g_pageSegs[s]) g_pageSegs[s]=(char*)segAlloc(PAGE_SEG_SIZE,s==0);
+    return g_pageSegs[s]!=nullptr;
+}
+static bool lineSeg(uint32_t s) {
+    if (s>=LINE_MAX_SEGS) return false;
+    if (!g_lineSegs[s]) g_lineSegs[s]=(LineSpan*)segAlloc(LINE_SEG_SIZE*sizeof(LineSpan),s==0);
+    return g_lineSegs[s]!=nullptr;
+}
+static bool spanSeg(uint32_t s) {
+    if (s>=SPAN_MAX_SEGS) return false;
+    if (!g_spanSegs[s]) g_spanSegs[s]=(StyleSpan*)segAlloc(SPAN_SEG_SIZE*sizeof(StyleSpan),s==0);
+    return g_spanSegs[s]!=nullptr;
+}
+
+// A page opened from flash: each segment comes in whole through the loader
+// the first time a read touches it.
+static PageLoader s_loader=nullptr;
+static bool       s_pageIn[PAGE_MAX_SEGS], s_lineIn[LINE_MAX_SEGS], s_spanIn[SPAN_MAX_SEGS];
+static void blockRewind(uint32_t at);
+
+void pageBack(PageLoader loader) {
+    s_loader=loader; blockRewind(0); findReset();
+    memset(s_pageIn,0,sizeof(s_pageIn)); memset(s_lineIn,0,sizeof(s_lineIn)); memset(s_spanIn,0,sizeof(s_spanIn));
+}
+
+static bool segIn(PageStore st, uint32_t s) {
+    bool* in=st==STORE_TEXT?s_pageIn:st==STORE_LINES?s_lineIn:s_spanIn;
+    if (!s_loader||in[s]) return true;
+    size_t seg, total; void* dst;
+    switch (st) {
+    case STORE_TEXT:  if (!pageSeg(s)) return false; seg=PAGE_SEG_SIZE; total=g_pageLen; dst=g_pageSegs[s]; break;
+    case STORE_LINES: if (!lineSeg(s)) return false; seg=LINE_SEG_SIZE*sizeof(LineSpan); total=g_lineCount*sizeof(LineSpan); dst=g_lineSegs[s]; break;
+    default:          if (!spanSeg(s)) return false; seg=SPAN_SEG_SIZE*sizeof(StyleSpan); total=g_spanCount*sizeof(StyleSpan); dst=g_spanSegs[s]; break;
+    }
+    size_t off=(size_t)s*seg, n=off<total?min(seg,total-off):0;
+    if (n&&!s_loader(st,(uint32_t)off,dst,n)) { memset(dst,0,n); return false; }
+    in[s]=true;
+    return true;
+}
+
+bool pageResident() {
+    bool ok=true;
+    for (uint32_t s=0; s_loader&&s<(g_pageLen+PAGE_SEG_SIZE-1)>>PAGE_SEG_SHIFT; s++) ok&=segIn(STORE_TEXT,s);
+    for (uint32_t s=0; s_loader&&s<(g_lineCount+LINE_SEG_SIZE-1)>>LINE_SEG_SHIFT; s++) ok&=segIn(STORE_LINES,s);
+    for (uint32_t s=0; s_loader&&s<(g_spanCount+SPAN_SEG_SIZE-1)>>SPAN_SEG_SHIFT; s++) ok&=segIn(STORE_SPANS,s);
+    s_loader=nullptr;
+    return ok;
+}
+
+void pageEnsure(int line0, int lines) {
+    if (!s_loader||g_lineCount==0) return;
+    line0=constrain(line0,0,g_lineCount-1);
+    int last=min(g_lineCount,line0+max(lines,1))-1;
+    LineSpan a, b; lineRead(line0,&a,1); lineRead(last,&b,1);
+    for (uint32_t s=a.start>>PAGE_SEG_SHIFT; s<=(b.start+b.len)>>PAGE_SEG_SHIFT&&s<PAGE_MAX_SEGS; s++) segIn(STORE_TEXT,s);
+    if (!g_spanCount) return;
+    int s0=max(spanFind(a.start),0), s1=min(spanFind(b.start+b.len)+1,g_spanCount-1);
+    for (int s=s0>>SPAN_SEG_SHIFT; s<=s1>>SPAN_SEG_SHIFT; s++) segIn(STORE_SPANS,s);
+}
+
+void pageRead(uint32_t at, char* out, size_t n) {
+    while (n) {
+        size_t off=at&(PAGE_SEG_SIZE-1), t=min(n,PAGE_SEG_SIZE-off);
+        segIn(STORE_TEXT,at>>PAGE_SEG_SHIFT);
+        memcpy(out,g_pageSegs[at>>PAGE_SEG_SHIFT]+off,t); at+=t; out+=t; n-=t;
+    }
+}
+
+
+bool pageWrite(uint32_t at, const char* p, size_t n) {
+    blockRewind(at);
+    while (n) {
+        if (!pageSeg(at>>PAGE_SEG_SHIFT)) return false;
+        size_t off=at&(PAGE_SEG_SIZE-1), t=min(n,PAGE_SEG_SIZE-off);
+        memcpy(g_pageSegs[at>>PAGE_SEG_SHIFT]+off,p,t); at+=t; p+=t; n-=t;
+    }
+    return true;
+}
+
+void lineRead(int at, LineSpan* out, int n) {
+    while (n>0) {
+        int off=at&(LINE_SEG_SIZE-1), t=min(n,(int)LINE_SEG_SIZE-off);
+        segIn(STORE_LINES,at>>LINE_SEG_SHIFT);
+        memcpy(out,g_lineSegs[at>>LINE_SEG_SHIFT]+off,t*sizeof(LineSpan)); at+=t; out+=t; n-=t;
+    }
+}
+
+bool lineWrite(int at, const LineSpan* p, int n) {
+    while (n>0) {
+        if (!lineSeg(at>>LINE_SEG_SHIFT)) return false;
+        int off=at&(LINE_SEG_SIZE-1), t=min(n,(int)LINE_SEG_SIZE-off);
+        memcpy(g_lineSegs[at>>LINE_SEG_SHIFT]+off,p,t*sizeof(LineSpan)); at+=t; p+=t; n-=t;
+    }
+    return true;
+}
+
+void spanRead(int at, StyleSpan* out, int n) {
+    while (n>0) {
+        int off=at&(SPAN_SEG_SIZE-1), t=min(n,(int)SPAN_SEG_SIZE-off);
+        segIn(STORE_SPANS,at>>SPAN_SEG_SHIFT);
+        memcpy(out,g_spanSegs[at>>SPAN_SEG_SHIFT]+off,t*sizeof(StyleSpan)); at+=t; out+=t; n-=t;
+    }
+}
+
+bool spanWrite(int at, const StyleSpan* p, int n) {
+    while (n>0) {
+        if (!spanSeg(at>>SPAN_SEG_SHIFT)) return false;
+        int off=at&(SPAN_SEG_SIZE-1), t=min(n,(int)SPAN_SEG_SIZE-off);
+        memcpy(g_spanSegs[at>>SPAN_SEG_SHIFT]+off,p,t*sizeof(StyleSpan)); at+=t; p+=t; n-=t;
+    }
+    return true;
+}
+
+// Last span starting at or before pos, -1 if pos is ahead of all of them.
+int spanFind(uint32_t pos) {
+    int lo=0, hi=g_spanCount;
+    while (lo<hi) {
+        int mid=(lo+hi)>>1;
+        segIn(STORE_SPANS,mid>>SPAN_SEG_SHIFT);
+        if (spanAt(mid).start<=pos) lo=mid+1; else hi=mid;
+    }
+    return lo-1;
+}
+
+void pageTitle(char* out, int max) {
+    out[0]=0;
+    for (int i=0; i<g_lineCount&&!out[0]; i++) {
+        LineSpan ls; lineRead(i,&ls,1);
+        int n=min((int)ls.len,max-1);
+        pageRead(ls.start,out,n); out[n]=0;
+        int a=0; while (out[a]==' ') a++;
+        while (n>a&&out[n-1]==' ') n--;
+        memmove(out,out+a,n-a); out[n-a]=0;
+    }
+}
+
+// Hands back the segments past the current page; segment 0 always stays.
+void pageTrim() {
+    for (uint32_t s=max((size_t)1,(g_pageLen+PAGE_SEG_SIZE-1)>>PAGE_SEG_SHIFT); s<PAGE_MAX_SEGS; s++)
+        if (g_pageSegs[s]) { heap_caps_free(g_pageSegs[s]); g_pageSegs[s]=nullptr; }
+    for (uint32_t s=max(1,(g_lineCount+(int)LINE_SEG_SIZE-1)>>LINE_SEG_SHIFT); s<LINE_MAX_SEGS; s++)
+        if (g_lineSegs[s]) { heap_caps_free(g_lineSegs[s]); g_lineSegs[s]=nullptr; }
+    for (uint32_t s=max(1,(g_spanCount+(int)SPAN_SEG_SIZE-1)>>SPAN_SEG_SHIFT); s<SPAN_MAX_SEGS; s++)
+        if (g_spanSegs[s]) { heap_caps_free(g_spanSegs[s]); g_spanSegs[s]=nullptr; }
+}
+
+size_t pageMemBytes() {
+    size_t n=0;
+    for (int s=0;s<PAGE_MAX_SEGS;s++) if (g_pageSegs[s]) n+=PAGE_SEG_SIZE;
+    for (int s=0;s<LINE_MAX_SEGS;s++) if (g_lineSegs[s]) n+=LINE_SEG_SIZE*sizeof(LineSpan);
+    for (int s=0;s<SPAN_MAX_SEGS;s++) if (g_spanSegs[s]) n+=SPAN_SEG_SIZE*sizeof(StyleSpan);
+    return n;
+}
+
+static bool extractAttrVal(const char* tag, const char* attr, char* out, int outLen) {
+    const char* p = strstr(tag, attr); if (!p) return false;
+    p += strlen(attr);
+    while (*p == ' ' || *p == '=') p++;
+    char q = (*p == '"' || *p == '\'') ? *p++ : 0;
+    int i = 0;
+    while (*p && i < outLen - 1) {
+        if (q && *p == q) break;
+        if (!q && (*p == ' ' || *p == '>')) break;
+        out[i++] = *p++;
+    }
+    out[i] = 0; return i > 0;
+}
+
+// Longest reference body worth buffering; the longest HTML5 name is 32.
+#define ENT_MAX 34
+
+// A reference body as page text: UTF-8, except that no-break and typographic
+// spaces become a plain (collapsing) space and invisible characters vanish.
+// -1 if unknown.
+static int refText(const char* name, int n, char* out) {
+    int k = entityDecode(name, n, out);
+    if (!k) return -1;
+    uint32_t cp; utf8Get((const uint8_t*)out, k, cp);
+    if (cp == 0xA0 || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x202F) { out[0] = ' '; return 1; }
+    if (cp == 0xAD || (cp >= 0x200B && cp <= 0x200D) || cp == 0x2060 || cp == 0xFEFF) return 0;
+    return k;
+}
+
+static void inlineStrip(char* s) {
+    char *r = s, *w = s; bool intag = false;
+    while (*r) {
+        if (*r == '<') { intag = true;  r++; continue; }
+        if (*r == '>') { intag = false; r++; continue; }
+        if (!intag) {
+            if (*r == '&') {
+                const char* semi = (const char*)memchr(r, ';', strnlen(r, ENT_MAX + 2));
+                char d[8]; int dl;
+                if (semi && (dl = refText(r + 1, semi - r - 1, d)) >= 0 && dl <= semi - r) {
+                    memcpy(w, d, dl); w += dl; r = (char*)semi + 1; continue;
+                }
+            }
+            *w++ = *r;
+        }
+        r++;
+    }
+    *w = 0;
+    r = s; w = s; bool sp = true;
+    while (*r) {
+        if (*r == '\n' || *r == '\r' || *r == '\t') *r = ' ';
+        if (*r == ' ' && sp) { r++; continue; }
+        sp = (*r == ' '); *w++ = *r++;
+    }
+    if (w > s && *(w-1) == ' ') w--;
+    *w = 0;
+}
+
+static StrPool   s_resultPool;
+static uint32_t* s_resultOff = nullptr;
+
+SearchResult resultAt(int i) {
+    SearchResult r;
+    r.title = poolAt(s_resultPool, s_resultOff[i]); r.url = r.title + strlen(r.title) + 1; r.snippet = r.url + strlen(r.url) + 1;
+    return r;
+}
+
+bool resultAdd(const char* title, const char* url, const char* snippet) {
+    if (g_resultCount >= MAX_RESULTS) return false;
+    if (!s_resultOff && !(s_resultOff = (uint32_t*)heap_caps_malloc(MAX_RESULTS * sizeof(uint32_t), MALLOC_CAP_SPIRAM)))
+        return false;
+    if (!g_resultCount) poolReset(s_resultPool);
+    size_t tl = strnlen(title, RESULT_TITLE_MAX - 1), ul = strnlen(url, RESULT_URL_MAX - 1),
+           sl = strnlen(snippet, RESULT_SNIPPET_MAX - 1);
+    uint32_t off = poolAlloc(s_resultPool, tl + ul + sl + 3);
+    if (off == POOL_NONE) return false;
+    char* p = poolAt(s_resultPool, off);
+    memcpy(p, title, tl); p[tl] = 0; p += tl + 1;
+    memcpy(p, url, ul); p[ul] = 0; p += ul + 1;
+    memcpy(p, snippet, sl); p[sl] = 0;
+    s_resultOff[g_resultCount++] = off;
+    return true;
+}
+
+int resultFind(const char* url) {
+    for (int i = 0; i < g_resultCount; i++) if (!strcmp(resultAt(i).url, url)) return i;
+    return -1;
+}
+
+size_t resultMemBytes() { return poolBytes(s_resultPool) + (s_resultOff ? MAX_RESULTS * sizeof(uint32_t) : 0); }
+
+static StrPool  s_linkPool;
+static uint32_t s_linkHosts[LINK_HOSTS];
+static int      s_linkHostCount = 0;
+
+int linkAdd(const char* url, uint32_t at) {
+    if (g_linkCount >= MAX_LINKS) return -1;
+    if (!g_linkCount) { poolReset(s_linkPool); s_linkHostCount = 0; }
+    size_t n = strnlen(url, LINK_URL_LEN - 1), h = 0;
+    if (const char* sep = strstr(url, "://")) { const char* e = strchr(sep + 3, '/'); h = e ? e - url : n; }
+    uint32_t host = POOL_NONE;
+    for (int i = 0; h && i < s_linkHostCount && host == POOL_NONE; i++) {
+        const char* k = poolAt(s_linkPool, s_linkHosts[i]);
+        if (!strncmp(k, url, h) && !k[h]) host = s_linkHosts[i];
+    }
+    if (h && host == POOL_NONE && s_linkHostCount < LINK_HOSTS && (host = poolAdd(s_linkPool, url, h)) != POOL_NONE)
+        s_linkHosts[s_linkHostCount++] = host;
+    if (host == POOL_NONE) h = 0;
+    uint32_t path = poolAdd(s_linkPool, url + h, n - h);
+    if (path == POOL_NONE) return -1;
+    g_links[g_linkCount] = {host, path, at};
+    return g_linkCount++;
+}
+
+int linkUrl(int i, char* out, int max) {
+    const LinkEntry& l = g_links[i];
+    int k = l.host == POOL_NONE ? 0 : (int)strlcpy(out, poolAt(s_linkPool, l.host), max);
+    k = min(k, max - 1);
+    return min(k + (int)strlcpy(out + k, poolAt(s_linkPool, l.path), max - k), max - 1);
+}
+
+int linkFirst(uint32_t off) {
+    int lo = 0, hi = g_linkCount;
+    while (lo < hi) { int mid = (lo + hi) >> 1; if (g_links[mid].at < off) lo = mid + 1; else hi = mid; }
+    return lo;
+}
+
+size_t linkMemBytes() { return poolBytes(s_linkPool) + MAX_LINKS * sizeof(LinkEntry); }
+
+void parseDDGLite(const String& html) {
+
+    const char* p = html.c_str();
+    const int   n = (int)html.length();
+    while (g_resultCount < MAX_RESULTS) {
+        const char* anchor = strstr(p, "result-link"); if (!anchor) break;
+        const char* aStart = anchor;
+        while (aStart > p && *aStart != '<') aStart--;
+        if (*aStart != '<') { p = anchor + 11; continue; }
+        const char* aTagEnd = strchr(aStart, '>'); if (!aTagEnd) break;
+        char href[256] = {};
+        { char tb[512] = {}; int tl = min((int)(aTagEnd - aStart), 510); memcpy(tb, aStart, tl);
+          if (!extractAttrVal(tb, "href", href, sizeof(href))) { p = aTagEnd + 1; continue; } }
+        if (strncmp(href, "http", 4) != 0) { p = aTagEnd + 1; continue; }
+        const char* ts = aTagEnd + 1;
+        const char* te = strstr(ts, "</a>");
+        char title[RESULT_TITLE_MAX] = {};
+        if (te) { int tl = min((int)(te - ts), 78); memcpy(title, ts, tl); inlineStrip(title); }
+        if (!title[0]) strcpy(title, "(no title)");
+        char snippet[RESULT_SNIPPET_MAX] = {};
+        const char* st = te ? strstr(te, "result-snippet") : nullptr;
+        if (st) {
+            const char* ss2 = strchr(st, '>');
+            if (ss2++) {
+                const char* se = strstr(ss2, "</td>"); if (!se) se = strstr(ss2, "</span>");
+                if (se) { int sl = min((int)(se - ss2), 158); memcpy(snippet, ss2, sl); inlineStrip(snippet); }
+            }
+        }
+        if (!resultAdd(title, href, snippet)) break;
+        p = te ? te + 4 : aTagEnd + 1;
+        if (p - html.c_str() >= n) break;
+    }
+}
+
+enum DdgMode { DD_IDLE, DD_TITLE, DD_WANT_SNIPPET, DD_SNIPPET };
+static DdgMode      dd_mode   = DD_IDLE;
+static bool         dd_inTag  = false;
+static char         dd_tag[512]; static int dd_tagLen = 0;
+static char         dd_raw[162]; static int dd_rawLen = 0; static int dd_rawTotal = 0;
+static int          dd_m1 = 0, dd_m2 = 0;
+static struct { char title[RESULT_TITLE_MAX]; char url[RESULT_URL_MAX]; char snippet[RESULT_SNIPPET_MAX]; } dd_cur;
+static char         dd_form[384]; static int dd_formLen = 0; static bool dd_formNext = false;
+static char         dd_next[384];
+
+static bool ddgMatch(int& m, const char* pat, char c) {
+    if (c==pat[m]) { if (!pat[++m]) { m=0; return true; } }
+    else m=(c==pat[0])?1:0;
+    return false;
+}
+
+// A url already listed (a local hit, or DDG repeating itself) isn't again.
+static void ddgCommit() {
+    if (resultFind(dd_cur.url)<0) resultAdd(dd_cur.title,dd_cur.url,dd_cur.snippet);
+    dd_mode=DD_IDLE;
+}
+
+static void ddgRawStart(DdgMode m) {
+    dd_mode=m; dd_rawLen=0; dd_rawTotal=0; dd_m1=0; dd_m2=0;
+}
+
+static void ddgRawTake(char* out, int outLen, int tailLen) {
+    int n=min(dd_rawTotal-tailLen,outLen-2); if (n<0) n=0;
+    memcpy(out,dd_raw,n); out[n]=0; inlineStrip(out);
+}
+
+// The hidden fields of each form, form-encoded; kept when the form turns out
+// to be the "Next Page" one.
+static void ddgFormTag() {
+    if (dd_tag[1]=='f') { dd_formLen=0; dd_formNext=false; return; }
+    if (dd_tag[1]=='/') { if (dd_formNext) { memcpy(dd_next,dd_form,dd_formLen); dd_next[dd_formLen]=0; } dd_formNext=false; return; }
+    char type[16]={}, name[32]={}, value[128]={};
+    extractAttrVal(dd_tag,"type",type,sizeof(type)); extractAttrVal(dd_tag,"value",value,sizeof(value));
+    inlineStrip(value);
+    if (!strcmp(type,"submit")) { dd_formNext|=!strncmp(value,"Next",4); return; }
+    if (strcmp(type,"hidden")||!extractAttrVal(dd_tag,"name",name,sizeof(name))) return;
+    char enc[3*sizeof(value)+sizeof(name)+3]; int n=snprintf(enc,sizeof(enc),"%s%s=",dd_formLen?"&":"",name);
+    for (const char* v=value;*v;v++) {
+        uint8_t c=*v;
+        if (c==' ') enc[n++]='+';
+        else if (isalnum(c)||c=='-'||c=='_'||c=='.'||c=='~') enc[n++]=c;
+        else n+=snprintf(enc+n,4,"%%%02X",c);
+    }
+    if (dd_formLen+n<(int)sizeof(dd_form)) { memcpy(dd_form+dd_formLen,enc,n); dd_formLen+=n; }
+}
+
+static void ddgTag() {
+    dd_tag[dd_tagLen]=0;
+    if (!strncmp(dd_tag,"<input",6)||!strncmp(dd_tag,"<form",5)||!strncmp(dd_tag,"</form",6)) { ddgFormTag(); return; }
+    if (!memchr(dd_tag,'-',dd_tagLen)) return;
+    if (strstr(dd_tag,"result-link")) {
+        if (dd_mode==DD_WANT_SNIPPET) ddgCommit();
+        char href[256]={};
+        if (!extractAttrVal(dd_tag,"href",href,sizeof(href))||strncmp(href,"http",4)!=0) return;
+        memset(&dd_cur,0,sizeof(dd_cur));
+        strlcpy(dd_cur.url,href,sizeof(dd_cur.url));
+        ddgRawStart(DD_TITLE);
+    } else if (dd_mode==DD_WANT_SNIPPET&&strstr(dd_tag,"result-snippet")) {
+        ddgRawStart(DD_SNIPPET);
+    }
+}
+
+static void ddgFeedChar(char c) {
+    if (dd_mode==DD_TITLE||dd_mode==DD_SNIPPET) {
+        if (dd_rawLen<(int)sizeof(dd_raw)) dd_raw[dd_rawLen++]=c;
+        dd_rawTotal++;
+        if (dd_mode==DD_TITLE) {
+            if (ddgMatch(dd_m1,"</a>",c)) {
+                ddgRawTake(dd_cur.title,sizeof(dd_cur.title),4);
+                if (!dd_cur.title[0]) strcpy(dd_cur.title,"(no title)");
+                dd_mode=DD_WANT_SNIPPET;
+            }
+        } else {
+            int tail=ddgMatch(dd_m1,"</td>",c)?5:ddgMatch(dd_m2,"</span>",c)?7:0;
+            if (tail) { ddgRawTake(dd_cur.snippet,sizeof(dd_cur.snippet),tail); ddgCommit(); }
+        }
+        return;
+    }
+    if (c=='<') { dd_inTag=true; dd_tagLen=0; dd_tag[dd_tagLen++]=c; return; }
+    if (!dd_inTag) return;
+    if (c=='>') { dd_inTag=false; ddgTag(); return; }
+    if (dd_tagLen<(int)sizeof(dd_tag)-2) dd_tag[dd_tagLen++]=c;
+}
+
+void ddgInit() {
+    dd_mode=DD_IDLE; dd_inTag=false; dd_tagLen=0; ddgRawStart(DD_IDLE);
+    dd_formLen=0; dd_formNext=false; dd_next[0]=0;
+}
+
+void ddgFeed(const char* p, size_t n) {
+    const char* end=p+n;
+    while (p<end) {
+        const char* q;
+        if (dd_mode==DD_TITLE||dd_mode==DD_SNIPPET) {
+            if (dd_m1==0&&dd_m2==0) {
+                q=(const char*)memchr(p,'<',end-p); if (!q) q=end;
+                int take=min((int)(q-p),(int)sizeof(dd_raw)-dd_rawLen);
+                if (take>0) { memcpy(dd_raw+dd_rawLen,p,take); dd_rawLen+=take; }
+                dd_rawTotal+=(int)(q-p); p=q;
+                if (p>=end) return;
+            }
+        } else if (dd_inTag) {
+            q=(const char*)memchr(p,'>',end-p); if (!q) q=end;
+            int take=min((int)(q-p),(int)sizeof(dd_tag)-2-dd_tagLen);
+            if (take>0) { memcpy(dd_tag+dd_tagLen,p,take); dd_tagLen+=take; }
+            p=q;
+            if (p>=end) return;
+        } else {
+            q=(const char*)memchr(p,'<',end-p);
+            if (!q) return;
+            p=q;
+        }
+        ddgFeedChar(*p++);
+    }
+}
+
+const char* ddgNext() { return dd_next; }
+
+void ddgFinish() {
+    if (dd_mode==DD_TITLE) { strcpy(dd_cur.title,"(no title)"); ddgCommit(); }
+    else if (dd_mode==DD_SNIPPET) { dd_cur.snippet[0]=0; ddgCommit(); }
+    else if (dd_mode==DD_WANT_SNIPPET) ddgCommit();
+    dd_mode=DD_IDLE;
+}
+
+enum StripState { SS_TEXT, SS_TAG, SS_SCRIPT, SS_STYLE, SS_HEAD, SS_COMMENT };
+static StripState ss_state = SS_TEXT; static char ss_tagBuf[128]; static int ss_tagPos = 0;
+static bool ss_inAnchor = false; static char entBuf[ENT_MAX+2]; static int entLen = 0;
+static bool inEntity = false; static int ss_dashCount = 0;
+
+static char* sw_ptr = nullptr; static size_t sw_room = 0; static char sw_last = 0;
+static PageFormat ss_format = FORMAT_HTML;
+
+static void mdInit();
+
+void stripInit(PageFormat fmt) {
+    ss_state = SS_TEXT; ss_tagPos = 0; ss_inAnchor = false;
+    inEntity = false; entLen = 0; ss_dashCount = 0;
+    memset(ss_tagBuf, 0, sizeof(ss_tagBuf)); g_pageLen = 0; g_linkCount = 0; g_spanCount = 0; blockRewind(0); pageBack(nullptr);
+    sw_ptr = nullptr; sw_room = 0; sw_last = 0;
+    ss_format = fmt; mdInit();
+    lineInit();
+}
+static bool swGrow() {
+    if (!pageSeg(g_pageLen>>PAGE_SEG_SHIFT)) return false;
+    size_t off=g_pageLen&(PAGE_SEG_SIZE-1);
+    sw_ptr=g_pageSegs[g_pageLen>>PAGE_SEG_SHIFT]+off; sw_room=PAGE_SEG_SIZE-off; return true;
+}
+static void sw(char c) {
+    if (!sw_room&&!swGrow()) return;
+    *sw_ptr++=c; sw_room--; g_pageLen++; sw_last=c;
+}
+static void sws(const char* s) { while (*s) sw(*s++); }
+static void swn(const char* s, size_t n) {
+    while (n) {
+        if (!sw_room&&!swGrow()) return;
+        size_t t=min(n,sw_room);
+        memcpy(sw_ptr,s,t); sw_ptr+=t; sw_room-=t; g_pageLen+=t; s+=t; n-=t; sw_last=s[-1];
+    }
+}
+
+static const char* rawClose(StripState s) {
+    return s==SS_SCRIPT ? "</script>" : s==SS_STYLE ? "</style>" : "</head>";
+}
+
+static bool extractHref(const char* tag, char* out, int outLen) {
+    const char* p = strstr(tag, "href"); if (!p) return false; p += 4;
+    while (*p == ' ' || *p == '=') p++;
+    char quote = (*p == '"' || *p == '\'') ? *p++ : 0;
+    int i = 0;
+    while (*p && i < outLen-1) {
+        if (quote && *p == quote) break;
+        if (!quote && (*p == ' ' || *p == '>')) break;
+        out[i++] = *p++;
+    }
+    out[i] = 0; return i > 0;
+}
+
+// href made absolute against the page, into out; false for the ones that
+// aren't worth a link number (javascript:, mailto:).
+static bool resolveURL(const char* href, char* out, int max) {
+    if (!strncmp(href, "http://", 7) || !strncmp(href, "https://", 8)) strlcpy(out, href, max);
+    else if (!strncmp(href, "//", 2)) snprintf(out, max, "https:%s", href);
+    else if (href[0] == '/') snprintf(out, max, "%s%s", baseDomain.c_str(), href);
+    else if (href[0] == '#') strlcpy(out, currentURL.c_str(), max);
+    else snprintf(out, max, "%s/%s", baseDomain.c_str(), href);
+    return strncmp(out, "javascript", 10) && strncmp(out, "mailto", 6);
+}
+
+void stripFeed(char c) {
+    switch (ss_state) {
+        case SS_SCRIPT: case SS_STYLE: case SS_HEAD: {
+            const char* close=rawClose(ss_state);
+            if (tolower(c)==close[ss_tagPos]) { if (!close[++ss_tagPos]) { ss_state=SS_TEXT; ss_tagPos=0; } }
+            else ss_tagPos=(c=='<')?1:0;
+            return;
+        }
+        case SS_COMMENT:
+            if (c=='-') ss_dashCount++;
+            else if (c=='>'&&ss_dashCount>=2) { ss_state=SS_TEXT; ss_dashCount=0; }
+            else ss_dashCount=0;
+            return;
+        case SS_TAG:
+            if (c=='>') {
+                ss_tagBuf[ss_tagPos<127?ss_tagPos:127]=0;
+                char* tag=ss_tagBuf;
+                if (tag[0]=='!') { ss_state=SS_TEXT; ss_tagPos=0; return; }
+                bool closing=(tag[0]=='/'); if (closing) tag++;
+                char name[16];int ni=0;
+                while (ni<16&&tag[ni]&&tag[ni]!=' '&&tag[ni]!='/'&&tag[ni]!='\t'&&tag[ni]!='\n') { name[ni]=(char)tolower(tag[ni]); ni++; }
+                uint8_t id=(ni<16)?tagLookup(name,ni):(uint8_t)TAG_NONE;
+                bool block=(id&TAG_BLOCK)&&g_pageLen>0&&sw_last!='\n';
+                id&=TAG_ID_MASK;
+                if (!closing) {
+                    if      (id==TAG_SCRIPT) ss_state=SS_SCRIPT;
+                    else if (id==TAG_STYLE)  ss_state=SS_STYLE;
+                    else if (id==TAG_HEAD)   ss_state=SS_HEAD;
+                    else if (id==TAG_A) {
+                        char href[LINK_URL_LEN]={};
+                        if (extractHref(tag,href,LINK_URL_LEN)&&g_linkCount<MAX_LINKS) {
+                            char res[LINK_URL_LEN];
+                            if (resolveURL(href,res,sizeof(res))&&linkAdd(res,g_pageLen)>=0) {
+                                char lbl[8]; snprintf(lbl,sizeof(lbl),"[%d]",g_linkCount);
+                                sws(lbl); ss_inAnchor=true;
+                            }
+                        }
+                        ss_state=SS_TEXT;
+                    } else {
+                        ss_state=SS_TEXT;
+                        if (block) sw('\n');
+                    }
+                } else {
+                    ss_state=SS_TEXT;
+                    if (id==TAG_A) ss_inAnchor=false;
+                    if (block) sw('\n');
+                }
+                ss_tagPos=0;
+            } else {
+                if (ss_tagPos==1&&ss_tagBuf[0]=='!'&&c=='-') { ss_state=SS_COMMENT; ss_tagPos=0; return; }
+                if (ss_tagPos<127) ss_tagBuf[ss_tagPos++]=c;
+            }
+            return;
+        case SS_TEXT:
+            if (c=='<') { ss_state=SS_TAG; ss_tagPos=0; if(inEntity){inEntity=false;entLen=0;} return; }
+            if (c=='&') { inEntity=true; entLen=0; entBuf[entLen++]=c; return; }
+            if (inEntity) {
+                if (entLen<ENT_MAX+2) entBuf[entLen++]=c;
+                if (c==';') {
+                    char d[8]; int dl=refText(entBuf+1,entLen-2,d);
+                    if (dl<0||(dl==1&&d[0]==' ')) { if(g_pageLen>0&&sw_last!=' ') sw(' '); }
+                    else swn(d,dl);
+                    inEntity=false; entLen=0;
+                } else if (entLen>ENT_MAX||c==' '||c=='\n') { inEntity=false; entLen=0; }
+                return;
+            }
+            if (c=='\r') return;
+            if (c=='\t') c=' ';
+            if (c=='\n'&&g_pageLen>0&&sw_last=='\n') return;
+            if (c==' '&&g_pageLen>0&&sw_last==' ') return;
+            if ((unsigned char)c<32&&c!='\n') return;
+            sw(c); return;
+    }
+}
+
+typedef uintptr_t swar_t;
+#define SWAR_ONES  ((swar_t)~(swar_t)0/255)
+#define SWAR_HIGH  (SWAR_ONES*0x80)
+static inline swar_t swarLess(swar_t w, uint8_t n) { return (w-SWAR_ONES*n)&~w&SWAR_HIGH; }
+static inline swar_t swarEq(swar_t w, uint8_t c)   { return swarLess(w^(SWAR_ONES*c),1); }
+
+// Length of the prefix of p that stripFeed would copy verbatim in SS_TEXT:
+// stops at '<', '&', control bytes and the second of two spaces. Flags past
+// the first real hit may be spurious, which only ends the run early.
+static size_t textRun(const uint8_t* p, size_t n) {
+    if (n&&p[0]==' '&&g_pageLen>0&&sw_last==' ') return 0;
+    size_t i=0;
+    for (; i+sizeof(swar_t)<=n; i+=sizeof(swar_t)) {
+        swar_t w; memcpy(&w,p+i,sizeof(w));
+        swar_t sp=swarEq(w,' ');
+        swar_t m=swarLess(w,0x20)|swarEq(w,'<')|swarEq(w,'&')|((sp&(sp>>8))<<8);
+        if (i&&p[i-1]==' ') m|=sp&0x80;
+        if (m) return i+(__builtin_ctzll((unsigned long long)m)>>3);
+    }
+    for (; i<n; i++) {
+        uint8_t c=p[i];
+        if (c<0x20||c=='<'||c=='&'||(c==' '&&i&&p[i-1]==' ')) return i;
+    }
+    return n;
+}
+
+static const uint8_t* findByte(const uint8_t* p, const uint8_t* end, uint8_t c) {
+    const void* q=memchr(p,c,end-p); return q?(const uint8_t*)q:end;
+}
+
+static void mdBlock(const char* p, size_t n);
+
+void stripBlock(const uint8_t* p, size_t n) {
+    if (ss_format==FORMAT_MARKDOWN) { mdBlock((const char*)p,n); return; }
+    const uint8_t* end=p+n;
+    while (p<end) {
+        const uint8_t* q=p;
+        switch (ss_state) {
+            case SS_TEXT:
+                if (!inEntity) { size_t r=textRun(p,end-p); swn((const char*)p,r); q=p+r; }
+                break;
+            case SS_TAG:
+                if (ss_tagPos>=2||(ss_tagPos==1&&ss_tagBuf[0]!='!')) {
+                    q=findByte(p,end,'>');
+                    int take=min((int)(q-p),127-ss_tagPos);
+                    if (take>0) { memcpy(ss_tagBuf+ss_tagPos,p,take); ss_tagPos+=take; }
+                }
+                break;
+            case SS_COMMENT:
+                if (ss_dashCount==0) q=findByte(p,end,'-');
+                break;
+            default:
+                if (ss_tagPos==0) q=findByte(p,end,'<');
+                break;
+        }
+        if (q>=end) break;
+        stripFeed((char)*q); p=q+1;
+    }
+}
+
+// ---- Jina markdown ----------------------------------------------------------
+//
+// Jina's markdown goes straight into the page store: one pass per line,
+// markup dropped, and a StyleSpan wherever the style changes. A paragraph
+// line is held back until the next one arrives, which is all the lookahead
+// setext headings need; lines longer than the buffer are flushed at a space.
+
+#define MD_LINE_MAX 1024
+
+enum MdKind { MK_SKIP, MK_BLANK, MK_PARA, MK_H1, MK_H2, MK_H3, MK_BULLET, MK_LIST, MK_QUOTE, MK_RULE,
+              MK_ROW, MK_FENCE, MK_SETEXT1, MK_SETEXT2, MK_PRE, MK_CONT };
+
+static char   md_cur[MD_LINE_MAX];  static int md_curLen  = 0;
+static char   md_held[MD_LINE_MAX]; static int md_heldLen = 0;
+static bool   md_hold = false, md_fence = false, md_pre = true, md_mid = false;
+static MdKind md_last = MK_BLANK;
+static uint8_t md_block = BLK_TEXT;
+
+static void mdInit() {
+    md_curLen = md_heldLen = 0; md_hold = md_fence = md_mid = false; md_pre = true;
+    md_last = MK_BLANK; md_block = BLK_TEXT;
+}
+
+static void spanMark(uint8_t style, uint16_t link) {
+    if (g_spanCount>0) {
+        StyleSpan& l=spanAt(g_spanCount-1);
+        if (l.start==g_pageLen) {
+            l.style=style; l.link=link;
+            StyleSpan prev=g_spanCount>1?spanAt(g_spanCount-2):StyleSpan{0,BLK_TEXT,0};
+            if (prev.style==style&&prev.link==link) g_spanCount--;
+            return;
+        }
+        if (l.style==style&&l.link==link) return;
+    } else if (style==BLK_TEXT) return;
+    if (g_spanCount<(int)MAX_SPANS&&spanSeg(g_spanCount>>SPAN_SEG_SHIFT)) spanAt(g_spanCount++)={(uint32_t)g_pageLen,style,link};
+}
+
+static size_t textRun(const uint8_t* p, size_t n);
+
+// Plain text: tabs to spaces, runs of spaces collapsed, control bytes dropped.
+static void mdText(const char* s, size_t n) {
+    while (n) {
+        size_t r=textRun((const uint8_t*)s,n); swn(s,r); s+=r; n-=r;
+        if (!n) break;
+        char c=*s++; n--;
+        if (c==' '||c=='\t') { if (g_pageLen>0&&sw_last!=' '&&sw_last!='\n') sw(' '); }
+        else if ((uint8_t)c>=32) sw(c);
+    }
+}
+
+static const uint32_t md_special[8] = { 0, 0x00000402, 0x98000000, 0x00000001 };   // ! * [ \\ _ `
+static inline bool mdSpecial(char c) { return md_special[(uint8_t)c>>5]>>((uint8_t)c&31)&1; }
+
+// Index of the ']' matching s[0]=='[' or the ')' matching '(', or -1.
+static int mdClose(const char* s, int n, char open, char close) {
+    int depth=0;
+    for (int i=0;i<n;i++) {
+        if (s[i]=='\\') { i++; continue; }
+        if (s[i]==open) depth++;
+        else if (s[i]==close&&--depth==0) return i;
+    }
+    return -1;
+}
+
+static void mdInline(const char* s, int n, uint8_t style, uint16_t link);
+
+// Links and emphasis nest by recursion; past MD_INLINE_DEPTH levels the rest
+// is plain text, so a hostile line can't run the stack out. The url buffers
+// live out here, not in each frame.
+#define MD_INLINE_DEPTH 6
+static int  md_depth = 0;
+static char md_href[LINK_URL_LEN], md_res[LINK_URL_LEN];
+
+// [text](url): registers the link like an <a href> would and writes its [n]
+// marker and text in link style. Images, ![alt](src), are dropped.
+static int mdLink(const char* s, int n, uint8_t style, bool image) {
+    int rb=mdClose(s,n,'[',']');
+    if (rb<0||rb+1>=n||s[rb+1]!='(') return 0;
+    int rp=mdClose(s+rb+1,n-rb-1,'(',')'); if (rp<0) return 0;
+    int end=rb+1+rp+1;
+    if (image) return end;
+    const char* u=s+rb+2; int ul=rp-1;
+    while (ul>0&&*u==' ') { u++; ul--; }
+    int k=0; while (k<ul&&u[k]!=' ') k++;
+    if (k>0&&k<LINK_URL_LEN&&g_linkCount<MAX_LINKS) {
+        memcpy(md_href,u,k); md_href[k]=0;
+        if (resolveURL(md_href,md_res,sizeof(md_res))&&linkAdd(md_res,g_pageLen)>=0) {
+            uint16_t id=(uint16_t)g_linkCount;
+            char lbl[8]; snprintf(lbl,sizeof(lbl),"[%d]",g_linkCount);
+            spanMark(style|STY_LINK,id); sws(lbl);
+            mdInline(s+1,rb-1,style|STY_LINK,id);
+            spanMark(style,0);
+            return end;
+        }
+    }
+    mdInline(s+1,rb-1,style,0);
+    return end;
+}
+
+// *em*, **bold**, _em_, __bold__, `code`. An opener without a closer on the
+// same line is just text; underscores inside words never open.
+static int mdEmph(const char* s, int n, uint8_t style, uint16_t link) {
+    char m=s[0]; int k=(n>1&&s[1]==m)?2:1;
+    if (k>=n||s[k]==' ') return 0;
+    for (int i=k+1;i+k<=n;i++) {
+        if (s[i]=='\\') { i++; continue; }
+        if (s[i]!=m||s[i-1]==' ') continue;
+        if (k==2&&s[i+1]!=m) continue;
+        if (k==1&&i+1<n&&s[i+1]==m) { i++; continue; }
+        if (m=='_'&&i+k<n&&isalnum((uint8_t)s[i+k])) continue;
+        uint8_t st=style|(k==2?STY_BOLD:STY_EM);
+        spanMark(st,link); mdInline(s+k,i-k,st,link); spanMark(style,link);
+        return i+k;
+    }
+    return 0;
+}
+
+static void mdInline(const char* s, int n, uint8_t style, uint16_t link) {
+    if (md_depth>=MD_INLINE_DEPTH) { mdText(s,n); return; }
+    md_depth++;
+    int i=0;
+    while (i<n) {
+        int j=i; while (j<n&&!mdSpecial(s[j])) j++;
+        if (j>i) { mdText(s+i,j-i); i=j; if (i>=n) break; }
+        char c=s[i]; int used=0;
+        if (c=='\\'&&i+1<n&&ispunct((uint8_t)s[i+1])) { mdText(s+i+1,1); i+=2; continue; }
+        if (c=='[') used=mdLink(s+i,n-i,style,false);
+        else if (c=='!'&&i+1<n&&s[i+1]=='[') { used=mdLink(s+i+1,n-i-1,style,true); if (used) used++; }
+        else if (c=='`') {
+            const char* q=(const char*)memchr(s+i+1,'`',n-i-1);
+            if (q) {
+                spanMark(style|STY_CODE,link); mdText(s+i+1,q-s-i-1); spanMark(style,link);
+                used=(int)(q-s)+1-i;
+            }
+        } else if ((c=='*'||c=='_')&&(c=='*'||i==0||!isalnum((uint8_t)s[i-1]))) used=mdEmph(s+i,n-i,style,link);
+        if (used>0) { i+=used; continue; }
+        mdText(s+i,1); i++;
+    }
+    md_depth--;
+}
+
+static const char* mdSkipSp(const char* s, const char* e) { while (s<e&&(*s==' '||*s=='\t')) s++; return s; }
+
+static bool mdAll(const char* s, const char* e, char c, int min) {
+    int k=0;
+    for (;s<e;s++) { if (*s==c) k++; else if (*s!=' ') return false; }
+    return k>=min;
+}
+
+// Block kind of one raw line; its content is [*body, *end).
+static MdKind mdClassify(const char* s, int n, const char** body, const char** end) {
+    const char* e=s+n;
+    const char* t=mdSkipSp(s,e);
+    *body=t; *end=e;
+    if (md_fence) { if (e-t>=3&&(!strncmp(t,"```",3)||!strncmp(t,"~~~",3))) return MK_FENCE; *body=s; return MK_PRE; }
+    if (t==e) return MK_BLANK;
+    if (md_pre) {
+        static const char* pre[]={"Title:","URL Source:","Published Time:","Warning:","Markdown Content:",nullptr};
+        for (int i=0;pre[i];i++) if (!strncmp(t,pre[i],strlen(pre[i]))) { if (i==4) md_pre=false; return MK_SKIP; }
+        md_pre=false;
+    }
+    if (e-t>=3&&(!strncmp(t,"```",3)||!strncmp(t,"~~~",3))) return MK_FENCE;
+    if (*t=='#') {
+        int h=0; while (t+h<e&&t[h]=='#') h++;
+        if (h<=6&&(t+h==e||t[h]==' ')) {
+            const char* b=mdSkipSp(t+h,e);
+            while (e>b&&(e[-1]=='#'||e[-1]==' ')) e--;
+            *body=b; *end=e;
+            return h==1?MK_H1:h==2?MK_H2:MK_H3;
+        }
+    }
+    if (mdAll(t,e,'=',3)) return MK_SETEXT1;
+    if (mdAll(t,e,'-',3)) return MK_SETEXT2;
+    if (mdAll(t,e,'*',3)||mdAll(t,e,'_',3)) return MK_RULE;
+    if ((*t=='*'||*t=='-'||*t=='+')&&t+1<e&&t[1]==' ') { *body=mdSkipSp(t+1,e); return MK_BULLET; }
+    if (isdigit((uint8_t)*t)) {
+        const char* d=t; while (d<e&&isdigit((uint8_t)*d)) d++;
+        if (d-t<4&&d+1<e&&(*d=='.'||*d==')')&&d[1]==' ') return MK_LIST;
+    }
+    if (*t=='>') { *body=mdSkipSp(t+1,e); return MK_QUOTE; }
+    if (*t=='|') {
+        const char* q=t; while (q<e&&strchr("|-: ",*q)) q++;
+        return (q==e&&memchr(t,'-',e-t)) ? MK_SKIP : MK_ROW;
+    }
+    return MK_PARA;
+}
+
+static uint8_t mdBlockOf(MdKind k) {
+    switch (k) {
+        case MK_H1: case MK_SETEXT1: return BLK_H1;
+        case MK_H2: case MK_SETEXT2: return BLK_H2;
+        case MK_H3:    return BLK_H3;
+        case MK_QUOTE: return BLK_QUOTE;
+        case MK_PRE:   return BLK_PRE;
+        case MK_RULE:  return BLK_RULE;
+        default:       return BLK_TEXT;
+    }
+}
+
+// Consecutive paragraph lines (and lazy continuations of a list item or
+// quote) are one paragraph: joined with a space, keeping the first's block.
+static bool mdJoins(MdKind prev, MdKind k) {
+    return (k==MK_PARA&&(prev==MK_PARA||prev==MK_BULLET||prev==MK_LIST||prev==MK_QUOTE))||(k==MK_QUOTE&&prev==MK_QUOTE);
+}
+
+// Code block lines keep their indentation.
+static void mdRaw(const char* s, int n) {
+    for (int i=0;i<n;i++) { char c=s[i]=='\t'?' ':s[i]; if ((uint8_t)c>=32) sw(c); }
+}
+
+static void mdEmit(MdKind k, const char* body, int n) {
+    if (k==MK_CONT) { if (md_block==BLK_PRE) mdRaw(body,n); else mdInline(body,n,md_block,0); return; }
+    if (mdJoins(md_last,k)) { if (g_pageLen>0&&sw_last!=' '&&sw_last!='\n') sw(' '); }
+    else {
+        if (g_pageLen>0&&sw_last!='\n') sw('\n');
+        md_block=mdBlockOf(k);
+    }
+    md_last=k;
+    spanMark(md_block,0);
+    if (k==MK_BULLET) sws("- ");
+    if (k==MK_RULE) { sw('-'); return; }
+    if (k==MK_PRE) { mdRaw(body,n); return; }
+    mdInline(body,n,md_block,0);
+}
+
+static void mdFlushHeld() {
+    if (!md_hold) return;
+    md_hold=false; mdEmit(MK_PARA,md_held,md_heldLen);
+}
+
+static void mdLine(const char* s, int n) {
+    while (n>0&&s[n-1]=='\r') n--;
+    if (md_mid) { md_mid=false; mdEmit(MK_CONT,s,n); return; }
+    const char *body, *end; MdKind k=mdClassify(s,n,&body,&end);
+    int bn=(int)(end-body);
+    if (k==MK_SETEXT1||k==MK_SETEXT2) {
+        if (md_hold) { md_hold=false; md_last=MK_BLANK; mdEmit(k,md_held,md_heldLen); return; }
+        k=(k==MK_SETEXT2)?MK_RULE:MK_PARA; if (k==MK_PARA) { body=s; bn=n; }
+    }
+    mdFlushHeld();
+    switch (k) {
+        case MK_SKIP:  return;
+        case MK_BLANK: md_last=MK_BLANK; if (g_pageLen>0&&sw_last!='\n') sw('\n'); return;
+        case MK_FENCE: md_fence=!md_fence; md_last=MK_BLANK; if (g_pageLen>0&&sw_last!='\n') sw('\n'); return;
+        case MK_PARA:  memcpy(md_held,body,bn); md_heldLen=bn; md_hold=true; return;
+        default:       break;
+    }
+    mdEmit(k,body,bn);
+}
+
+// A line longer than the buffer: emit what we have up to the last space and
+// carry on with the rest as a continuation of the same line.
+static void mdOverflow() {
+    int cut=md_curLen; while (cut>MD_LINE_MAX/2&&md_cur[cut-1]!=' ') cut--;
+    if (cut<=MD_LINE_MAX/2) cut=md_curLen;
+    if (md_mid) mdEmit(MK_CONT,md_cur,cut);
+    else {
+        const char *body, *end; MdKind k=mdClassify(md_cur,cut,&body,&end);
+        if (k==MK_SETEXT1||k==MK_SETEXT2||k==MK_BLANK||k==MK_SKIP||k==MK_FENCE) { k=MK_PARA; body=md_cur; end=md_cur+cut; }
+        mdFlushHeld();
+        mdEmit(k,body,(int)(end-body));
+        md_mid=true;
+    }
+    memmove(md_cur,md_cur+cut,md_curLen-cut); md_curLen-=cut;
+}
+
+static void mdBlock(const char* p, size_t n) {
+    const char* end=p+n;
+    while (p<end) {
+        const char* q=(const char*)memchr(p,'\n',end-p);
+        const char* stop=q?q:end;
+        while (p<stop) {
+            int take=min((int)(stop-p),MD_LINE_MAX-md_curLen);
+            memcpy(md_cur+md_curLen,p,take); md_curLen+=take; p+=take;
+            if (md_curLen==MD_LINE_MAX) mdOverflow();
+        }
+        if (!q) break;
+        mdLine(md_cur,md_curLen); md_curLen=0; p=q+1;
+    }
+}
+
+// Flushes the held-back paragraph and any unterminated last line.
+void stripFinish() {
+    if (ss_format!=FORMAT_MARKDOWN) return;
+    if (md_curLen>0) { mdLine(md_cur,md_curLen); md_curLen=0; }
+    mdFlushHeld();
+}
+
+#define MAX_RAW                   ((int)(2 * PAGE_MAX_BYTES))
+#define BODY_POLL_BYTES           4096
+
+enum { BR_DATA, BR_SIZE, BR_CRLF, BR_TRAILER };
+
+void bodyInit(BodyReader& r, int contentLen, bool chunked) {
+    r.left=chunked?0:contentLen>0?contentLen:MAX_RAW; r.total=0; r.contentLen=contentLen;
+    r.st=chunked?BR_SIZE:BR_DATA; r.chunked=chunked; r.any=false; r.lineLen=0; r.lastData=millis();
+}
+
+// Chunked bodies walk size line -> data -> CRLF -> size line ... until a zero
+// size, then the trailer up to its blank line, so the next response on a
+// kept-alive connection starts clean.
+BodyState bodyPoll(BodyReader& r, Stream* s, BodySink sink) {
+    if (!r.chunked&&r.contentLen==0) return BODY_DONE;
+    uint8_t buf[512]; int budget=BODY_POLL_BYTES;
+    while (budget>0) {
+        int avail=s->available();
+        if (avail<=0) {
+            unsigned long limit=r.any?STREAM_IDLE_TIMEOUT:STREAM_FIRST_BYTE_TIMEOUT;
+            if (millis()-r.lastData<limit) return BODY_MORE;
+            return r.st==BR_TRAILER?BODY_DONE:BODY_SHORT;
+        }
+        r.any=true; r.lastData=millis();
+        if (r.st==BR_DATA) {
+            int got=(int)s->readBytes(buf,min(min(r.left,(int)sizeof(buf)),min(avail,budget)));
+            if (got<=0) return BODY_SHORT;
+            if (!sink(buf,got)) return BODY_STOPPED;
+            r.left-=got; r.total+=got; budget-=got;
+            if (r.total>=MAX_RAW) return BODY_SHORT;
+            if (r.left==0) { if (!r.chunked) return r.contentLen>0?BODY_DONE:BODY_SHORT; r.st=BR_CRLF; }
+            continue;
+        }
+        char c=(char)s->read(); budget--;
+        if (c=='\r') continue;
+        if (r.st==BR_CRLF) { if (c!='\n') return BODY_SHORT; r.st=BR_SIZE; continue; }
+        if (c!='\n') { if (r.lineLen<(int)sizeof(r.line)-1) r.line[r.lineLen++]=c; continue; }
+        if (r.st==BR_TRAILER) { if (r.lineLen==0) return BODY_DONE; r.lineLen=0; continue; }
+        r.line[r.lineLen]=0; char* e; long n=strtol(r.line,&e,16);
+        if (e==r.line||n<0) return BODY_SHORT;
+        r.lineLen=0;
+        if (n==0) r.st=BR_TRAILER; else { r.left=(int)min(n,(long)MAX_RAW); r.st=BR_DATA; }
+    }
+    return BODY_MORE;
+}
+
+bool readBody(Stream* s, int contentLen, bool chunked, BodySink sink) {
+    BodyReader r; bodyInit(r,contentLen,chunked);
+    for (;;) {
+        BodyState st=bodyPoll(r,s,sink);
+        if (st!=BODY_MORE) return st==BODY_DONE;
+        if (!s->available()) delay(1);
+    }
+}
+
+static BodySink s_stripTap=nullptr;
+static bool stripSink(const uint8_t* p, size_t n) {
+    { TraceScope t(TR_STRIP); stripBlock(p,n); }
+    { TraceScope t(TR_LINES); lineFeed(false); }
+    return !s_stripTap||s_stripTap(p,n);
+}
+
+static bool inflateSink(const uint8_t* p, size_t n) { TraceScope t(TR_INFLATE); return inflateFeed(p,n); }
+
+BodySink streamBegin(BodySink tap, ContentCoding coding, PageFormat fmt) {
+    stripInit(fmt); s_stripTap=tap;
+    if (coding==CODING_IDENTITY) return stripSink;
+    return inflateInit(coding,stripSink)?inflateSink:nullptr;
+}
+
+bool streamEnd() { s_stripTap=nullptr; stripFinish(); return g_pageLen>5; }
+
+// Raw (still coded) bytes in one PSRAM block that doubles as it fills.
+static uint8_t*      s_spool=nullptr;
+static size_t        s_spoolLen=0, s_spoolCap=0, s_spoolBudget=0;
+static ContentCoding s_spoolCoding=CODING_IDENTITY;
+static BodySink      s_spoolOut=nullptr;
+
+void spoolFree() {
+    heap_caps_free(s_spool); s_spool=nullptr;
+    s_spoolLen=s_spoolCap=0; s_spoolOut=nullptr;
+}
+
+void spoolBegin(size_t budget, ContentCoding coding) { spoolFree(); s_spoolBudget=budget; s_spoolCoding=coding; }
+
+bool spoolSink(const uint8_t* p, size_t n) {
+    if (s_spoolOut) return s_spoolOut(p,n);
+    if (s_spoolLen+n>s_spoolBudget) return false;
+    if (s_spoolLen+n>s_spoolCap) {
+        size_t cap=min(max(max(s_spoolCap*2,(size_t)16384),s_spoolLen+n),s_spoolBudget);
+        uint8_t* q=(uint8_t*)heap_caps_realloc(s_spool,cap,MALLOC_CAP_SPIRAM); if (!q) return false;
+        s_spool=q; s_spoolCap=cap;
+    }
+    memcpy(s_spool+s_spoolLen,p,n); s_spoolLen+=n;
+    return true;
+}
+
+bool spoolDrain(BodySink tap, PageFormat fmt) {
+    BodySink out=streamBegin(tap,s_spoolCoding,fmt);
+    bool ok=out!=nullptr;
+    for (size_t at=0; ok&&at<s_spoolLen; at+=BODY_POLL_BYTES) ok=out(s_spool+at,min((size_t)BODY_POLL_BYTES,s_spoolLen-at));
+    heap_caps_free(s_spool); s_spool=nullptr; s_spoolCap=0;
+    s_spoolOut=out;
+    return ok;
+}
+
+size_t spoolBytes() { return s_spoolLen; }
+
+bool readStream(Stream* s, int contentLen, bool chunked, bool* complete, BodySink tap, ContentCoding coding, PageFormat fmt) {
+    TraceScope t(TR_BODY);
+    BodySink sink=streamBegin(tap,coding,fmt);
+    bool done=sink&&readBody(s,contentLen,chunked,sink);
+    if (complete) *complete=done;
+    return streamEnd();
+}
+
+bool stripBuffer(const uint8_t* p, size_t n, ContentCoding coding, PageFormat fmt) {
+    TraceScope t(TR_STRIP);
+    stripInit(fmt);
+    if (coding==CODING_IDENTITY) stripBlock(p,n);
+    else if (inflateInit(coding,stripSink)) inflateFeed(p,n);
+    stripFinish();
+    return g_pageLen>5;
+}
+
+ContentCoding parseCoding(const char* ce) {
+    if (!ce) return CODING_IDENTITY;
+    if (strcasestr(ce,"gzip")) return CODING_GZIP;
+    if (strcasestr(ce,"deflate")) return CODING_DEFLATE;
+    return CODING_IDENTITY;
+}
+
+static uint32_t lc_pos=0, lc_ls=0;
+static int      lc_col=0, lc_cols=CONT_COLS, lc_span=-1;
+static uint8_t  lc_block=BLK_TEXT;
+static bool     lc_skip=false;
+
+void lineInit() { g_lineCount=0; lc_pos=lc_ls=0; lc_col=0; lc_cols=CONT_COLS; lc_span=-1; lc_block=BLK_TEXT; lc_skip=false; }
+
+// Headings are drawn in FONT4 (H1, two rows) and FONT2, so they wrap sooner.
+static int blockCols(uint8_t b) {
+    return b==BLK_H1 ? 20 : (b==BLK_H2||b==BLK_H3) ? 36 : b==BLK_QUOTE ? CONT_COLS-1 : CONT_COLS;
+}
+
+// Spans are written before the text they cover, so by the time a line's
+// first byte is here its style is known.
+static uint8_t blockAt(uint32_t p) {
+    while (lc_span+1<g_spanCount&&spanAt(lc_span+1).start<=p) lc_span++;
+    return lc_span>=0 ? (spanAt(lc_span).style&BLK_MASK) : BLK_TEXT;
+}
+
+static void linePush(uint32_t ls, uint32_t len) {
+    if (len==0) return;
+    if (g_lineCount<(int)MAX_LINES&&lineSeg(g_lineCount>>LINE_SEG_SHIFT)) lineAt(g_lineCount++)={ls,(uint16_t)len,lc_block,0};
+    if (lc_block==BLK_H1&&g_lineCount<(int)MAX_LINES&&lineSeg(g_lineCount>>LINE_SEG_SHIFT)) lineAt(g_lineCount++)={ls,(uint16_t)len,lc_block,1};
+}
+
+// Lines are counted in display cells, not bytes (see utf8Cell). A line is
+// broken when the first cell that doesn't fit arrives, so the break never
+// lands inside a code point and a line that exactly fills the row stays whole.
+void lineFeed(bool final) {
+    while (lc_pos<g_pageLen&&g_lineCount<(int)MAX_LINES) {
+        char c=pageAt(lc_pos);
+        if (lc_skip) { if(c==' '){lc_ls=++lc_pos;continue;} lc_skip=false; }
+        if (lc_pos==lc_ls) { lc_block=blockAt(lc_ls); lc_cols=blockCols(lc_block); }
+        if (c=='\n') { linePush(lc_ls,lc_pos-lc_ls); lc_ls=++lc_pos; lc_col=0; continue; }
+        bool cell=utf8Cell((uint8_t)c);
+        if (cell&&lc_col>=lc_cols) {
+            uint32_t wrapAt=lc_pos;
+            for(int b=(int)lc_pos-1;b>(int)lc_ls;b--) if(pageAt(b)==' '){wrapAt=(uint32_t)(b+1);break;}
+            linePush(lc_ls,wrapAt-lc_ls);
+            lc_pos=lc_ls=wrapAt; lc_col=0; lc_skip=true;
+            continue;
+        }
+        lc_col+=cell; lc_pos++;
+    }
+    if (final&&lc_pos>=g_pageLen&&lc_ls<g_pageLen) { linePush(lc_ls,g_pageLen-lc_ls); lc_ls=lc_pos=g_pageLen; lc_col=0; }
+    findFeed(final);
+}
+
+void buildLineCache() { TraceScope t(TR_LINES); lineInit(); lineFeed(true); }
+
+void updateBaseDomain(const String& url) {
+    int se=url.indexOf("://"); if(se<0){baseDomain="https://"+url;return;}
+    int he=url.indexOf('/',se+3); baseDomain=(he<0)?url:url.substring(0,he);
+}
+
+// Blocked-page signatures, lower case. The page text is matched against all
+// of them in one Aho-Corasick pass as it is stripped: the trie of the
+// signatures with its fail links folded into a full transition table, so
+// each byte is one lookup. Bytes map to the 28 characters the signatures use
+// (either case) or to class 0; the trie has 241 states.
+static const char* const BLOCK_SIGS[]={
+    "enable javascript","please enable","access denied","subscribe to continue",
+    "subscribe to read","sign in to read","create an account","log in to continue",
+    "you've reached your","premium content","403 forbidden","just a moment",
+    "checking your browser","ddos protection","ray id","verifying you are human",nullptr
+};
+#define AC_STATES  256
+#define AC_CLASSES 32
+
+static uint8_t  ac_class[256];
+static uint8_t  ac_next[AC_STATES][AC_CLASSES];
+static bool     ac_out[AC_STATES];          // a signature ends here or along the fail chain
+static bool     ac_built=false;
+static uint8_t  ac_state=0;
+static uint32_t ac_scanned=0;
+static bool     ac_hit=false;
+
+static void acBuild() {
+    int states=1, classes=1;
+    for (int i=0;BLOCK_SIGS[i];i++)
+        for (const char* p=BLOCK_SIGS[i];*p;p++)
+            if (!ac_class[(uint8_t)*p]) { ac_class[(uint8_t)*p]=ac_class[toupper((uint8_t)*p)]=(uint8_t)classes++; }
+    // The trie first; 0 means no edge yet, as nothing in it leads back to the root.
+    for (int i=0;BLOCK_SIGS[i];i++) {
+        uint8_t st=0;
+        for (const char* p=BLOCK_SIGS[i];*p;p++) {
+            uint8_t& k=ac_next[st][ac_class[(uint8_t)*p]];
+            if (!k) k=(uint8_t)states++;
+            st=k;
+        }
+        ac_out[st]=true;
+    }
+    // Then breadth first, so a state's fail row is complete before its own:
+    // an edge the trie lacks is whatever the fail state does on that class.
+    uint8_t fail[AC_STATES], q[AC_STATES]; int h=0,t=0;
+    for (int c=1;c<classes;c++) if (uint8_t k=ac_next[0][c]) { fail[k]=0; q[t++]=k; }
+    while (h<t) {
+        uint8_t st=q[h++];
+        ac_out[st]|=ac_out[fail[st]];
+        for (int c=1;c<classes;c++) {
+            uint8_t k=ac_next[st][c];
+            if (k) { fail[k]=ac_next[fail[st]][c]; q[t++]=k; }
+            else ac_next[st][c]=ac_next[fail[st]][c];
+        }
+    }
+    ac_built=true;
+}
+
+// Text under the scan was rewritten: start over from the top.
+static void blockRewind(uint32_t at) {
+    if (at<ac_scanned||at==0) { ac_state=0; ac_scanned=0; ac_hit=false; }
+}
+
+// Catches up on whatever the stripper added to the first BLOCK_SCAN_BYTES.
+bool pageBlockHit() {
+    if (!ac_built) acBuild();
+    uint32_t end=min((uint32_t)g_pageLen,(uint32_t)BLOCK_SCAN_BYTES);
+    if (end<ac_scanned) blockRewind(0);
+    char buf[256];
+    while (ac_scanned<end&&!ac_hit) {
+        uint32_t n=min(end-ac_scanned,(uint32_t)sizeof(buf));
+        pageRead(ac_scanned,buf,n); ac_scanned+=n;
+        uint8_t st=ac_state;
+        for (uint32_t i=0;i<n&&!ac_out[st];i++) st=ac_next[st][ac_class[(uint8_t)buf[i]]];
+        ac_state=st; ac_hit=ac_out[st];
+    }
+    return ac_hit;
+}
+
+bool pageIsBlocked() { return g_pageLen<10||pageBlockHit(); }
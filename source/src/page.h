@@ -0,0 +1,180 @@
+#pragma once
+#include <Arduino.h>
+#include "pool.h"
+
+#define SCREEN_W     320
+#define SCREEN_H     240
+#define CHAR_W         8
+#define CHAR_H        16
+#define STAT_H        16
+#define HINT_H        16
+#define CONT_Y        STAT_H
+#define CONT_H        (SCREEN_H - STAT_H - HINT_H)
+#define CONT_ROWS     (CONT_H / CHAR_H)
+#define CONT_COLS     (SCREEN_W / CHAR_W)
+#define HINT_Y        (SCREEN_H - HINT_H)
+
+// Page text and its line index live in fixed-size PSRAM segments that are
+// allocated as the page grows, so a long article costs what it uses and no
+// single allocation has to be contiguous.
+#define PAGE_SEG_SHIFT    16
+#define PAGE_SEG_SIZE     (1u << PAGE_SEG_SHIFT)
+#define PAGE_MAX_SEGS     128
+#define PAGE_MAX_BYTES    ((size_t)PAGE_SEG_SIZE * PAGE_MAX_SEGS)
+#define LINE_SEG_SHIFT    12
+#define LINE_SEG_SIZE     (1u << LINE_SEG_SHIFT)
+#define LINE_MAX_SEGS     256
+#define MAX_LINES         (LINE_SEG_SIZE * LINE_MAX_SEGS)
+#define SPAN_SEG_SHIFT    12
+#define SPAN_SEG_SIZE     (1u << SPAN_SEG_SHIFT)
+#define SPAN_MAX_SEGS     256
+#define MAX_SPANS         (SPAN_SEG_SIZE * SPAN_MAX_SEGS)
+#define MAX_LINKS        4096
+#define LINK_URL_LEN      256
+#define LINK_HOSTS        32                // distinct hosts shared per page
+#define MAX_RESULTS       300               // ten DDG Lite pages
+#define RESULT_TITLE_MAX  80
+#define RESULT_URL_MAX    256
+#define RESULT_SNIPPET_MAX 160
+
+enum ContentCoding  { CODING_IDENTITY, CODING_GZIP, CODING_DEFLATE };
+enum PageFormat     { FORMAT_HTML, FORMAT_MARKDOWN };
+
+// Style byte of a StyleSpan: the block kind of the line in the low nibble,
+// inline flags above it. A span runs until the next one starts.
+enum {
+    BLK_TEXT, BLK_H1, BLK_H2, BLK_H3, BLK_QUOTE, BLK_PRE, BLK_RULE, BLK_MASK = 0x0F,
+    STY_BOLD = 0x10, STY_EM = 0x20, STY_CODE = 0x40, STY_LINK = 0x80
+};
+
+// block and cont sit in what used to be padding; cont marks the second row
+// of a two-row (FONT4) heading.
+struct LineSpan     { uint32_t start; uint16_t len; uint8_t block; uint8_t cont; };
+struct StyleSpan    { uint32_t start; uint8_t style; uint16_t link; };
+// A link's url is its host ("https://a.b", shared by every link to it) and
+// the rest, both in the page's string pool; host is POOL_NONE once the page
+// has had LINK_HOSTS of them, and path then holds the whole url. at is where
+// its "[n]" label starts in the text; links are added in text order, so the
+// table is sorted on it.
+struct LinkEntry    { uint32_t host, path, at; };
+// Search results live packed in PSRAM (resultAdd); this is a view of one.
+struct SearchResult { const char* title; const char* url; const char* snippet; };
+
+extern char*         g_pageSegs[PAGE_MAX_SEGS];
+extern size_t        g_pageLen;
+extern LineSpan*     g_lineSegs[LINE_MAX_SEGS];
+extern int           g_lineCount;
+extern StyleSpan*    g_spanSegs[SPAN_MAX_SEGS];
+extern int           g_spanCount;
+extern LinkEntry*    g_links;
+extern int           g_linkCount;
+extern int           g_resultCount;
+extern String        currentURL;
+extern String        baseDomain;
+
+inline char      pageAt(uint32_t p) { return g_pageSegs[p >> PAGE_SEG_SHIFT][p & (PAGE_SEG_SIZE - 1)]; }
+inline LineSpan& lineAt(int i)      { return g_lineSegs[i >> LINE_SEG_SHIFT][i & (LINE_SEG_SIZE - 1)]; }
+inline StyleSpan& spanAt(int i)     { return g_spanSegs[i >> SPAN_SEG_SHIFT][i & (SPAN_SEG_SIZE - 1)]; }
+void   pageRead(uint32_t at, char* out, size_t n);
+bool   pageWrite(uint32_t at, const char* p, size_t n);
+void   lineRead(int at, LineSpan* out, int n);
+bool   lineWrite(int at, const LineSpan* p, int n);
+void   spanRead(int at, StyleSpan* out, int n);
+bool   spanWrite(int at, const StyleSpan* p, int n);
+int    spanFind(uint32_t pos);
+void   pageTrim();
+// The first line with any text, trimmed, as a title.
+void   pageTitle(char* out, int max);
+
+// A page can stay in a file until it is read: with a loader set, a segment
+// of text, lines or spans is filled through it the first time pageRead,
+// lineRead, spanRead or spanFind touches it. The inline accessors don't
+// fault, so a drawer calls pageEnsure for the rows it is about to show.
+// stripInit (and anyone else writing a whole new page) drops the loader and
+// the find index; pageResident reads in the rest first, for when the file is
+// going away.
+enum PageStore { STORE_TEXT, STORE_LINES, STORE_SPANS };
+typedef bool (*PageLoader)(PageStore st, uint32_t off, void* dst, size_t n);
+void   pageBack(PageLoader loader);
+void   pageEnsure(int line0, int lines);
+bool   pageResident();
+size_t pageMemBytes();
+
+void stripInit(PageFormat fmt = FORMAT_HTML);
+void stripFeed(char c);
+void stripBlock(const uint8_t* p, size_t n);
+void stripFinish();
+typedef bool (*BodySink)(const uint8_t* p, size_t n);
+
+// Incremental body reader: bodyPoll takes what the stream has right now (at
+// most a few KB), never waits, and times out on millis() -- 8 s to the first
+// byte, 4 s between bytes. readBody is the blocking loop around it.
+#define STREAM_FIRST_BYTE_TIMEOUT   8000
+#define STREAM_IDLE_TIMEOUT         4000
+enum BodyState { BODY_MORE, BODY_DONE, BODY_SHORT, BODY_STOPPED };
+struct BodyReader {
+    int           left, total, contentLen;
+    uint8_t       st;
+    bool          chunked, any;
+    char          line[16];
+    int           lineLen;
+    unsigned long lastData;
+};
+void      bodyInit(BodyReader& r, int contentLen, bool chunked);
+BodyState bodyPoll(BodyReader& r, Stream* s, BodySink sink);
+bool      readBody(Stream* s, int contentLen, bool chunked, BodySink sink);
+
+// readStream in pieces: streamBegin returns the sink to feed the body to
+// (nullptr if the coding can't be set up), streamEnd flushes the stripper.
+BodySink streamBegin(BodySink tap, ContentCoding coding, PageFormat fmt);
+bool     streamEnd();
+// A body racing another one for the page is held raw in PSRAM instead:
+// spoolSink keeps up to the budget and refuses past it. spoolDrain starts
+// the stripper on what is held, after which spoolSink feeds the stripper
+// directly; finish with streamEnd as usual. spoolBytes is what was held.
+void   spoolBegin(size_t budget, ContentCoding coding);
+bool   spoolSink(const uint8_t* p, size_t n);
+bool   spoolDrain(BodySink tap, PageFormat fmt);
+size_t spoolBytes();
+void   spoolFree();
+bool readStream(Stream* s, int contentLen, bool chunked, bool* complete = nullptr, BodySink tap = nullptr,
+                ContentCoding coding = CODING_IDENTITY, PageFormat fmt = FORMAT_HTML);
+bool stripBuffer(const uint8_t* p, size_t n, ContentCoding coding = CODING_IDENTITY, PageFormat fmt = FORMAT_HTML);
+ContentCoding parseCoding(const char* contentEncoding);
+void lineInit();
+void lineFeed(bool final);
+void buildLineCache();
+void updateBaseDomain(const String& url);
+// Results are title, url and snippet end to end, NUL-terminated, in a string
+// pool found through a table of offsets. resultAdd appends at
+// g_resultCount, and setting that to 0 empties the list (the pool resets
+// with the next add); it refuses past MAX_RESULTS. Views stay good until the
+// list is emptied.
+bool         resultAdd(const char* title, const char* url, const char* snippet);
+SearchResult resultAt(int i);
+int          resultFind(const char* url);
+size_t       resultMemBytes();
+// Links work the same way on g_linkCount: linkAdd gives the new link's
+// index, or -1 past MAX_LINKS; linkUrl writes link i's url into out and
+// gives its length. linkFirst is the first link whose label starts at or
+// after off (a binary search), so the links on rows [a, b) are
+// linkFirst(start of a) up to linkFirst(start of b).
+int          linkAdd(const char* url, uint32_t at);
+int          linkUrl(int i, char* out, int max);
+int          linkFirst(uint32_t off);
+inline int   linkLabelLen(int i) { int n = 3; for (int k = i + 1; k >= 10; k /= 10) n++; return n; }
+size_t       linkMemBytes();
+void parseDDGLite(const String& html);
+void ddgInit();
+void ddgFeed(const char* p, size_t n);
+void ddgFinish();
+// The form body that asks DDG Lite for the page after the one just parsed
+// (its "Next Page" form: q, s, dc, vqd and the rest); empty on the last.
+const char* ddgNext();
+// Blocked-page check over the first BLOCK_SCAN_BYTES of page text. It is
+// incremental, so calling pageBlockHit from a stripper tap as the body
+// streams costs only the new bytes, and a hit can stop the transfer there.
+// pageIsBlocked also counts a page too short to judge.
+#define BLOCK_SCAN_BYTES  2048
+bool pageBlockHit();
+bool pageIsBlocked();
@@ -0,0 +1,31 @@
+#include "pool.h"
+
+uint32_t poolAlloc(StrPool& p, size_t n) {
+    uint32_t off = p.used;
+    if (!n || n > POOL_SEG_SIZE) return POOL_NONE;
+    if ((off & (POOL_SEG_SIZE - 1)) + n > POOL_SEG_SIZE) off = ((off >> POOL_SEG_SHIFT) + 1) << POOL_SEG_SHIFT;
+    uint32_t s = off >> POOL_SEG_SHIFT;
+    if (s >= POOL_MAX_SEGS) return POOL_NONE;
+    if (!p.segs[s] && !(p.segs[s] = (char*)heap_caps_malloc(POOL_SEG_SIZE, MALLOC_CAP_SPIRAM))) return POOL_NONE;
+    p.used = off + n;
+    return off;
+}
+
+uint32_t poolAdd(StrPool& p, const char* s, size_t n) {
+    uint32_t off = poolAlloc(p, n + 1);
+    if (off != POOL_NONE) { char* d = poolAt(p, off); memcpy(d, s, n); d[n] = 0; }
+    return off;
+}
+
+void poolReset(StrPool& p) {
+    for (int s = 1; s < POOL_MAX_SEGS; s++) { heap_caps_free(p.segs[s]); p.segs[s] = nullptr; }
+    p.used = 0;
+}
+
+void poolFree(StrPool& p) { poolReset(p); heap_caps_free(p.segs[0]); p.segs[0] = nullptr; }
+
+size_t poolBytes(const StrPool& p) {
+    size_t n = 0;
+    for (int s = 0; s < POOL_MAX_SEGS; s++) if (p.segs[s]) n += POOL_SEG_SIZE;
+    return n;
+}
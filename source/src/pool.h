@@ -0,0 +1,22 @@
+#pragma once
+#include <Arduino.h>
+
+// String pool: strings bumped end to end into POOL_SEG_SIZE pieces of PSRAM
+// (one never straddles two) and named by offset. Nothing is freed on its
+// own; a pool is reset whole when what it holds goes (a page's links, a
+// search's results), which keeps the first piece for the next round.
+#define POOL_SEG_SHIFT   12
+#define POOL_SEG_SIZE    (1u << POOL_SEG_SHIFT)
+#define POOL_MAX_SEGS    64
+#define POOL_NONE        0xFFFFFFFFu
+
+struct StrPool { char* segs[POOL_MAX_SEGS]; uint32_t used; };
+
+inline char* poolAt(const StrPool& p, uint32_t off) { return p.segs[off >> POOL_SEG_SHIFT] + (off & (POOL_SEG_SIZE - 1)); }
+// n bytes in one piece (n <= POOL_SEG_SIZE), or POOL_NONE when full.
+uint32_t poolAlloc(StrPool& p, size_t n);
+// s[0..n) and a NUL.
+uint32_t poolAdd(StrPool& p, const char* s, size_t n);
+void     poolReset(StrPool& p);
+void     poolFree(StrPool& p);
+size_t   poolBytes(const StrPool& p);
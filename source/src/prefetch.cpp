@@ -0,0 +1,141 @@
+#include "prefetch.h"
+#include "page.h"
+#include "net.h"
+
+enum PrefetchState { PF_EMPTY, PF_QUEUED, PF_LOADING, PF_READY, PF_FAILED };
+
+struct PrefetchSlot {
+    char          url[256];
+    uint8_t*      raw;
+    size_t        len;
+    ContentCoding coding;
+    uint32_t      gen;
+    PrefetchState state;
+};
+
+static PrefetchSlot      g_pf[PREFETCH_COUNT];
+static SemaphoreHandle_t g_pfLock   = nullptr;
+static TaskHandle_t      g_pfTask   = nullptr;
+static volatile uint32_t g_pfGen    = 0;
+static volatile bool     g_pfPaused = false;
+
+static WiFiClientSecure* s_pfClient = nullptr;
+static uint8_t*          s_pfBuf    = nullptr;
+static size_t            s_pfLen    = 0;
+static size_t            s_pfSpent  = 0;
+static ContentCoding     s_pfCoding = CODING_IDENTITY;
+static uint32_t          s_pfGen    = 0;
+
+static void pfFree(PrefetchSlot& s) {
+    heap_caps_free(s.raw); s.raw = nullptr; s.len = 0; s.state = PF_EMPTY;
+}
+
+// Every body byte off the wire counts against the budget, the ones a failed
+// or oversized page brought in too.
+static bool pfSink(const uint8_t* p, size_t n) {
+    while (g_pfPaused && s_pfGen == g_pfGen) delay(20);
+    s_pfSpent += n;
+    if (s_pfGen != g_pfGen || s_pfLen + n > PREFETCH_PAGE_MAX || s_pfSpent > PREFETCH_BUDGET) return false;
+    memcpy(s_pfBuf + s_pfLen, p, n); s_pfLen += n;
+    return true;
+}
+
+static bool pfFetch(const char* url) {
+    if (!s_pfClient) { s_pfClient = new WiFiClientSecure(); s_pfClient->setInsecure(); }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = s_pfClient->connected();
+        if (!reused && !netConnect(s_pfClient, JINA_HOST, JINA_PORT)) return false;
+        s_pfClient->print(jinaRequest(url));
+        HttpHead head;
+        if (!readHead(s_pfClient, head, 15000)) { s_pfClient->stop(); if (reused) continue; return false; }
+        if (head.code != 200) { s_pfClient->stop(); return false; }
+        s_pfLen = 0; s_pfCoding = head.coding;
+        bool complete = readBody(s_pfClient, head.contentLen, head.chunked, pfSink);
+        if (!complete || head.close) s_pfClient->stop();
+        return complete && s_pfLen > 20;
+    }
+    return false;
+}
+
+static void prefetchTask(void*) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        s_pfSpent = 0;
+        for (int i = 0; i < PREFETCH_COUNT; i++) {
+            char url[256];
+            xSemaphoreTake(g_pfLock, portMAX_DELAY);
+            PrefetchSlot& s = g_pf[i];
+            bool go = s.state == PF_QUEUED && s.gen == g_pfGen && s_pfSpent < PREFETCH_BUDGET;
+            if (go) { s.state = PF_LOADING; s_pfGen = s.gen; strlcpy(url, s.url, sizeof(url)); }
+            xSemaphoreGive(g_pfLock);
+            if (!go) continue;
+
+            s_pfBuf = (uint8_t*)heap_caps_malloc(PREFETCH_PAGE_MAX, MALLOC_CAP_SPIRAM);
+            bool ok = s_pfBuf && pfFetch(url);
+
+            xSemaphoreTake(g_pfLock, portMAX_DELAY);
+            if (s.gen == s_pfGen && s.gen == g_pfGen && s.state == PF_LOADING && ok) {
+                s.raw = (uint8_t*)heap_caps_realloc(s_pfBuf, s_pfLen, MALLOC_CAP_SPIRAM);
+                if (!s.raw) s.raw = s_pfBuf;
+                s.len = s_pfLen; s.coding = s_pfCoding; s.state = PF_READY;
+            } else {
+                heap_caps_free(s_pfBuf);
+                if (s.gen == s_pfGen && s.state == PF_LOADING) s.state = PF_FAILED;
+            }
+            s_pfBuf = nullptr;
+            xSemaphoreGive(g_pfLock);
+        }
+    }
+}
+
+void prefetchInit() {
+    g_pfLock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(prefetchTask, "prefetch", 10240, nullptr, 1, &g_pfTask, PREFETCH_CORE);
+}
+
+void prefetchStart(int first) {
+    if (!g_pfTask) return;
+    xSemaphoreTake(g_pfLock, portMAX_DELAY);
+    uint32_t gen = ++g_pfGen;
+    for (int i = 0; i < PREFETCH_COUNT; i++) {
+        PrefetchSlot& s = g_pf[i];
+        if (s.state != PF_LOADING) pfFree(s);
+        if (first + i < g_resultCount) {
+            strlcpy(s.url, resultAt(first + i).url, sizeof(s.url));
+            s.gen = gen; s.state = PF_QUEUED;
+        }
+    }
+    g_pfPaused = false;
+    xSemaphoreGive(g_pfLock);
+    xTaskNotifyGive(g_pfTask);
+}
+
+void prefetchCancel() {
+    if (!g_pfTask) return;
+    xSemaphoreTake(g_pfLock, portMAX_DELAY);
+    ++g_pfGen;
+    for (int i = 0; i < PREFETCH_COUNT; i++) if (g_pf[i].state != PF_LOADING) pfFree(g_pf[i]);
+    g_pfPaused = false;
+    xSemaphoreGive(g_pfLock);
+}
+
+void prefetchPause(bool paused) { g_pfPaused = paused; }
+
+int prefetchTake(const String& url) {
+    if (!g_pfTask) return 0;
+    uint8_t* raw = nullptr; size_t len = 0; ContentCoding coding = CODING_IDENTITY;
+    xSemaphoreTake(g_pfLock, portMAX_DELAY);
+    PrefetchSlot* s = nullptr;
+    for (int i = 0; i < PREFETCH_COUNT && !s; i++)
+        if (g_pf[i].gen == g_pfGen && g_pf[i].state != PF_EMPTY && url == g_pf[i].url) s = &g_pf[i];
+    PrefetchState st = s ? s->state : PF_EMPTY;
+    if (st == PF_READY) { raw = s->raw; len = s->len; coding = s->coding; s->raw = nullptr; pfFree(*s); }
+    else if (st == PF_QUEUED || st == PF_FAILED) pfFree(*s);
+    xSemaphoreGive(g_pfLock);
+    if (st == PF_LOADING) return -1;
+    if (!raw) return 0;
+    bool ok = stripBuffer(raw, len, coding, FORMAT_MARKDOWN);
+    heap_caps_free(raw);
+    if (!ok || g_pageLen <= 20) return 0;
+    return pageIsBlocked() ? 2 : 1;
+}
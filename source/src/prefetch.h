@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+
+#define PREFETCH_COUNT      3
+#define PREFETCH_PAGE_MAX   (128 * 1024)
+// Body bytes received per result list, failed fetches included. Less than
+// PREFETCH_COUNT full pages, so a run of large ones stops early.
+#define PREFETCH_BUDGET     (256 * 1024)
+#define PREFETCH_WAIT_MS    8000
+#define PREFETCH_CORE       0
+
+void prefetchInit();
+// Queues the PREFETCH_COUNT results from first on: the top of DDG's list,
+// past the local index's hits (pages read before) ahead of it.
+void prefetchStart(int first);
+void prefetchCancel();
+void prefetchPause(bool paused);
+// 1 if url had been prefetched and is now the page, 2 if what came was a
+// block page (the Wayback copy is next), 0 if not, -1 while it is still
+// loading (ask again, up to PREFETCH_WAIT_MS).
+int  prefetchTake(const String& url);
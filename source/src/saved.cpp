@@ -0,0 +1,161 @@
+#include "saved.h"
+
+static_assert(sizeof(LineSpan) == 8 && sizeof(StyleSpan) == 8, "saved page layout follows the in-memory structs");
+
+static fs::FS*   s_fs = nullptr;
+static File      s_open;               // the file behind the current page, if it came from here
+static String    s_openPath;
+static SavedHead s_head;
+
+static uint32_t align4(uint32_t n) { return (n + 3) & ~3u; }
+
+static String savedPath(const String& url, const char* ext = ".pg") {
+    uint32_t h = 2166136261u;
+    for (const char* p = url.c_str(); *p; p++) { h ^= (uint8_t)*p; h *= 16777619u; }
+    char path[32]; snprintf(path, sizeof(path), SAVED_PREFIX "%08x%s", (unsigned)h, ext);
+    return String(path);
+}
+
+// Lets go of the file behind the page, reading in what the page still needs.
+static void savedRelease(const String& path) {
+    if (!s_open || s_openPath != path) return;
+    pageResident();
+    s_open.close(); s_openPath = "";
+}
+
+static bool headOK(const SavedHead& h, size_t size) {
+    if (memcmp(h.magic, SAVED_MAGIC, 4) || h.version != SAVED_VERSION || h.headSize != sizeof(SavedHead) || h.fileSize != size)
+        return false;
+    if (h.textLen > PAGE_MAX_BYTES || h.lineCount > MAX_LINES || h.spanCount > MAX_SPANS || h.linkCount > MAX_LINKS) return false;
+    auto within = [&](uint32_t off, uint64_t n) { return !(off & 3) && off >= sizeof(SavedHead) && off + n <= size; };
+    return within(h.lineOff, (uint64_t)h.lineCount * sizeof(LineSpan)) &&
+           within(h.spanOff, (uint64_t)h.spanCount * sizeof(StyleSpan)) &&
+           within(h.linkOff, (uint64_t)h.linkCount * 8 + h.linkBytes) &&
+           within(h.textOff, h.textLen) &&
+           sizeof(SavedHead) + h.urlLen + h.titleLen + 2 <= h.lineOff;
+}
+
+static bool readAt(File& f, uint32_t at, void* p, size_t n) { return f.seek(at) && f.read((uint8_t*)p, n) == n; }
+static bool writeAll(File& f, const void* p, size_t n) { return f.write((const uint8_t*)p, n) == n; }
+static bool writePad(File& f, uint32_t at) {
+    static const uint8_t zero[4] = {};
+    return writeAll(f, zero, align4(at) - at);
+}
+
+static bool savedFetch(PageStore st, uint32_t off, void* dst, size_t n) {
+    uint32_t base = st == STORE_TEXT ? s_head.textOff : st == STORE_LINES ? s_head.lineOff : s_head.spanOff;
+    return readAt(s_open, base + off, dst, n);
+}
+
+void savedBegin(fs::FS& fs) { s_fs = &fs; }
+
+bool savedStore(const String& url) {
+    if (!s_fs || g_pageLen == 0) return false;
+    char title[SAVED_TITLE]; pageTitle(title, sizeof(title));
+    SavedHead h = {};
+    memcpy(h.magic, SAVED_MAGIC, 4); h.version = SAVED_VERSION; h.headSize = sizeof(SavedHead);
+    h.urlLen = (uint16_t)url.length(); h.titleLen = (uint16_t)strlen(title);
+    uint32_t names = sizeof(SavedHead) + h.urlLen + 1 + h.titleLen + 1;
+    h.lineOff = align4(names);                           h.lineCount = g_lineCount;
+    h.spanOff = h.lineOff + g_lineCount * sizeof(LineSpan); h.spanCount = g_spanCount;
+    h.linkOff = h.spanOff + g_spanCount * sizeof(StyleSpan); h.linkCount = g_linkCount;
+    char link[LINK_URL_LEN];
+    for (int i = 0; i < g_linkCount; i++) h.linkBytes += linkUrl(i, link, sizeof(link)) + 1;
+    uint32_t linkEnd = h.linkOff + h.linkCount * 8 + h.linkBytes;
+    h.textOff = align4(linkEnd); h.textLen = g_pageLen;
+    h.fileSize = h.textOff + h.textLen;
+
+    String tmp = savedPath(url, ".tmp"), path = savedPath(url);
+    File f = s_fs->open(tmp.c_str(), "w");
+    if (!f) return false;
+    bool ok = writeAll(f, &h, sizeof(h)) && writeAll(f, url.c_str(), h.urlLen + 1) && writeAll(f, title, h.titleLen + 1) &&
+              writePad(f, names);
+    uint8_t buf[1024];
+    const int perLines = sizeof(buf) / sizeof(LineSpan), perSpans = sizeof(buf) / sizeof(StyleSpan);
+    for (int i = 0, n; ok && i < g_lineCount; i += n) {
+        n = min(g_lineCount - i, perLines); lineRead(i, (LineSpan*)buf, n);
+        ok = writeAll(f, buf, n * sizeof(LineSpan));
+    }
+    for (int i = 0, n; ok && i < g_spanCount; i += n) {
+        n = min(g_spanCount - i, perSpans); spanRead(i, (StyleSpan*)buf, n);
+        ok = writeAll(f, buf, n * sizeof(StyleSpan));
+    }
+    for (uint32_t i = 0, off = 0; ok && i < h.linkCount; off += linkUrl(i++, link, sizeof(link)) + 1) ok = writeAll(f, &off, 4);
+    for (uint32_t i = 0; ok && i < h.linkCount; i++) ok = writeAll(f, &g_links[i].at, 4);
+    for (uint32_t i = 0; ok && i < h.linkCount; i++) ok = writeAll(f, link, linkUrl(i, link, sizeof(link)) + 1);
+    ok = ok && writePad(f, linkEnd);
+    for (uint32_t at = 0, n; ok && at < g_pageLen; at += n) {
+        n = min((uint32_t)sizeof(buf), (uint32_t)g_pageLen - at); pageRead(at, (char*)buf, n);
+        ok = writeAll(f, buf, n);
+    }
+    f.close();
+    // Renaming onto an existing name fails on SPIFFS, so the old copy goes first.
+    if (ok) { savedRelease(path); s_fs->remove(path.c_str()); ok = s_fs->rename(tmp.c_str(), path.c_str()); }
+    if (!ok) s_fs->remove(tmp.c_str());
+    return ok;
+}
+
+bool savedLoad(const String& url) {
+    if (!s_fs) return false;
+    String path = savedPath(url);
+    File f = s_fs->open(path.c_str(), "r");
+    if (!f) return false;
+    SavedHead h;
+    if (!readAt(f, 0, &h, sizeof(h)) || !headOK(h, f.size()) || h.urlLen != url.length()) return false;
+    char buf[64];
+    for (uint32_t i = 0, n; i < h.urlLen; i += n) {
+        n = min((uint32_t)sizeof(buf), (uint32_t)h.urlLen - i);
+        if (f.read((uint8_t*)buf, n) != n || memcmp(buf, url.c_str() + i, n)) return false;
+    }
+    // The offsets and strings are read whole and checked before the page on
+    // screen is touched.
+    uint32_t* offs = (uint32_t*)heap_caps_malloc(h.linkCount * 8 + h.linkBytes + 1, MALLOC_CAP_SPIRAM);
+    if (!offs) return false;
+    uint32_t* ats = offs + h.linkCount;
+    char* strs = (char*)(ats + h.linkCount);
+    bool ok = readAt(f, h.linkOff, offs, h.linkCount * 8 + h.linkBytes);
+    strs[h.linkBytes] = 0;
+    for (uint32_t i = 0; ok && i < h.linkCount; i++) ok = offs[i] < h.linkBytes && (!i || ats[i] >= ats[i - 1]);
+    if (ok) {
+        if (s_open) s_open.close();
+        s_open = f; s_openPath = path; s_head = h;
+        g_linkCount = 0;
+        for (uint32_t i = 0; i < h.linkCount; i++) linkAdd(strs + offs[i], ats[i]);
+        g_pageLen = h.textLen; g_lineCount = h.lineCount; g_spanCount = h.spanCount;
+        pageBack(savedFetch);
+    }
+    heap_caps_free(offs);
+    return ok;
+}
+
+bool savedHas(const String& url) { return s_fs && s_fs->exists(savedPath(url).c_str()); }
+
+bool savedRemove(const String& url) {
+    if (!s_fs) return false;
+    String path = savedPath(url);
+    savedRelease(path);
+    return s_fs->remove(path.c_str());
+}
+
+// Every readable saved page, by title.
+int savedList(SavedInfo* out, int max) {
+    if (!s_fs) return 0;
+    File dir = s_fs->open("/");
+    if (!dir) return 0;
+    int n = 0;
+    for (File f = dir.openNextFile(); f && n < max; f = dir.openNextFile()) {
+        // name() is the bare name on some cores and the full path on others.
+        const char* nm = f.name(); if (*nm == '/') nm++;
+        size_t len = strlen(nm);
+        if (strncmp(nm, SAVED_PREFIX + 1, strlen(SAVED_PREFIX) - 1) || len < 3 || strcmp(nm + len - 3, ".pg")) continue;
+        SavedHead h;
+        if (!readAt(f, 0, &h, sizeof(h)) || !headOK(h, f.size())) continue;
+        SavedInfo& e = out[n];
+        size_t ul = min((size_t)h.urlLen, sizeof(e.url) - 1), tl = min((size_t)h.titleLen, sizeof(e.title) - 1);
+        if (!readAt(f, sizeof(h), e.url, ul) || !readAt(f, sizeof(h) + h.urlLen + 1, e.title, tl)) continue;
+        e.url[ul] = 0; e.title[tl] = 0; e.bytes = h.fileSize;
+        int i = n++;
+        while (i > 0 && strcasecmp(out[i - 1].title, out[i].title) > 0) { std::swap(out[i - 1], out[i]); i--; }
+    }
+    return n;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <FS.h>
+#include "page.h"
+
+// Reading list: stripped pages saved to flash for reading offline. One file
+// per page, SAVED_PREFIX + the URL's FNV-1a hash in hex + ".pg", written to
+// a temporary name and renamed into place. Little-endian, every section
+// 4-byte aligned and laid out as the in-memory structs, so a section can be
+// read (or mapped) straight into the page store:
+//   SavedHead
+//   url \0, title \0
+//   LineSpan[lineCount]
+//   StyleSpan[spanCount]
+//   uint32_t[linkCount]    each URL's offset from the first one
+//   uint32_t[linkCount]    each link's label offset in the text (version 2)
+//   link URLs, \0-terminated
+//   text[textLen]
+// Opening reads the head and the links; text, lines and spans come in a
+// segment at a time as the page is drawn (pageBack).
+#define SAVED_PREFIX   "/rl-"
+#define SAVED_MAGIC    "CWRL"
+#define SAVED_VERSION  2
+#define SAVED_MAX      64
+#define SAVED_TITLE    64
+
+struct SavedHead {
+    char     magic[4];
+    uint16_t version, headSize;
+    uint32_t fileSize;
+    uint32_t textOff, textLen;
+    uint32_t lineOff, lineCount;
+    uint32_t spanOff, spanCount;
+    uint32_t linkOff, linkCount, linkBytes;
+    uint16_t urlLen, titleLen;
+};
+
+struct SavedInfo { char url[LINK_URL_LEN]; char title[SAVED_TITLE]; uint32_t bytes; };
+
+void savedBegin(fs::FS& fs);
+bool savedStore(const String& url);
+// Makes the saved copy of url the current page; false (page untouched) if
+// there is none or it doesn't check out.
+bool savedLoad(const String& url);
+bool savedHas(const String& url);
+bool savedRemove(const String& url);
+int  savedList(SavedInfo* out, int max);
@@ -0,0 +1,218 @@
+#include "text.h"
+#include "html.h"
+#include <Fonts/glcdfont.c>
+
+// ---- glyph atlas ---------------------------------------------------------------
+//
+// A cell is GLCD_W x GLCD_H of 4-bit coverage, a byte a pixel. Latin-1 and
+// Latin Extended-A/B are indexed directly, anything else is hashed on the code
+// point; both fill on first use, so after the first screen of a French page
+// every accented letter is a table read like ASCII.
+
+struct GlyphCell { uint8_t a[GLCD_H][GLCD_W]; };
+
+#define ATLAS_LO     0x80
+#define ATLAS_HI     0x250
+#define ATLAS_SLOTS  512
+#define ATLAS_PROBES 8
+
+struct GlyphAtlas {
+    GlyphCell direct[ATLAS_HI - ATLAS_LO];
+    uint32_t  filled[(ATLAS_HI - ATLAS_LO + 31) / 32];
+    uint32_t  key[ATLAS_SLOTS];                 // 0 is free: ASCII never lands here
+    GlyphCell cell[ATLAS_SLOTS];
+};
+static GlyphAtlas* s_atlas = nullptr;
+
+static const uint8_t* s_vlw = nullptr;
+static uint32_t       s_vlwCount = 0;
+
+static uint32_t be32(const uint8_t* p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+static void atlasClear() {
+    if (!s_atlas) return;
+    memset(s_atlas->filled, 0, sizeof(s_atlas->filled));
+    memset(s_atlas->key, 0, sizeof(s_atlas->key));
+}
+
+// .vlw: a 24-byte header (glyph count, version, size, -, ascent, descent),
+// 28 bytes per glyph (code point, height, width, advance, top above the
+// baseline, left offset, -), then each glyph's 8-bit bitmap in that order;
+// all big-endian.
+bool glyphFont(const uint8_t* vlw, size_t n) {
+    s_vlw = nullptr; s_vlwCount = 0; atlasClear();
+    if (!vlw || n < 24) return false;
+    uint32_t count = be32(vlw);
+    if (count > 0xFFFF || 24 + (size_t)count * 28 > n) return false;
+    size_t bits = 24 + (size_t)count * 28;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* g = vlw + 24 + i * 28;
+        bits += (size_t)be32(g + 4) * be32(g + 8);
+        if (bits > n) return false;
+    }
+    s_vlw = vlw; s_vlwCount = count;
+    return true;
+}
+
+// The font's baseline goes under row GLCD_H-2, where the GLCD capitals end.
+static bool vlwGlyph(uint32_t cp, GlyphCell& g) {
+    if (!s_vlw) return false;
+    const uint8_t* bits = s_vlw + 24 + (size_t)s_vlwCount * 28;
+    for (uint32_t i = 0; i < s_vlwCount; i++) {
+        const uint8_t* r = s_vlw + 24 + i * 28;
+        int h = (int)be32(r + 4), w = (int)be32(r + 8);
+        if (be32(r) != cp) { bits += (size_t)w * h; continue; }
+        int top = GLCD_H - 1 - (int32_t)be32(r + 16), left = (int32_t)be32(r + 20);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++) {
+                int cx = left + x, cy = top + y;
+                if (cx >= 0 && cx < GLCD_W && cy >= 0 && cy < GLCD_H) g.a[cy][cx] = bits[y * w + x] >> 4;
+            }
+        return true;
+    }
+    return false;
+}
+
+// Unicode to the CP437 upper half of glcdfont.c. Only below 0xB0: past that
+// the Adafruit table is a glyph out of step with CP437.
+static const struct { uint16_t cp; uint8_t glcd; } CP437[] = {
+    {0xA1, 0xAD}, {0xA2, 0x9B}, {0xA3, 0x9C}, {0xA5, 0x9D}, {0xAA, 0xA6}, {0xAB, 0xAE}, {0xAC, 0xAA}, {0xBA, 0xA7},
+    {0xBB, 0xAF}, {0xBC, 0xAC}, {0xBD, 0xAB}, {0xBF, 0xA8}, {0xC4, 0x8E}, {0xC5, 0x8F}, {0xC6, 0x92}, {0xC7, 0x80},
+    {0xC9, 0x90}, {0xD1, 0xA5}, {0xD6, 0x99}, {0xDC, 0x9A}, {0xE0, 0x85}, {0xE1, 0xA0}, {0xE2, 0x83}, {0xE4, 0x84},
+    {0xE5, 0x86}, {0xE6, 0x91}, {0xE7, 0x87}, {0xE8, 0x8A}, {0xE9, 0x82}, {0xEA, 0x88}, {0xEB, 0x89}, {0xEC, 0x8D},
+    {0xED, 0xA1}, {0xEE, 0x8C}, {0xEF, 0x8B}, {0xF1, 0xA4}, {0xF2, 0x95}, {0xF3, 0xA2}, {0xF4, 0x93}, {0xF6, 0x94},
+    {0xF9, 0x97}, {0xFA, 0xA3}, {0xFB, 0x96}, {0xFC, 0x81}, {0xFF, 0x98}, {0x192, 0x9F}, {0x2022, 0x07},
+    {0x2190, 0x1B}, {0x2191, 0x18}, {0x2192, 0x1A}, {0x2193, 0x19},
+};
+
+// Cells the fold would get wrong by taking the first letter of several.
+static const struct { uint16_t cp; uint8_t col[5]; } DRAWN[] = {
+    {0x00B0, {0x00, 0x06, 0x09, 0x09, 0x06}}, {0x00B1, {0x44, 0x44, 0x5F, 0x44, 0x44}},
+    {0x0152, {0x3E, 0x41, 0x7F, 0x49, 0x49}}, {0x0153, {0x38, 0x44, 0x38, 0x54, 0x58}},
+    {0x2026, {0x40, 0x00, 0x40, 0x00, 0x40}}, {0x20AC, {0x14, 0x3E, 0x55, 0x55, 0x41}},
+    {0xFFFD, {0x7F, 0x41, 0x41, 0x41, 0x7F}},
+};
+
+static void glcdInto(GlyphCell& g, const uint8_t* col) {
+    for (int x = 0; x < 5; x++)
+        for (int y = 0; y < GLCD_H; y++) g.a[y][x] = (col[x] >> y) & 1 ? 15 : 0;
+}
+
+static bool blankCp(uint32_t cp) {
+    return cp == 0xA0 || cp == 0xAD || (cp >= 0x2000 && cp <= 0x200D) || cp == 0x202F ||
+           cp == 0x205F || cp == 0x2060 || cp == 0x3000 || cp == 0xFEFF;
+}
+
+static void glyphBuild(uint32_t cp, GlyphCell& g) {
+    memset(&g, 0, sizeof(g));
+    if (vlwGlyph(cp, g) || blankCp(cp)) return;
+    for (auto& m : CP437) if (m.cp == cp) { glcdInto(g, font + m.glcd * 5); return; }
+    for (auto& d : DRAWN) if (d.cp == cp) { glcdInto(g, d.col); return; }
+    char u[4], f[16]; int n = asciiFold(u, utf8Put(cp, u), f);
+    uint8_t c = n > 0 && f[0] != ' ' ? (uint8_t)f[0] : 0;
+    if (c) glcdInto(g, font + c * 5);
+    else glyphBuild(0xFFFD, g);
+}
+
+static const GlyphCell* glyphCell(uint32_t cp) {
+    static GlyphCell scratch;
+    if (!s_atlas) {
+        s_atlas = (GlyphAtlas*)heap_caps_malloc(sizeof(GlyphAtlas), MALLOC_CAP_SPIRAM);
+        atlasClear();
+    }
+    if (!s_atlas) { glyphBuild(cp, scratch); return &scratch; }
+    if (cp >= ATLAS_LO && cp < ATLAS_HI) {
+        uint32_t i = cp - ATLAS_LO;
+        if (!(s_atlas->filled[i >> 5] >> (i & 31) & 1)) { glyphBuild(cp, s_atlas->direct[i]); s_atlas->filled[i >> 5] |= 1u << (i & 31); }
+        return &s_atlas->direct[i];
+    }
+    uint32_t h = (cp * 2654435761u) >> 23;
+    for (int p = 0; p < ATLAS_PROBES; p++, h = (h + 1) & (ATLAS_SLOTS - 1)) {
+        if (s_atlas->key[h] == cp) return &s_atlas->cell[h];
+        if (!s_atlas->key[h]) { glyphBuild(cp, s_atlas->cell[h]); s_atlas->key[h] = cp; return &s_atlas->cell[h]; }
+    }
+    glyphBuild(cp, scratch); return &scratch;
+}
+
+uint8_t glyphCoverage(uint32_t cp, int x, int y) {
+    return glyphCell(cp)->a[y][x];
+}
+
+// ---- runs -------------------------------------------------------------------
+
+static uint16_t mix565(uint16_t fg, uint16_t bg, int a) {
+    int r = ((fg >> 11) * a + (bg >> 11) * (15 - a) + 7) / 15;
+    int g = (((fg >> 5) & 0x3F) * a + ((bg >> 5) & 0x3F) * (15 - a) + 7) / 15;
+    int b = ((fg & 0x1F) * a + (bg & 0x1F) * (15 - a) + 7) / 15;
+    uint16_t c = (uint16_t)(r << 11 | g << 5 | b);
+    return (uint16_t)((c >> 8) | (c << 8));
+}
+
+int textRaster(uint16_t* px, int stride, const char* s, int n, uint16_t fg, uint16_t bg, bool bold) {
+    uint16_t f = (uint16_t)((fg >> 8) | (fg << 8)), b = (uint16_t)((bg >> 8) | (bg << 8));
+    // Blends for the last colour pair; a page is drawn in a handful of them.
+    static uint16_t pal[16], palFg = 0, palBg = 0; static bool palOK = false;
+    uint16_t* cell = px;
+    for (int i = 0; i < n;) {
+        uint8_t ch = (uint8_t)s[i];
+        if (ch >= 0x80) {
+            uint32_t cp; i += utf8Get((const uint8_t*)s + i, n - i, cp);
+            if (!utf8Cell(ch)) continue;
+            if (!palOK || palFg != fg || palBg != bg) {
+                for (int a = 0; a < 16; a++) pal[a] = mix565(fg, bg, a);
+                palFg = fg; palBg = bg; palOK = true;
+            }
+            const GlyphCell* g = glyphCell(cp);
+            for (int j = 0; j < GLCD_H; j++) {
+                uint16_t* row = cell + j * stride;
+                const uint8_t* a = g->a[j];
+                if (bold) { for (int k = 0; k < GLCD_W; k++) row[k] = pal[k && a[k - 1] > a[k] ? a[k - 1] : a[k]]; continue; }
+                row[0] = pal[a[0]]; row[1] = pal[a[1]]; row[2] = pal[a[2]];
+                row[3] = pal[a[3]]; row[4] = pal[a[4]]; row[5] = pal[a[5]];
+            }
+            cell += GLCD_W;
+            continue;
+        }
+        const uint8_t* gl = font + ch * 5;
+        i++;
+        if (bold) {
+            uint8_t c[GLCD_W] = { gl[0], (uint8_t)(gl[1] | gl[0]), (uint8_t)(gl[2] | gl[1]), (uint8_t)(gl[3] | gl[2]),
+                                  (uint8_t)(gl[4] | gl[3]), gl[4] };
+            for (int j = 0; j < GLCD_H; j++) {
+                uint16_t* row = cell + j * stride;
+                for (int k = 0; k < GLCD_W; k++) row[k] = (c[k] >> j) & 1 ? f : b;
+            }
+            cell += GLCD_W;
+            continue;
+        }
+        for (int j = 0; j < GLCD_H; j++) {
+            uint16_t* row = cell + j * stride;
+            row[0] = (gl[0] >> j) & 1 ? f : b;
+            row[1] = (gl[1] >> j) & 1 ? f : b;
+            row[2] = (gl[2] >> j) & 1 ? f : b;
+            row[3] = (gl[3] >> j) & 1 ? f : b;
+            row[4] = (gl[4] >> j) & 1 ? f : b;
+            row[5] = b;
+        }
+        cell += GLCD_W;
+    }
+    return (int)(cell - px);
+}
+
+// Control bytes go through tft.print so TFT_eSPI's control handling stays in
+// charge of them; everything else is batched.
+int textRunLen(const char* s, int n, int maxCols, int& cols) {
+    int i = 0; cols = 0;
+    for (; i < n; i++) {
+        uint8_t c = (uint8_t)s[i];
+        if (c < 0x20 || c == 0x7F) break;
+        if (utf8Cell(c)) { if (cols == maxCols) break; cols++; }
+    }
+    return i;
+}
+
+int textColumns(const char* s, int n) {
+    int cols = 0;
+    for (int i = 0; i < n; i++) cols += utf8Cell((uint8_t)s[i]);
+    return cols;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+
+#define GLCD_W  6
+#define GLCD_H  8
+
+// Rasterises the UTF-8 text s (n bytes) into px, a GLCD_H-row image with the
+// given stride, colours already in panel byte order; one GLCD_W cell per code
+// point (combining marks take none). ASCII matches what TFT_eSPI::drawChar
+// puts on the glass for the same run; everything else comes from the glyph
+// atlas. bold smears each column one pixel right, into the glyph's spare
+// column. Returns the width in pixels.
+int textRaster(uint16_t* px, int stride, const char* s, int n, uint16_t fg, uint16_t bg, bool bold = false);
+
+// Bytes of the longest prefix of s that textRaster can draw in at most
+// maxCols cells: stops at control bytes and never splits a code point. cols
+// gets the cells it takes.
+int textRunLen(const char* s, int n, int maxCols, int& cols);
+int textColumns(const char* s, int n);
+
+// What find and the local index take for a word: ASCII letters and digits,
+// and any byte of a UTF-8 sequence; ASCII letters fold to lower case.
+static inline bool    wordByte(uint8_t c) { return c >= 0x80 || (uint8_t)(c - '0') < 10 || (uint8_t)((c | 0x20) - 'a') < 26; }
+static inline uint8_t wordFold(uint8_t c) { return (uint8_t)(c - 'A') < 26 ? c + 32 : c; }
+
+// Non-ASCII glyphs are built once per code point into 4-bit coverage cells
+// kept in PSRAM. Their source is a TFT_eSPI smooth font (.vlw, the format
+// SMOOTH_FONT loads) if one is set, else the CP437 half of the GLCD font, a
+// few drawn-in cells and the ASCII fold. The font data must stay put; pass
+// nullptr to go back to the built-in glyphs.
+bool    glyphFont(const uint8_t* vlw, size_t n);
+uint8_t glyphCoverage(uint32_t cp, int x, int y);
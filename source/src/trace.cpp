@@ -0,0 +1,109 @@
+#include "trace.h"
+#include <esp_timer.h>
+
+struct TraceSpan { uint32_t t0, dur, req; uint8_t phase, depth; };
+struct TraceFrame { uint32_t t0, child; uint8_t phase; };
+
+struct TraceStore {
+    TraceSpan spans[TRACE_SPANS];
+    TraceReq  reqs[TRACE_REQS];
+};
+static TraceStore*  s_tr      = nullptr;
+static uint32_t     s_spanN   = 0;          // spans ever written; the ring holds the last TRACE_SPANS
+static uint32_t     s_reqN    = 0;
+static TraceReq*    s_cur     = nullptr;
+static TaskHandle_t s_owner   = nullptr;
+static TraceFrame   s_stack[TRACE_DEPTH];
+static int          s_depth   = 0;
+
+static const char* const PHASE_NAMES[TR_PHASES] = {
+    "cache", "dns", "connect", "ttfb", "body", "inflate", "strip", "lines", "draw"
+};
+
+const char* tracePhaseName(int p) { return p >= 0 && p < TR_PHASES ? PHASE_NAMES[p] : "?"; }
+
+static uint32_t nowUs() { return (uint32_t)esp_timer_get_time(); }
+
+static bool mine() { return s_cur && s_owner == xTaskGetCurrentTaskHandle(); }
+
+void traceStart(char kind, const char* label) {
+    traceIdle();
+    if (!s_tr) {
+        s_tr = (TraceStore*)heap_caps_malloc(sizeof(TraceStore), MALLOC_CAP_SPIRAM);
+        if (!s_tr) return;
+        memset(s_tr, 0, sizeof(TraceStore));
+    }
+    TraceReq& r = s_tr->reqs[s_reqN % TRACE_REQS];
+    memset(&r, 0, sizeof(r));
+    r.id = ++s_reqN; r.kind = kind; r.open = true; r.t0 = nowUs();
+    strlcpy(r.label, label, sizeof(r.label));
+    s_cur = &r; s_owner = xTaskGetCurrentTaskHandle(); s_depth = 0;
+}
+
+void traceNote(int status, uint32_t bytes) {
+    if (!mine()) return;
+    s_cur->status = (int16_t)status; s_cur->bytes = bytes;
+}
+
+void traceVia(char via) {
+    if (!mine()) return;
+    s_cur->via = via;
+}
+
+void traceIdle() {
+    if (!mine()) return;
+    while (s_depth > 0) traceEnd();
+    s_cur->total = nowUs() - s_cur->t0; s_cur->open = false;
+    s_cur = nullptr;
+}
+
+void traceBegin(TracePhase p) {
+    if (!mine()) return;
+    if (s_depth < TRACE_DEPTH) s_stack[s_depth] = { nowUs(), 0, (uint8_t)p };
+    s_depth++;
+}
+
+void traceEnd() {
+    if (!mine() || s_depth == 0) return;
+    if (--s_depth >= TRACE_DEPTH) return;
+    TraceFrame& f = s_stack[s_depth];
+    uint32_t dur = nowUs() - f.t0;
+    s_cur->self[f.phase] += dur - min(dur, f.child);
+    if (s_depth > 0 && s_depth - 1 < TRACE_DEPTH) s_stack[s_depth - 1].child += dur;
+    s_tr->spans[s_spanN++ % TRACE_SPANS] = { f.t0, dur, s_cur->id, f.phase, (uint8_t)s_depth };
+}
+
+int traceRecent(TraceReq* out, int max) {
+    if (!s_tr) return 0;
+    int n = 0;
+    for (uint32_t id = s_reqN; id > 0 && s_reqN - id < TRACE_REQS && n < max; id--) {
+        out[n] = s_tr->reqs[(id - 1) % TRACE_REQS];
+        if (out[n].open) out[n].total = nowUs() - out[n].t0;
+        n++;
+    }
+    return n;
+}
+
+void traceDump(void (*line)(const char*)) {
+    if (!s_tr) return;
+    char buf[128];
+    uint32_t firstReq = s_reqN > TRACE_REQS ? s_reqN - TRACE_REQS + 1 : 1;
+    for (uint32_t id = firstReq; id <= s_reqN; id++) {
+        const TraceReq& r = s_tr->reqs[(id - 1) % TRACE_REQS];
+        if (r.open) continue;
+        const char kind[3] = { r.kind, r.via, 0 };
+        snprintf(buf, sizeof(buf), "TRACE R %u %u %u %d %u %s %s", (unsigned)r.id, (unsigned)r.t0, (unsigned)r.total,
+                 r.status, (unsigned)r.bytes, kind, r.label);
+        line(buf);
+    }
+    uint32_t from = s_spanN > TRACE_SPANS ? s_spanN - TRACE_SPANS : 0;
+    for (uint32_t i = from; i < s_spanN; i++) {
+        const TraceSpan& s = s_tr->spans[i % TRACE_SPANS];
+        // Spans of requests whose summary is gone, or that are still open, are left out.
+        uint32_t id = s.req;
+        if (id < firstReq || s_tr->reqs[(id - 1) % TRACE_REQS].open) continue;
+        snprintf(buf, sizeof(buf), "TRACE S %u %s %u %u %u", (unsigned)id, PHASE_NAMES[s.phase], (unsigned)s.depth,
+                 (unsigned)s.t0, (unsigned)s.dur);
+        line(buf);
+    }
+}
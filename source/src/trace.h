@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+
+// Per-request latency tracing. traceStart opens a request, which runs until
+// loop() gets control back (traceIdle), so the draw that follows a fetch is
+// part of it. Phases inside are timed from esp_timer and nest: strip runs
+// inside inflate inside body. Every span goes to a ring in PSRAM for the
+// serial dump; each request also keeps per-phase self time (its own time
+// minus its children's) for the overlay. Only the task that opened the
+// request records, so the prefetch task's fetches stay out of it.
+
+enum TracePhase { TR_CACHE, TR_DNS, TR_CONNECT, TR_TTFB, TR_BODY, TR_INFLATE, TR_STRIP, TR_LINES, TR_DRAW, TR_PHASES };
+
+#define TRACE_SPANS  4096
+#define TRACE_REQS   16
+#define TRACE_DEPTH  8
+
+struct TraceReq {
+    char     label[48];
+    char     kind;                      // 'P' page, 'S' search
+    char     via;                       // the leg that won a page race: 'j' live, 'w' Wayback, '-' neither
+    bool     open;
+    int16_t  status;
+    uint32_t id, t0, total, bytes;      // times in us
+    uint32_t self[TR_PHASES];
+};
+
+const char* tracePhaseName(int p);
+void traceStart(char kind, const char* label);
+void traceNote(int status, uint32_t bytes);
+void traceVia(char via);
+void traceIdle();
+void traceBegin(TracePhase p);
+void traceEnd();
+
+// Newest first, the open request included.
+int  traceRecent(TraceReq* out, int max);
+
+// One line per request and per span still in the ring, oldest first:
+//   TRACE R <id> <t0_us> <total_us> <status> <bytes> <kind>[via] <label>
+//   TRACE S <id> <phase> <depth> <t0_us> <dur_us>
+// tools/trace2chrome.py turns a log of these into a Chrome trace.
+void traceDump(void (*line)(const char*));
+
+struct TraceScope {
+    explicit TraceScope(TracePhase p) { traceBegin(p); }
+    ~TraceScope() { traceEnd(); }
+};
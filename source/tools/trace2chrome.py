@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Turn the TRACE lines the T-Deck prints on serial (P on a page or the
+results list) into a Chrome trace: open it in chrome://tracing or
+https://ui.perfetto.dev.
+
+    python3 tools/trace2chrome.py serial.log > trace.json
+
+Each request is its own row, spans nested under it by phase; times are the
+device's esp_timer microseconds. Anything that isn't a TRACE line is skipped,
+so a raw monitor log works as it is.
+"""
+import json
+import sys
+
+
+def convert(lines):
+    events, rows = [], set()
+    for line in lines:
+        f = line.strip().split(" ", 8)
+        if f[0] != "TRACE" or len(f) < 7:
+            continue
+        if f[1] == "R" and len(f) >= 8:
+            rid, t0, total, status, size = map(int, f[2:7])
+            label = f[8] if len(f) > 8 else ""
+            args = {"status": status, "bytes": size}
+            if len(f[7]) > 1:
+                args["via"] = {"j": "live", "w": "wayback"}.get(f[7][1], "none")
+            events.append({"name": f"{f[7][0]} {label}", "cat": "request", "ph": "X", "pid": 1, "tid": rid,
+                           "ts": t0, "dur": total, "args": args})
+            rows.add(rid)
+        elif f[1] == "S" and len(f) == 7:
+            rid, depth, t0, dur = int(f[2]), int(f[4]), int(f[5]), int(f[6])
+            events.append({"name": f[3], "cat": "phase", "ph": "X", "pid": 1, "tid": rid,
+                           "ts": t0, "dur": dur, "args": {"depth": depth}})
+    for rid in rows:
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": rid, "args": {"name": f"request {rid}"}})
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+if __name__ == "__main__":
+    src = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    json.dump(convert(src), sys.stdout)